@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+
+// Measures the decompression throughput of bam::reader for different thread numbers.
+//
+// usage: benchmark_bam_reader <file.bam> [threadNbr...]
+// Each thread number (default 0 1 2 4 8 16) reads the whole file three times,
+// the best run is reported in MB/s of decompressed data.
+#include <ivio/bam/reader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+// sum of the ISIZE fields of all BGZF blocks
+auto uncompressedSize(std::filesystem::path const& path) -> size_t {
+    auto ifs    = std::ifstream{path, std::ios::binary};
+    auto total  = size_t{0};
+    auto header = std::string(18, '\0');
+    for (size_t offset{0}; ifs.seekg(static_cast<std::streamoff>(offset)) && ifs.read(header.data(), header.size());) {
+        auto blockSize = size_t{uint8_t(header[16])} + (size_t{uint8_t(header[17])} << 8) + 1;
+        auto isize     = std::string(4, '\0');
+        ifs.seekg(static_cast<std::streamoff>(offset + blockSize - 4));
+        if (!ifs.read(isize.data(), isize.size())) {
+            throw std::runtime_error{"truncated bgzf block"};
+        }
+        for (size_t i{0}; i < 4; ++i) {
+            total += size_t{uint8_t(isize[i])} << (8*i);
+        }
+        offset += blockSize;
+    }
+    return total;
+}
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.bam> [threadNbr...]\n";
+        return 1;
+    }
+    auto path      = std::filesystem::path{argv[1]};
+    auto threadNbr = std::vector<size_t>{};
+    for (int i{2}; i < argc; ++i) {
+        threadNbr.push_back(std::stoul(argv[i]));
+    }
+    if (threadNbr.empty()) {
+        threadNbr = {0, 1, 2, 4, 8, 16};
+    }
+
+    auto bytes = uncompressedSize(path);
+    std::cout << "decompressed size: " << bytes / 1'000'000 << " MB\n";
+    std::cout << "threadNbr  records     time [s]  MB/s\n";
+    for (auto t : threadNbr) {
+        auto best    = std::chrono::duration<double>::max();
+        auto records = size_t{0};
+        for (size_t run{0}; run < 3; ++run) {
+            auto start  = std::chrono::steady_clock::now();
+            auto reader = ivio::bam::reader{{.input = path, .threadNbr = t}};
+            records = 0;
+            for ([[maybe_unused]] auto record_view : reader) {
+                ++records;
+            }
+            best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+        }
+        std::cout << std::setw(9) << t << "  "
+                  << std::setw(10) << records << "  "
+                  << std::fixed << std::setprecision(3) << std::setw(8) << best.count() << "  "
+                  << std::setprecision(1) << std::setw(7) << bytes / best.count() / 1'000'000 << "\n";
+    }
+}
@@ -3,8 +3,11 @@
 // SPDX-License-Identifier: BSD-3-Clause
 #include "../detail/bgzf_mt_reader.h"
 #include "../detail/bgzf_reader.h"
+#include "../detail/bgzf_seekable_reader.h"
+#include "../detail/bin_index.h"
 #include "../detail/buffered_reader.h"
 #include "../detail/file_reader.h"
+#include "../detail/io_uring_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
 #include "../detail/zlib_file_reader.h"
@@ -20,26 +23,51 @@ namespace ivio {
 
 template <>
 struct reader_base<bam::reader>::pimpl {
+    bam::reader::config config;
+
     VarBufferedReader ureader;
     size_t lastUsed{};
 
     bam::header header;
 
-    pimpl(std::filesystem::path file, size_t threadNbr)
-        : ureader {[&]() -> VarBufferedReader {
+    // state of region queries
+    struct Region {
+        int32_t refID;
+        int32_t begin;
+        int32_t end;
+    };
+    bool                     seekable{}; // ureader is a single threaded bgzf_seekable_reader
+    std::optional<bin_index> index;
+    std::optional<Region>    region;
+    std::vector<bgzf_chunk>  chunks;
+    size_t                   chunkIdx{};
+    bool                     needSeek{};
+
+    pimpl(bam::reader::config const& config_, std::filesystem::path file, size_t threadNbr, mmap_policy policy)
+        : config{config_}
+        , ureader {[&]() -> VarBufferedReader {
+            if (!is_regular_file(file)) { // pipes and other special files can not be mapped
+                if (threadNbr == 0) {
+                    return bgzf_seekable_reader{io_uring_reader{file, config_.readAhead}};
+                }
+                return bgzf_mt_reader{io_uring_reader{file, config_.readAhead}, threadNbr};
+            }
             if (threadNbr == 0) {
-                return make_buffered_reader<1<<16>(bgzf_reader{mmap_reader{file}});
+                return bgzf_seekable_reader{mmap_reader{file, policy}};
             }
-            return bgzf_mt_reader{mmap_reader{file}, threadNbr};
+            return bgzf_mt_reader{mmap_reader{file, policy}, threadNbr};
         }()}
+        , seekable{threadNbr == 0 && is_regular_file(file)} // pipes can not seek
     {}
-    pimpl(std::istream& file, size_t threadNbr)
-        : ureader {[&]() -> VarBufferedReader {
+    pimpl(bam::reader::config const& config_, std::istream& file, size_t threadNbr, mmap_policy)
+        : config{config_}
+        , ureader {[&]() -> VarBufferedReader {
             if (threadNbr == 0) {
-                return make_buffered_reader<1<<16>(bgzf_reader{stream_reader{file}});
+                return bgzf_seekable_reader{stream_reader{file}};
             }
             return bgzf_mt_reader{stream_reader{file}, threadNbr};
         }()}
+        , seekable{threadNbr == 0}
     {}
 
     void readHeader() {
@@ -70,7 +98,7 @@ struct reader_base<bam::reader>::pimpl {
         }
     }
 
-    auto next() -> std::optional<bam::record_view> {
+    auto readRecord() -> std::optional<bam::record_view> {
         ureader.dropUntil(lastUsed);
         auto [ptr, size] = ureader.read(40);
         if (size == 0) return std::nullopt;
@@ -118,6 +146,106 @@ struct reader_base<bam::reader>::pimpl {
                                   .qual       = std::span{reinterpret_cast<uint8_t const*>(qual.data()), qual.size()},
                                 };
     }
+
+    // end of the alignment on the reference (exclusive)
+    static auto referenceEnd(bam::record_view const& r) -> int64_t {
+        int64_t len{};
+        for (size_t i{0}; i + 4 <= r.cigar.size(); i += 4) {
+            auto v  = ivio::bgzfUnpack<uint32_t>(reinterpret_cast<char const*>(r.cigar.data()) + i);
+            auto op = v & 0xf;
+            if (op == 0 || op == 2 || op == 3 || op == 7 || op == 8) { // M, D, N, =, X consume the reference
+                len += v >> 4;
+            }
+        }
+        return r.pos + std::max<int64_t>(len, 1);
+    }
+
+    static auto makeSeekableReader(std::filesystem::path const& file, mmap_policy policy) -> VarBufferedReader {
+        if (!is_regular_file(file)) {
+            throw std::runtime_error{"region queries require a regular bam file, " + file.string() + " is not"};
+        }
+        return bgzf_seekable_reader{mmap_reader{file, policy}};
+    }
+    static auto makeSeekableReader(std::istream& file, mmap_policy) -> VarBufferedReader {
+        return bgzf_seekable_reader{stream_reader{file}};
+    }
+
+    auto findIndex() const -> std::filesystem::path {
+        if (!config.index.empty()) return config.index;
+        if (auto file = std::get_if<std::filesystem::path>(&config.input)) {
+            auto candidates = {std::filesystem::path{file->string() + ".bai"},
+                               std::filesystem::path{*file}.replace_extension(".bai"),
+                               std::filesystem::path{file->string() + ".csi"}};
+            for (auto const& c : candidates) {
+                if (std::filesystem::exists(c)) return c;
+            }
+        }
+        throw std::runtime_error{"no bai or csi index found, set bam::reader::config::index"};
+    }
+
+    void setRegion(int32_t refID, int32_t begin, int32_t end) {
+        if (!index) {
+            index = bin_index::load(findIndex());
+        }
+        if (!seekable) {
+            ureader  = std::visit([&](auto& p) { return makeSeekableReader(p, config.mmapPolicy); }, config.input);
+            seekable = true;
+        }
+        lastUsed = 0;
+        region   = Region{refID, begin, end};
+        chunks   = (refID < 0) ? std::vector<bgzf_chunk>{} : index->query(refID, begin, end);
+        chunkIdx = 0;
+        needSeek = true;
+    }
+
+    // next record overlapping the region, only the chunks listed by the index are visited
+    auto nextInRegion() -> std::optional<bam::record_view> {
+        while (chunkIdx < chunks.size()) {
+            if (needSeek) {
+                ureader.seek(chunks[chunkIdx].begin);
+                lastUsed = 0;
+                needSeek = false;
+            }
+            ureader.dropUntil(lastUsed);
+            lastUsed = 0;
+            auto offset = ureader.tell();
+            if (offset >= chunks[chunkIdx].end) { // continue with the next chunk
+                chunkIdx += 1;
+                needSeek = chunkIdx < chunks.size() && offset < chunks[chunkIdx].begin;
+                continue;
+            }
+            auto r = readRecord();
+            // the file is sorted, no further records can overlap the region
+            if (!r || r->refID != region->refID || r->pos >= region->end) {
+                chunkIdx = chunks.size();
+                break;
+            }
+            if (referenceEnd(*r) > region->begin) {
+                return r;
+            }
+        }
+        return std::nullopt;
+    }
+
+    auto next() -> std::optional<bam::record_view> {
+        if (region) return nextInRegion();
+        return readRecord();
+    }
+
+    // virtual offset of the next record
+    auto tell() -> size_t {
+        // moves the window only, the last record stays valid
+        ureader.dropUntil(lastUsed);
+        lastUsed = 0;
+        return ureader.tell();
+    }
+
+    void seek(size_t offset) {
+        region.reset();
+        chunks.clear();
+        ureader.seek(offset);
+        lastUsed = 0;
+    }
 };
 }
 
@@ -125,7 +253,7 @@ namespace ivio::bam {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(p, config_.threadNbr);
+        return std::make_unique<pimpl>(config_, p, config_.threadNbr, config_.mmapPolicy);
     }, config_.input)}
 {
     pimpl_->readHeader();
@@ -145,6 +273,21 @@ void reader::close() {
     pimpl_.reset();
 }
 
+auto reader::tell() const -> size_t {
+    assert(pimpl_);
+    return pimpl_->tell();
+}
+
+void reader::seek(size_t offset) {
+    assert(pimpl_);
+    pimpl_->seek(offset);
+}
+
+void reader::region(int32_t refID, int32_t begin, int32_t end) {
+    assert(pimpl_);
+    pimpl_->setRegion(refID, begin, end);
+}
+
 static_assert(record_reader_c<reader>);
 
 }
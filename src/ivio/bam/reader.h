@@ -4,6 +4,8 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/io_uring_reader_config.h"
+#include "../detail/mmap_policy.h"
 #include "../detail/reader_base.h"
 #include "header.h"
 #include "record.h"
@@ -28,6 +30,16 @@ struct reader : public reader_base<reader> {
         std::variant<std::filesystem::path, std::reference_wrapper<std::istream>> input;
 
         size_t threadNbr = 0;
+
+        // Access hints for memory mapped files, e.g. mmap_policy::random() for random access (ignored for streams)
+        mmap_policy mmapPolicy{};
+
+        // Pipes and other files which can not be memory mapped are read ahead asynchronously (io_uring)
+        io_uring_reader_config readAhead{};
+
+        // BAI or CSI index, only used by region(). If empty, "<input>.bai", "<input without .bam>.bai"
+        // and "<input>.csi" are tried
+        std::filesystem::path index{};
     };
 
 public:
@@ -41,6 +53,31 @@ public:
 
     //!doc: see record_reader_c<reader> concept
     void close();
+
+    /**
+     * Reports the virtual offset of the next record (compressed offset of its bgzf block << 16 | offset inside the block)
+     *
+     * The offset can be passed to seek() of any reader of the same file, as used by BAI and CSI indices.
+     */
+    auto tell() const -> size_t;
+
+    /**
+     * Continues reading at the virtual offset `offset`, which must be the beginning of a record
+     *
+     * Ends a restriction set by region(). Requires a seekable input, with multiple threads the
+     * workers are restarted at the new position.
+     */
+    void seek(size_t offset);
+
+    /**
+     * Restricts reading to records of reference `refID` overlapping [begin, end) (0-based)
+     *
+     * Requires a coordinate sorted, seekable bam file and its BAI or CSI index (see config::index).
+     * Only the bgzf blocks listed by the index for this region are decompressed, reading stops at
+     * the first record behind the region. Afterwards next() returns the records of the region,
+     * followed by std::nullopt. region() can be called repeatedly, reading is always single threaded.
+     */
+    void region(int32_t refID, int32_t begin, int32_t end);
 };
 
 static_assert(record_reader_c<reader>);
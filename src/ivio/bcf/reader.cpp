@@ -2,9 +2,11 @@
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
 #include "../detail/bgzf_reader.h"
+#include "../detail/bgzf_seekable_reader.h"
 #include "../detail/bgzf_mt_reader.h"
 #include "../detail/buffered_reader.h"
 #include "../detail/file_reader.h"
+#include "../detail/io_uring_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
 #include "../detail/zlib_file_reader.h"
@@ -173,20 +175,26 @@ struct reader_base<bcf::reader>::pimpl {
     std::vector<std::tuple<std::string, std::string>> header;
     std::vector<std::string> genotypes;
 
-    pimpl(std::filesystem::path file, size_t threadNbr)
+    pimpl(std::filesystem::path file, size_t threadNbr, mmap_policy policy, io_uring_reader_config readAhead)
         : ureader {[&]() -> VarBufferedReader {
+            if (!is_regular_file(file)) { // pipes and other special files can not be mapped
+                if (threadNbr == 0) {
+                    return bgzf_seekable_reader{io_uring_reader{file, readAhead}};
+                }
+                return bgzf_mt_reader{io_uring_reader{file, readAhead}, threadNbr};
+            }
             if (threadNbr == 0) {
-                return make_buffered_reader<1<<16>(bgzf_reader{mmap_reader{file}});
+                return bgzf_seekable_reader{mmap_reader{file, policy}};
             }
-            return make_buffered_reader<1<<16>(bgzf_mt_reader{mmap_reader{file}, threadNbr});
+            return bgzf_mt_reader{mmap_reader{file, policy}, threadNbr};
         }()}
     {}
-    pimpl(std::istream& file, size_t threadNbr)
+    pimpl(std::istream& file, size_t threadNbr, mmap_policy, io_uring_reader_config)
         : ureader {[&]() -> VarBufferedReader {
             if (threadNbr == 0) {
-                return make_buffered_reader<1<<16>(bgzf_reader{stream_reader{file}});
+                return bgzf_seekable_reader{stream_reader{file}};
             }
-            return make_buffered_reader<1<<16>(bgzf_mt_reader{stream_reader{file}, threadNbr});
+            return bgzf_mt_reader{stream_reader{file}, threadNbr};
         }()}
     {}
 
@@ -341,6 +349,19 @@ struct reader_base<bcf::reader>::pimpl {
         };
         return r;
     }
+
+    // virtual offset of the next record
+    auto tell() -> size_t {
+        // moves the window only, the last record stays valid
+        ureader.dropUntil(lastUsed);
+        lastUsed = 0;
+        return ureader.tell();
+    }
+
+    void seek(size_t offset) {
+        ureader.seek(offset);
+        lastUsed = 0;
+    }
 };
 }
 
@@ -348,7 +369,7 @@ namespace ivio::bcf {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(p, config_.threadNbr);
+        return std::make_unique<pimpl>(p, config_.threadNbr, config_.mmapPolicy, config_.readAhead);
     }, config_.input)}
 {
     pimpl_->readHeader();
@@ -367,6 +388,16 @@ void reader::close() {
     pimpl_.reset();
 }
 
+auto reader::tell() const -> size_t {
+    assert(pimpl_);
+    return pimpl_->tell();
+}
+
+void reader::seek(size_t offset) {
+    assert(pimpl_);
+    pimpl_->seek(offset);
+}
+
 static_assert(record_reader_c<reader>);
 
 }
@@ -4,6 +4,8 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/io_uring_reader_config.h"
+#include "../detail/mmap_policy.h"
 #include "../detail/reader_base.h"
 #include "header.h"
 #include "record.h"
@@ -29,6 +31,12 @@ struct reader : public reader_base<reader> {
 
         // Value of 0 will run with a sequential implementation, other values will spawn new threads
         size_t threadNbr = 0;
+
+        // Access hints for memory mapped files, e.g. mmap_policy::random() for random access (ignored for streams)
+        mmap_policy mmapPolicy{};
+
+        // Pipes and other files which can not be memory mapped are read ahead asynchronously (io_uring)
+        io_uring_reader_config readAhead{};
     };
 
 public:
@@ -42,6 +50,20 @@ public:
 
     //!doc: see record_reader_c<reader> concept
     void close();
+
+    /**
+     * Reports the virtual offset of the next record (compressed offset of its bgzf block << 16 | offset inside the block)
+     *
+     * The offset can be passed to seek() of any reader of the same file, as used by CSI indices.
+     */
+    auto tell() const -> size_t;
+
+    /**
+     * Continues reading at the virtual offset `offset`, which must be the beginning of a record
+     *
+     * Requires a seekable input, with multiple threads the workers are restarted at the new position.
+     */
+    void seek(size_t offset);
 };
 
 static_assert(record_reader_c<reader>);
@@ -1,12 +1,16 @@
 // SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
+#include "../detail/async_writer.h"
+#include "../detail/bgzf_mt_writer.h"
 #include "../detail/bgzf_writer.h"
+#include "../detail/bin_index_builder.h"
 #include "writer.h"
 
 #include <array>
 #include <cassert>
 #include <cstddef>
+#include <optional>
 #include <variant>
 
 #include <iostream>
@@ -98,25 +102,77 @@ struct bcf_buffer {
 template <>
 struct ivio::writer_base<ivio::bcf::writer>::pimpl {
     //!TODO support other writers
-    using Writers = std::variant<ivio::bgzf_file_writer>;
+    using Writers = ivio::async_variant<ivio::bgzf_file_writer,
+                                        ivio::bgzf_mt_file_writer>;
 
 
     Writers writer;
     bcf_buffer buffer;
 
+    // on the fly indexing
+    std::filesystem::path                   indexPath;
+    std::optional<ivio::bin_index_builder>  indexBuilder;
+    uint64_t                                offset{}; // number of uncompressed bytes written
+    size_t                                  contigCount{};
 
-    pimpl(std::filesystem::path output)
+    pimpl(std::filesystem::path output, size_t threadNbr, bool async, ivio::file_writer_config fileConfig)
         : writer {[&]() -> Writers {
-            return ivio::bgzf_file_writer{output};
+            if (threadNbr == 0) {
+                return ivio::makeAsyncOptional<Writers>(async, ivio::bgzf_file_writer{ivio::file_writer{output, fileConfig}});
+            }
+            return ivio::makeAsyncOptional<Writers>(async, ivio::bgzf_mt_file_writer{ivio::file_writer{output, fileConfig}, threadNbr});
         }()}
+        , indexPath{output.string() + ".csi"}
     {}
 
-    pimpl(std::ostream& /*output*/)
+    pimpl(std::ostream& /*output*/, size_t /*threadNbr*/, bool /*async*/, ivio::file_writer_config /*fileConfig*/)
         : writer {[&]() -> Writers {
             //!TODO
             throw std::runtime_error("streams are currently not supported");
         }()}
     {}
+
+    // the index is only written by an explicit close(), on destruction the
+    // bgzf writers finish the file and swallow errors
+    ~pimpl() = default;
+
+    // the bgzf writer, possibly wrapped by an async_writer
+    static auto& bgzfWriter(auto& writer) {
+        if constexpr (requires { writer.writer; }) {
+            return writer.writer;
+        } else {
+            return writer;
+        }
+    }
+
+    void enableIndex() {
+        indexBuilder.emplace();
+        std::visit([](auto& writer) {
+            bgzfWriter(writer).trackBlocks = true;
+        }, writer);
+    }
+
+    void write(std::span<char const> data) {
+        std::visit([&](auto& writer) {
+            writer.write(data);
+        }, writer);
+        offset += data.size();
+    }
+
+    void close() {
+        std::visit([](auto& writer) {
+            writer.close();
+        }, writer);
+        if (indexBuilder) {
+            auto index = std::visit([&](auto& writer) {
+                return indexBuilder->finish(contigCount, bgzfWriter(writer).blocks);
+            }, writer);
+            indexBuilder.reset();
+            auto file = ivio::bgzf_file_writer{indexPath};
+            file.write(index.toCsi());
+            file.close();
+        }
+    }
 };
 
 
@@ -124,11 +180,18 @@ namespace ivio::bcf {
 
 writer::writer(config config_)
     : writer_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(p);
+        return std::make_unique<pimpl>(p, config_.threadNbr, config_.async, config_.fileConfig);
     }, config_.output)}
 {
+    if (config_.writeIndex) {
+        pimpl_->enableIndex();
+        for (auto const& [key, value] : config_.header.table) {
+            pimpl_->contigCount += (key == "contig") ? 1 : 0;
+        }
+    }
+
     // writing the header
-    std::visit([&](auto& writer) {
+    {
         // write leading table
         auto ss = std::string{};
         ss = "##fileformat=VCFv4.3\n";
@@ -147,13 +210,15 @@ writer::writer(config config_)
             for (auto const& s : config_.header.genotypes) {
                 ss += '\t' + s;
             }
+            ss += '\n';
+            ss += '\0'; // header text is NUL terminated
         }
 
         auto buffer = std::array<char, 9>{'B', 'C', 'F', 2, 2};
-        bgzf_writer::detail::bgzfPack(static_cast<uint16_t>(ss.size()), &buffer[5]);
-        writer.write(buffer);
-        writer.write(ss);
-    }, pimpl_->writer);
+        bgzf_writer::detail::bgzfPack(static_cast<uint32_t>(ss.size()), &buffer[5]);
+        pimpl_->write(buffer);
+        pimpl_->write(ss);
+    }
 }
 
 writer::~writer() = default;
@@ -202,12 +267,17 @@ void writer::write(record_view r) {
 
 
 
-    std::visit([&](auto& writer) {
-       writer.write(buffer.buffer);
-    }, pimpl_->writer);
+    if (pimpl_->indexBuilder) {
+        auto offset = pimpl_->offset;
+        pimpl_->indexBuilder->add(r.chromId, r.pos, int64_t{r.pos} + r.rlen, offset, offset + buffer.buffer.size());
+    }
+    pimpl_->write(buffer.buffer);
 }
 
 void writer::close() {
+    if (!pimpl_) return;
+    // closing explicitly, errors of the background thread are thrown here and not in a destructor
+    pimpl_->close();
     pimpl_.reset();
 }
 
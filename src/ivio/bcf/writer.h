@@ -4,6 +4,7 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/file_writer_config.h"
 #include "../detail/writer_base.h"
 #include "header.h"
 #include "record.h"
@@ -26,6 +27,20 @@ struct writer : writer_base<writer> {
 
         // Header
         bcf::header header{};
+
+        // Value of 0 will run with a sequential implementation, other values will spawn new threads
+        size_t threadNbr = 0;
+
+        // Compression and disk I/O run on a background thread, while the calling thread formats records.
+        // close() waits until everything is written
+        bool async{};
+
+        // Create a CSI index "<output>.csi" on an explicit close() (not by the destructor), while the records are written.
+        // Records must be sorted by chromId and pos, otherwise write() throws
+        bool writeIndex{};
+
+        // Buffer size, O_DIRECT and space reservation of output files (ignored for streams)
+        file_writer_config fileConfig{};
     };
 
     writer(config config_);
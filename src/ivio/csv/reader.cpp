@@ -3,8 +3,10 @@
 // SPDX-License-Identifier: BSD-3-Clause
 #include "../detail/buffered_reader.h"
 #include "../detail/file_reader.h"
+#include "../detail/gzip_seekable_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
+#include "../detail/structural_index.h"
 #include "../detail/zlib_file_reader.h"
 #include "reader.h"
 
@@ -28,7 +30,10 @@ namespace ivio::csv {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(makeZlibReader(p), config_.delimiter, config_.trim);
+        if (config_.checkpointSpacing > 0) {
+            return std::make_unique<pimpl>(makeSeekableZlibReader(p, config_.checkpointSpacing, config_.checkpointIndex, config_.mmapPolicy, config_.readAhead), config_.delimiter, config_.trim);
+        }
+        return std::make_unique<pimpl>(makeZlibReader(p, config_.mmapPolicy, config_.readAhead), config_.delimiter, config_.trim);
     }, config_.input)}
 {}
 
@@ -56,27 +61,23 @@ auto reader::next() -> std::optional<record_view> {
     }
     auto line = ureader.string_view(0, lineEnd);
     entries.clear();
-    while (line.size()) {
-        auto pos = line.find(delimiter);
-        if (pos == std::string::npos) {
-            pos = line.size();
+    if (line.size()) {
+        // a delimiter at the end of the line does not start another entry
+        if (line.back() == delimiter) {
+            line = line.substr(0, line.size()-1);
         }
-        auto entry = line.substr(0, pos);
-        // remove white spaces at end and beginning of entry
-        if (trim) {
-            while (entry.size() && (entry[0] == ' ' || entry[0] == '\t')) {
-                entry = entry.substr(1);
-            }
-            while (entry.size() && (entry.back() == ' ' || entry.back() == '\t')) {
-                entry = entry.substr(0, entry.size()-1);
+        detail::forEachField(line, delimiter, [&](std::string_view entry) {
+            // remove white spaces at end and beginning of entry
+            if (trim) {
+                while (entry.size() && (entry[0] == ' ' || entry[0] == '\t')) {
+                    entry = entry.substr(1);
+                }
+                while (entry.size() && (entry.back() == ' ' || entry.back() == '\t')) {
+                    entry = entry.substr(0, entry.size()-1);
+                }
             }
-        }
-        entries.emplace_back(entry);
-        if (pos < line.size()) {
-            line = line.substr(pos+1);
-        } else {
-            line = {};
-        }
+            entries.emplace_back(entry);
+        });
     }
 
     lastUsed = lineEnd+1;
@@ -4,6 +4,8 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/io_uring_reader_config.h"
+#include "../detail/mmap_policy.h"
 #include "../detail/reader_base.h"
 #include "../faidx/record.h"
 #include "record.h"
@@ -24,6 +26,20 @@ struct reader : public reader_base<reader> {
         std::variant<std::filesystem::path, std::reference_wrapper<std::istream>> input;
         char delimiter{','};
         bool trim{false}; // trim whitespaces
+
+        // Access hints for memory mapped files, e.g. mmap_policy::random() for random access (ignored for streams)
+        mmap_policy mmapPolicy{};
+
+        // Pipes and other files which can not be memory mapped are read ahead asynchronously (io_uring)
+        io_uring_reader_config readAhead{};
+
+        // Gzip files only: records a random access checkpoint every `checkpointSpacing` decompressed bytes
+        // (e.g. 1MiB), so tell/seek work with uncompressed offsets and seek only inflates from the closest
+        // checkpoint. The checkpoints are written to `checkpointIndex` (if empty "<input>.gzidx") once
+        // the end of the file is reached and are reused when the file is opened again.
+        // Value of 0 disables checkpoints (files with checkpoints are always decompressed sequentially)
+        size_t checkpointSpacing = 0;
+        std::filesystem::path checkpointIndex{};
     };
 
 public:
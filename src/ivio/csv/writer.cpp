@@ -1,8 +1,11 @@
 // SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
+#include "../detail/async_writer.h"
+#include "../detail/bgzf_mt_writer.h"
 #include "../detail/buffered_writer.h"
 #include "../detail/file_writer.h"
+#include "../detail/gzip_mt_writer.h"
 #include "../detail/stream_writer.h"
 #include "../detail/zlib_file_writer.h"
 #include "writer.h"
@@ -13,33 +16,45 @@ namespace ivio {
 
 template <>
 struct writer_base<csv::writer>::pimpl {
-    using Writers = std::variant<file_writer,
-                                 buffered_writer<zlib_file_writer>,
-                                 stream_writer,
-                                 buffered_writer<zlib_stream_writer>
+    using Writers = async_variant<file_writer,
+                                  buffered_writer<zlib_file_writer>,
+                                  gzip_mt_file_writer,
+                                  bgzf_file_writer,
+                                  bgzf_mt_file_writer,
+                                  stream_writer,
+                                  buffered_writer<zlib_stream_writer>,
+                                  gzip_mt_stream_writer,
+                                  bgzf_stream_writer,
+                                  bgzf_mt_stream_writer
                                  >;
 
     Writers writer;
     char delimiter;
     std::string buffer;
-    pimpl(std::filesystem::path output, bool, char _delimiter)
+    pimpl(std::filesystem::path output, csv::writer::config const& config_)
         : writer {[&]() -> Writers {
+            if (output.extension() == ".bgz" || config_.bgzf) {
+                return makeBgzfWriter<Writers>(file_writer{output, config_.fileConfig}, config_.threadNbr, config_.alignRecords, config_.async);
+            }
             if (output.extension() == ".gz") {
-                return buffered_writer{zlib_file_writer{file_writer{output}}};
+                return makeGzipWriter<Writers>(file_writer{output, config_.fileConfig}, config_.threadNbr, config_.compressionLevel, config_.async);
             }
-            return file_writer{output};
+            return makeAsyncOptional<Writers>(config_.async, file_writer{output, config_.fileConfig});
         }()}
-        , delimiter{_delimiter}
+        , delimiter{config_.delimiter}
     {}
 
-    pimpl(std::ostream& output, bool compressed, char _delimiter)
+    pimpl(std::ostream& output, csv::writer::config const& config_)
         : writer {[&]() -> Writers {
-            if (compressed) {
-                return buffered_writer{zlib_stream_writer{stream_writer{output}}};
+            if (config_.bgzf) {
+                return makeBgzfWriter<Writers>(stream_writer{output}, config_.threadNbr, config_.alignRecords, config_.async);
+            }
+            if (config_.compressed) {
+                return makeGzipWriter<Writers>(stream_writer{output}, config_.threadNbr, config_.compressionLevel, config_.async);
             }
-            return stream_writer{output};
+            return makeAsyncOptional<Writers>(config_.async, stream_writer{output});
         }()}
-        , delimiter{_delimiter}
+        , delimiter{config_.delimiter}
     {}
 };
 
@@ -49,7 +64,7 @@ namespace ivio::csv {
 
 writer::writer(config config_)
     : writer_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(p, config_.compressed, config_.delimiter);
+        return std::make_unique<pimpl>(p, config_);
     }, config_.output)}
 {
 }
@@ -74,6 +89,11 @@ void writer::write(record_view record) {
 }
 
 void writer::close() {
+    if (!pimpl_) return;
+    // closing explicitly, errors of the background thread are thrown here and not in a destructor
+    std::visit([](auto& writer) {
+        writer.close();
+    }, pimpl_->writer);
     pimpl_.reset();
 }
 
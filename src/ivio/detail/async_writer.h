@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "concepts.h"
+#include "job_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace ivio {
+
+//!WORKAROUND llvm < 18 and MSVC < 19.28 do not provide jthread
+// see bgzf_mt_reader.h for details
+#if (defined(__GLIBCXX__) || (_LIBCPP_VERSION >= 180000 && !__APPLE__) || _MSC_VER >= 1928) && !defined(__EMSCRIPTEN__)
+
+/* \brief moves the work of a writer onto a background thread
+ *
+ * Written data is collected in buffers of `bufferSize` bytes. Full buffers are
+ * handed over to a background thread, which passes them to the wrapped writer
+ * (e.g. compression and the actual file I/O). At most `queueSize` buffers are
+ * in flight, after that `write` blocks until the oldest one is written.
+ * Errors of the background thread are rethrown by the next `write` or `close`.
+ */
+template <writer_c Writer>
+struct async_writer {
+    struct Job {
+        std::vector<char> data;
+        bool              last{}; // last job, the writer is closed afterwards
+    };
+
+    Writer writer;
+    size_t bufferSize;
+    size_t queueSize;
+    std::vector<char> buffer{};
+
+    std::unique_ptr<job_ring<Job>> jobs{};
+    std::exception_ptr             error{};  // set by the background thread
+    std::atomic_bool               failed{}; // signals that error is set
+    bool                           closed{};
+    std::jthread                   thread{};
+
+    explicit async_writer(Writer&& _writer, size_t bufferSize = 1<<20, size_t queueSize = 4)
+        : writer{std::move(_writer)}
+        , bufferSize{std::max<size_t>(1, bufferSize)}
+        , queueSize{std::max<size_t>(1, queueSize)}
+    {}
+
+    // The thread is started lazily, so moving is only possible before the first buffer was submitted
+    async_writer(async_writer&& _other)
+        : writer{std::move(_other.writer)}
+        , bufferSize{_other.bufferSize}
+        , queueSize{_other.queueSize}
+        , buffer{std::move(_other.buffer)}
+    {
+        assert(!_other.thread.joinable());
+        _other.closed = true;
+    }
+
+    async_writer(async_writer const&) = delete;
+    auto operator=(async_writer const&) -> async_writer& = delete;
+    auto operator=(async_writer&&) -> async_writer& = delete;
+
+    ~async_writer() {
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
+    }
+
+private:
+    void startThread() {
+        jobs = std::make_unique<job_ring<Job>>(queueSize);
+        thread = std::jthread{[this]() {
+            while (true) {
+                auto& slot = jobs->front();
+                auto last = slot.job.last;
+                // after an error, jobs are only drained until the last one arrives
+                if (!failed.load(std::memory_order_relaxed)) {
+                    try {
+                        if (!slot.job.data.empty()) {
+                            writer.write(slot.job.data);
+                        }
+                        if (last) {
+                            writer.close();
+                        }
+                    } catch(...) {
+                        error = std::current_exception();
+                        failed.store(true, std::memory_order_release);
+                    }
+                }
+                slot.job.data.clear();
+                jobs->recycle();
+                if (last) return;
+            }
+        }};
+    }
+
+    // hands the buffer to the background thread and continues with an empty one
+    void submit(bool last) {
+        if (!thread.joinable()) {
+            startThread();
+        }
+        auto slot = jobs->acquire();
+        assert(slot);
+        std::swap(slot->job.data, buffer);
+        slot->job.last = last;
+        jobs->publish(*slot);
+        buffer.reserve(bufferSize);
+    }
+
+    void rethrowOnError() {
+        if (!failed.load(std::memory_order_acquire)) return;
+        if (!closed) {
+            closed = true;
+            submit(/*.last=*/true); // stops the background thread
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+public:
+    auto write(std::span<char const> data) -> size_t {
+        rethrowOnError();
+        buffer.insert(buffer.end(), data.begin(), data.end());
+        if (buffer.size() >= bufferSize) {
+            submit(/*.last=*/false);
+        }
+        return data.size();
+    }
+
+    void close() {
+        if (closed) return;
+        closed = true;
+
+        // nothing was handed over yet, no need to start a thread
+        if (!thread.joinable()) {
+            if (!buffer.empty()) {
+                writer.write(buffer);
+                buffer.clear();
+            }
+            writer.close();
+            return;
+        }
+        submit(/*.last=*/true);
+        thread.join();
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+};
+
+#else
+
+template <writer_c Writer>
+struct async_writer {
+    Writer writer;
+
+    explicit async_writer(Writer&& _writer, size_t bufferSize = 1<<20, size_t queueSize = 4)
+        : writer{std::move(_writer)}
+    {
+        (void)bufferSize;
+        (void)queueSize;
+    }
+
+    auto write(std::span<char const> data) -> size_t {
+        return writer.write(data);
+    }
+
+    void close() {
+        writer.close();
+    }
+};
+
+#endif
+
+/* \brief variant over the writers Ts, each also available wrapped by an async_writer
+ */
+template <writer_c... Ts>
+using async_variant = std::variant<Ts..., async_writer<Ts>...>;
+
+// returns writer as alternative of Variant, wrapped by an async_writer if requested
+template <typename Variant, writer_c Writer>
+auto makeAsyncOptional(bool async, Writer writer) -> Variant {
+    if (async) {
+        return Variant{std::in_place_type<async_writer<Writer>>, std::move(writer)};
+    }
+    return Variant{std::in_place_type<Writer>, std::move(writer)};
+}
+
+}
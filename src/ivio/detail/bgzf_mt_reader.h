@@ -4,11 +4,19 @@
 #pragma once
 
 #include "bgzf_reader.h"
-
-#include <condition_variable>
+#include "bgzf_seekable_reader.h"
+#include "job_ring.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <memory>
 #include <mutex>
+#include <span>
+#include <string>
 #include <thread>
-#include <list>
+#include <vector>
 
 namespace ivio {
 
@@ -19,155 +27,112 @@ namespace ivio {
 // !TODO this should work, but emcc can't find std::jthread
 #if (defined(__GLIBCXX__) || (_LIBCPP_VERSION >= 180000 && !__APPLE__) || _MSC_VER >= 1928) && !defined(__EMSCRIPTEN__)
 
-namespace bgzf_mt {
-
-template <typename Job>
-struct job_queue {
-    struct WrappedJob {
-        Job job;
-        std::mutex mutex;
-        std::condition_variable cv;
-        bool processing{};
-        bool doneflag{};
-
-        void reset() {
-            auto g = std::unique_lock{mutex};
-            processing = false;
-            doneflag = false;
-        }
-
-        void done() {
-            auto g = std::unique_lock{mutex};
-            doneflag = true;
-            cv.notify_one();
-        };
-
-        void await() {
-            auto g = std::unique_lock{mutex};
-//            if (doneflag) return;
-            cv.wait(g, [this]() {
-                return doneflag;
-            });
-        }
-    };
-
-
-    std::mutex mutex;
-    std::list<std::unique_ptr<WrappedJob>> jobs;
-    bool terminate{};
-    std::condition_variable cv;
-
-    job_queue() = default;
-    job_queue(job_queue const&) = delete;
-    job_queue(job_queue&& _other) {
-        auto g = std::scoped_lock(mutex, _other.mutex);
-
-        jobs = std::move(_other.jobs);
-    }
-    auto operator=(job_queue const&) -> job_queue& = delete;
-    auto operator=(job_queue&& _other) -> job_queue& {
-        auto g = std::scoped_lock(mutex, _other.mutex);
-
-        jobs = std::move(_other.jobs);
-        return *this;
-    }
-
-    void init_jobs(size_t nbr) {
-        for (size_t i{0}; i < nbr; ++i) {
-            jobs.emplace_back(std::make_unique<WrappedJob>());
-        }
-    }
-
-    ~job_queue() {
-        finish();
-    }
-
-    void finish() {
-        auto g = std::unique_lock(mutex);
-        terminate = true;
-        cv.notify_all();
-    }
-
-    auto begin() -> WrappedJob* {
-        auto g = std::unique_lock(mutex);
-        if (jobs.empty()) return nullptr;
-        return jobs.front().get();
-    }
-
-    void recycle() {
-        auto g = std::unique_lock(mutex);
-        auto ptr = std::move(jobs.front());
-        jobs.pop_front();
-        ptr->reset();
-        jobs.emplace_back(std::move(ptr));
-        cv.notify_one();
-    }
-
-    auto process_job() -> WrappedJob* {
-        while (true) {
-            auto g = std::unique_lock(mutex);
-            for (auto& job : jobs) {
-                auto g2 = std::unique_lock{job->mutex};
-                if (job->processing == false) {
-                    job->processing = true;
-                    return job.get();
-                }
-            }
-            if(terminate) return nullptr;
-            cv.wait(g);
-        }
-    }
-};
-}
-
 struct bgzf_mt_reader {
     struct Job {
         std::string                  decompressedOutput{std::string(1<<16, '\0')};
         std::string_view             output_view{};
         std::string                  compressedInput;
-        std::unique_ptr<ZlibContext> zlibCtx{std::make_unique<ZlibContext>()};
+        std::span<char const>        compressed;  // either points into compressedInput or directly into the mapped file
+        std::unique_ptr<BgzfContext> bgzfCtx{std::make_unique<BgzfContext>()};
+        std::exception_ptr           error;
+        bool                         eof{};
+        size_t                       coffset{};     // compressed offset of the block
+        size_t                       coffsetNext{}; // compressed offset of the following block
     };
 
     std::mutex ureaderMutex;
     VarBufferedReader reader;
-
-    bgzf_mt::job_queue<Job>  jobs;
+    bool readerFinished{}; // guarded by ureaderMutex
+
+    // If the input is memory mapped, blocks are not copied but handed to the workers as spans
+    bool                  zeroCopy{};
+    std::span<char const> mapping;       // mapped file, from file offset mappingStart to its end
+    size_t                mappingStart{}; // file offset of mapping[0]
+    size_t                mappingPos{};   // file offset of the next block, guarded by ureaderMutex
+    size_t                released{};     // file offset up to which the mapping was handed back to `reader`
+    size_t                readerPos{};    // compressed offset of the next block if not zeroCopy, guarded by ureaderMutex
+
+    size_t threadNbr;
+    job_ring<Job>    jobs;
     std::vector<std::jthread> threads;
 
     // returns if should be aborted
     bool work() {
         auto g = std::unique_lock{ureaderMutex};
-        auto job = jobs.process_job();
-        if (!job) return true;
-
-        auto& input  = job->job.compressedInput;
-        {
-            // copy from underlying buffer (locked)
-            // into the Job buffer
-            auto [ptr, avail_in] = reader.read(18);
-            if (avail_in == 0) return false; // End of processing
-            if (avail_in < 18) throw std::runtime_error{"failed reading (1)"};
-
-            size_t compressedLen = bgzfUnpack<uint16_t>(ptr + 16) + 1u;
-            std::tie(ptr, avail_in) = reader.read(compressedLen);
-            if (avail_in < compressedLen) throw std::runtime_error{"failed reading (2)"};
-            input.resize(compressedLen-18);
-            std::memcpy(input.data(), ptr+18, compressedLen-18);
-            reader.dropUntil(compressedLen);
-            g.unlock();
-        }
-
-        auto& output      = job->job.decompressedOutput;
-        auto& zlibCtx     = job->job.zlibCtx;
-        auto& output_view = job->job.output_view;
-
-        size_t size = zlibCtx->decompressBlock({input.begin(), input.size()}, {output.data(), output.size()});
-        output_view = {output.begin(), output.begin() + size};
-        job->done();
+        if (readerFinished) return true;
+        auto slot = jobs.acquire();
+        if (!slot) return true;
+        auto& job = slot->job;
+
+        try {
+            if (zeroCopy) {
+                // only the block header is inspected (locked)
+                auto avail_in = mappingStart + mapping.size() - mappingPos;
+                job.coffset = job.coffsetNext = mappingPos;
+                if (avail_in == 0) { // End of processing
+                    readerFinished = true;
+                    job.eof = true;
+                    job.output_view = {};
+                    jobs.publish(*slot);
+                    return true;
+                }
+                if (avail_in < 18) throw std::runtime_error{"failed reading (1)"};
+
+                auto block = mapping.subspan(mappingPos - mappingStart);
+                size_t compressedLen = bgzfUnpack<uint16_t>(block.data() + 16) + 1u;
+                if (avail_in < compressedLen) throw std::runtime_error{"failed reading (2)"};
+                job.compressed = block.subspan(18, compressedLen - 18);
+                mappingPos += compressedLen;
+                job.coffsetNext = mappingPos;
+            } else {
+                // copy from underlying buffer (locked)
+                // into the Job buffer
+                auto [ptr, avail_in] = reader.read(18);
+                job.coffset = job.coffsetNext = readerPos;
+                if (avail_in == 0) { // End of processing
+                    readerFinished = true;
+                    job.eof = true;
+                    job.output_view = {};
+                    jobs.publish(*slot);
+                    return true;
+                }
+                if (avail_in < 18) throw std::runtime_error{"failed reading (1)"};
+
+                size_t compressedLen = bgzfUnpack<uint16_t>(ptr + 16) + 1u;
+                std::tie(ptr, avail_in) = reader.read(compressedLen);
+                if (avail_in < compressedLen) throw std::runtime_error{"failed reading (2)"};
+                auto& input = job.compressedInput;
+                input.resize(compressedLen-18);
+                std::memcpy(input.data(), ptr+18, compressedLen-18);
+                reader.dropUntil(compressedLen);
+                job.compressed = input;
+                readerPos += compressedLen;
+                job.coffsetNext = readerPos;
+            }
+        } catch(...) {
+            readerFinished = true;
+            job.error = std::current_exception();
+            jobs.publish(*slot);
+            return true;
+        }
+        g.unlock();
+
+        auto& output      = job.decompressedOutput;
+        auto& bgzfCtx     = job.bgzfCtx;
+        auto& output_view = job.output_view;
+
+        try {
+            size_t size = bgzfCtx->decompressBlock(job.compressed, {output.data(), output.size()});
+            output_view = {output.begin(), output.begin() + size};
+        } catch(...) {
+            job.error = std::current_exception();
+        }
+        jobs.publish(*slot);
         return false;
     }
 
-    void startThread(size_t threadNbr) {
+    // threads are started lazily on the first read, this keeps bgzf_mt_reader movable until then
+    void startThreads() {
         while (threads.size() < threadNbr) {
             threads.emplace_back(std::jthread{[this](std::stop_token stoken) {
                 while(!stoken.stop_requested()) {
@@ -181,19 +146,40 @@ struct bgzf_mt_reader {
 
     bgzf_mt_reader(VarBufferedReader reader_, size_t threadNbr=1)
         : reader{std::move(reader_)}
+        , threadNbr{std::max<size_t>(1, threadNbr)}
+        , jobs{this->threadNbr*2}
+    {}
+
+#if (defined(unix) || defined(__unix__) || defined(__unix))
+    // The complete file is mapped into memory, workers decompress directly from the mapping
+    bgzf_mt_reader(mmap_reader reader_, size_t threadNbr=1)
+        : zeroCopy{true}
+        , mapping{[&]() {
+            auto [ptr, size] = reader_.read(0);
+            return std::span<char const>{ptr, size};
+        }()}
+        , threadNbr{std::max<size_t>(1, threadNbr)}
+        , jobs{this->threadNbr*2}
     {
-        startThread(threadNbr);
-        jobs.init_jobs(threadNbr+1);
+        // blocks in front of the oldest block in use are passed to mmap_reader::dropUntil (see releaseMapping),
+        // which applies the mmap_policy, the rest of the mapping stays valid
+        reader = std::move(reader_);
     }
+#endif
 
     bgzf_mt_reader(bgzf_mt_reader const&) = delete;
-    bgzf_mt_reader(bgzf_mt_reader&& _other) {
-        auto threadNbr = _other.threads.size();
-        _other.jobs.finish();
-        _other.threads.clear();
-        jobs   = std::move(_other.jobs);
-        reader = std::move(_other.reader);
-        startThread(threadNbr);
+    bgzf_mt_reader(bgzf_mt_reader&& _other)
+        : reader{std::move(_other.reader)}
+        , zeroCopy{_other.zeroCopy}
+        , mapping{_other.mapping}
+        , mappingStart{_other.mappingStart}
+        , mappingPos{_other.mappingPos}
+        , released{_other.released}
+        , readerPos{_other.readerPos}
+        , threadNbr{_other.threadNbr}
+        , jobs{threadNbr*2}
+    {
+        assert(_other.threads.empty());
     }
 
     auto operator=(bgzf_mt_reader const&) -> bgzf_mt_reader& = delete;
@@ -204,32 +190,249 @@ struct bgzf_mt_reader {
         jobs.finish();
     }
 
-    size_t read(std::ranges::contiguous_range auto&& range) {
-        static_assert(std::same_as<std::ranges::range_value_t<decltype(range)>, char>);
-        auto next = jobs.begin();
-        if (!next) return 0; // abort, nothing to do, finished everything
+private:
+    // Decompressed blocks are consumed in place. Only if a request crosses a
+    // block boundary, the remaining bytes are copied into `stitch`.
+    std::string_view  front{};         // decompressed data of the oldest block in use
+    size_t            frontPos{};      // start of the window inside front (if not stitching)
+    bool              frontEof{};      // no more blocks available
+    bool              started{};
+
+    bool              stitching{};
+    std::vector<char> stitch;
+    size_t            stitchPos{};     // start of the window inside stitch
+    size_t            stitchSplit{};   // stitch[stitchSplit..] is a copy of front[0..frontCopied)
+    size_t            frontCopied{};
+
+    // origin of the data in front of the window, to report virtual offsets
+    size_t            frontCoffset{};     // compressed offset of front
+    size_t            frontCoffsetNext{}; // compressed offset of the block behind front
+    size_t            startOffset{};      // virtual offset of the first byte, until started
+    struct Segment {
+        size_t begin;       // stitch[begin..] stems from this block
+        size_t coffset;
+        size_t coffsetNext;
+        size_t uoffset;     // offset of stitch[begin] inside the decompressed block
+        size_t blockSize;
+    };
+    std::vector<Segment> stitchSegments;
+
+    void start() {
+        if (started) return;
+        started = true;
+        startThreads();
+        nextFront();
+        auto uoffset = startOffset & 0xffff;
+        if (uoffset > front.size()) {
+            throw std::runtime_error{"invalid bgzf virtual offset " + std::to_string(startOffset)};
+        }
+        frontPos = uoffset;
+    }
+
+    // waits for the next non empty block
+    void nextFront() {
+        while (true) {
+            auto& job = jobs.front().job;
+            if (job.error) {
+                std::rethrow_exception(job.error);
+            }
+            frontCoffset     = job.coffset;
+            frontCoffsetNext = job.coffsetNext;
+            releaseMapping(frontCoffset);
+            if (job.eof) {
+                front    = {};
+                frontEof = true;
+                return;
+            }
+            if (!job.output_view.empty()) {
+                front = job.output_view;
+                return;
+            }
+            jobs.recycle(); // empty blocks (e.g. the EOF marker) are skipped
+        }
+    }
+
+    /* zero copy: all blocks in front of `coffset` are decompressed, the mapped file is consumed up to there
+     * This unmaps/drops consumed pages and announces read ahead, according to the mmap_policy.
+     */
+    void releaseMapping(size_t coffset) {
+        if (!zeroCopy || coffset <= released) return;
+        reader.dropUntil(coffset - released);
+        released = coffset;
+    }
+
+    // hands the oldest block back to the workers
+    void releaseFront() {
+        jobs.recycle();
+        nextFront();
+    }
 
-        next->await();
+    // continues stitching with the current front, starting at stitch[stitchSplit]
+    void addStitchSegment(size_t uoffset) {
+        stitchSegments.push_back({stitchSplit, frontCoffset, frontCoffsetNext, uoffset, front.size()});
+    }
 
-        auto& output_view = next->job.output_view;
+    static auto virtualOffset(size_t coffset, size_t coffsetNext, size_t uoffset, size_t blockSize) -> size_t {
+        if (uoffset < blockSize) {
+            return (coffset << 16) | uoffset;
+        }
+        return coffsetNext << 16; // end of a block is reported as the beginning of the next one
+    }
 
-        size_t size = std::min(range.size(), output_view.size());
-        std::memcpy(range.data(), output_view.data(), size);
-        output_view = output_view.substr(size);
+    auto window() const -> std::string_view {
+        if (stitching) {
+            return {stitch.data() + stitchPos, stitch.size() - stitchPos};
+        }
+        return front.substr(frontPos);
+    }
 
-        if (output_view.empty()) {
-            jobs.recycle();
+    // extends the window, returns false if the end of the file is reached
+    bool grow() {
+        if (!stitching) {
+            if (frontEof) return false;
+            if (frontPos == front.size()) { // nothing to preserve, continue with the next block
+                releaseFront();
+                frontPos = 0;
+                return !frontEof;
+            }
+            stitching = true;
+            stitch.assign(front.begin() + frontPos, front.end());
+            stitchPos   = 0;
+            stitchSplit = 0;
+            stitchSegments.clear();
+            addStitchSegment(frontPos);
+            releaseFront();
+            stitchSplit = stitch.size();
+            frontCopied = 0;
+            addStitchSegment(0);
+        } else if (frontCopied == front.size()) {
+            if (frontEof) return false;
+            releaseFront();
+            stitchSplit = stitch.size();
+            frontCopied = 0;
+            addStitchSegment(0);
         }
+        if (frontEof) return false;
 
-        return size;
+        // copy only parts of the block, the rest is consumed in place after the stitched part was dropped
+        auto len = std::min(front.size() - frontCopied, std::max<size_t>(1<<12, stitch.size() - stitchPos));
+        stitch.insert(stitch.end(), front.begin() + frontCopied, front.begin() + frontCopied + len);
+        frontCopied += len;
+        return true;
+    }
+
+public:
+    size_t readUntil(char c, size_t lastUsed) {
+        start();
+        while (true) {
+            auto w = window();
+            auto pos = w.find(c, lastUsed);
+            if (pos != std::string_view::npos) {
+                return pos;
+            }
+            lastUsed = std::max(lastUsed, w.size());
+            if (!grow()) {
+                return window().size();
+            }
+        }
+    }
+
+    auto read(size_t ct) -> std::tuple<char const*, size_t> {
+        start();
+        while (window().size() < ct) {
+            if (!grow()) break;
+        }
+        auto w = window();
+        return {w.data(), w.size()};
+    }
+
+    void dropUntil(size_t i) {
+        start();
+        if (!stitching) {
+            frontPos += i;
+            assert(frontPos <= front.size());
+            return;
+        }
+        auto p = stitchPos + i;
+        assert(p <= stitch.size());
+        if (p < stitchSplit) {
+            stitchPos = p;
+            return;
+        }
+        // window only covers the current block, continue in place
+        // (stitch is kept as it is, views of the last record stay valid)
+        stitching = false;
+        frontPos  = p - stitchSplit;
+    }
+
+    bool eof(size_t i) {
+        start();
+        while (i >= window().size()) {
+            if (!grow()) return true;
+        }
+        return false;
+    }
+
+    auto string_view(size_t start, size_t end) -> std::string_view {
+        return window().substr(start, end - start);
+    }
+
+    // virtual offset of the start of the window
+    auto tell() const -> size_t {
+        if (!started) {
+            return startOffset;
+        }
+        if (stitching) {
+            auto iter = std::ranges::upper_bound(stitchSegments, stitchPos, {}, &Segment::begin) - 1;
+            return virtualOffset(iter->coffset, iter->coffsetNext, iter->uoffset + stitchPos - iter->begin, iter->blockSize);
+        }
+        return virtualOffset(frontCoffset, frontCoffsetNext, frontPos, front.size());
+    }
+
+    /* moves the window to the virtual offset `offset`
+     * Running workers are stopped, decompression restarts at the block of `offset`.
+     */
+    void seek(size_t offset) {
+        if (started) {
+            jobs.finish();
+            threads.clear(); // joins the workers
+            jobs.reset();
+            for (size_t i{0}; i < jobs.capacity; ++i) {
+                jobs.slots[i].job.eof   = false;
+                jobs.slots[i].job.error = nullptr;
+            }
+        }
+        auto coffset = offset >> 16;
+        if (zeroCopy) {
+            if (coffset > mappingStart + mapping.size()) {
+                throw std::runtime_error{"invalid bgzf virtual offset " + std::to_string(offset)};
+            }
+            // unmapped parts in front of the mapping are mapped again
+            reader.seek(coffset);
+            auto [ptr, size] = reader.read(0);
+            mapping      = {ptr, size};
+            mappingStart = coffset;
+            mappingPos   = coffset;
+            released     = coffset;
+        } else {
+            reader.seek(coffset);
+            readerPos = coffset;
+        }
+        readerFinished = false;
+        started        = false;
+        front          = {};
+        frontPos       = 0;
+        frontEof       = false;
+        stitching      = false;
+        startOffset    = offset;
     }
 };
 
 #else
 
-struct bgzf_mt_reader : bgzf_reader {
+struct bgzf_mt_reader : bgzf_seekable_reader {
     bgzf_mt_reader(VarBufferedReader reader_, size_t threadNbr=1)
-        : bgzf_reader{std::move(reader_)}
+        : bgzf_seekable_reader{std::move(reader_)}
     {
         (void)threadNbr;
     }
@@ -237,6 +440,7 @@ struct bgzf_mt_reader : bgzf_reader {
 
 
 #endif
-static_assert(Readable<bgzf_mt_reader>);
+static_assert(BufferedReadable<bgzf_mt_reader>);
+static_assert(Seekable<bgzf_mt_reader>);
 
 }
@@ -0,0 +1,246 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "async_writer.h"
+#include "bgzf_writer.h"
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivio {
+
+//!WORKAROUND llvm < 18 and MSVC < 19.28 do not provide jthread
+// see bgzf_mt_reader.h for details
+#if (defined(__GLIBCXX__) || (_LIBCPP_VERSION >= 180000 && !__APPLE__) || _MSC_VER >= 1928) && !defined(__EMSCRIPTEN__)
+
+/* \brief BGZF writer that compresses blocks on a pool of worker threads
+ *
+ * Full blocks are handed to the workers in input order. The compressed blocks
+ * are written by the calling thread, also in input order. At most
+ * 2*threadNbr blocks are in flight, after that `write` blocks until the oldest
+ * block has been compressed.
+ */
+template <writer_c Writer>
+struct bgzf_mt_writer_impl {
+    static constexpr size_t fullLength = bgzf_writer_impl<Writer>::fullLength;
+
+    struct Job {
+        std::vector<char>  uncompressed;
+        std::vector<char>  compressed;
+        bool               ready{};
+        std::exception_ptr error;
+        std::unique_ptr<bgzf_writer::detail::BgzfContext> bgzfCtx{std::make_unique<bgzf_writer::detail::BgzfContext>()};
+    };
+
+    Writer file;
+    size_t threadNbr;
+    bool   alignWrites; // a single write is not split over two blocks, if it fits into one
+    bool   trackBlocks{}; // record the size of each written block in `blocks`
+    std::vector<char> buffer{};
+    std::vector<bgzf_writer::detail::BlockSize> blocks{};
+
+    std::mutex              mutex;
+    std::condition_variable cvWork; // notifies workers about new jobs
+    std::condition_variable cvDone; // notifies the writer about finished jobs
+    std::vector<Job>        jobs;   // used as ring buffer
+    size_t submitted{};             // number of jobs handed to the workers
+    size_t claimed{};               // number of jobs picked up by a worker
+    size_t written{};               // number of jobs written to file
+    bool   terminate{};
+    bool   closed{};
+
+    std::vector<std::jthread> threads;
+
+    template <typename T>
+    bgzf_mt_writer_impl(T&& name, size_t threadNbr, bool alignWrites = false)
+        : file(std::forward<T>(name))
+        , threadNbr{std::max<size_t>(1, threadNbr)}
+        , alignWrites{alignWrites}
+    {}
+
+    // Threads are started lazily, so moving is only possible before the first block was submitted
+    bgzf_mt_writer_impl(bgzf_mt_writer_impl&& _other)
+        : file{std::move(_other.file)}
+        , threadNbr{_other.threadNbr}
+        , alignWrites{_other.alignWrites}
+        , trackBlocks{_other.trackBlocks}
+        , buffer{std::move(_other.buffer)}
+        , blocks{std::move(_other.blocks)}
+    {
+        assert(_other.threads.empty());
+        _other.closed = true;
+    }
+
+    bgzf_mt_writer_impl(bgzf_mt_writer_impl const&) = delete;
+    auto operator=(bgzf_mt_writer_impl const&) -> bgzf_mt_writer_impl& = delete;
+    auto operator=(bgzf_mt_writer_impl&&) -> bgzf_mt_writer_impl& = delete;
+
+    ~bgzf_mt_writer_impl() {
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
+        stopThreads();
+    }
+
+private:
+    void startThreads() {
+        jobs.resize(threadNbr*2);
+        while (threads.size() < threadNbr) {
+            threads.emplace_back([this]() {
+                while (true) {
+                    auto g = std::unique_lock{mutex};
+                    cvWork.wait(g, [&]() { return terminate || claimed < submitted; });
+                    if (claimed == submitted) return; // terminate was requested and all work is done
+                    auto& job = jobs[claimed % jobs.size()];
+                    claimed += 1;
+                    g.unlock();
+
+                    try {
+                        job.compressed.resize(1<<16); // maximum size of a BGZF block
+                        auto length = job.bgzfCtx->compressBlock(job.uncompressed, job.compressed);
+                        job.compressed.resize(length);
+                    } catch(...) {
+                        job.error = std::current_exception();
+                    }
+
+                    g.lock();
+                    job.ready = true;
+                    cvDone.notify_one();
+                }
+            });
+        }
+    }
+
+    // writes the oldest job to file, if wait is false it will only write if it is already compressed
+    bool writeOldest(bool wait) {
+        auto g = std::unique_lock{mutex};
+        if (written == submitted) return false;
+        auto& job = jobs[written % jobs.size()];
+        if (!wait && !job.ready) return false;
+        cvDone.wait(g, [&]() { return job.ready; });
+        job.ready = false;
+        written += 1;
+        g.unlock();
+
+        if (job.error) {
+            std::rethrow_exception(std::exchange(job.error, nullptr));
+        }
+        if (trackBlocks) {
+            blocks.push_back({static_cast<uint32_t>(job.uncompressed.size()), static_cast<uint32_t>(job.compressed.size())});
+        }
+        file.write(job.compressed);
+        return true;
+    }
+
+    void stopThreads() {
+        {
+            auto g = std::unique_lock{mutex};
+            terminate = true;
+            cvWork.notify_all();
+        }
+        threads.clear();
+    }
+
+    void submit(std::span<char const> data) {
+        if (threads.empty()) {
+            startThreads();
+        }
+        // make room, if all jobs are in flight
+        if (submitted - written == jobs.size()) {
+            writeOldest(/*.wait=*/true);
+        }
+        auto& job = jobs[submitted % jobs.size()];
+        job.uncompressed.assign(data.begin(), data.end());
+        {
+            auto g = std::unique_lock{mutex};
+            submitted += 1;
+            cvWork.notify_one();
+        }
+        // write out everything that is already finished
+        while (writeOldest(/*.wait=*/false)) {}
+    }
+
+public:
+    auto write(std::span<char const> out) -> size_t {
+        // finish the current block early, instead of splitting `out`
+        if (alignWrites && !buffer.empty() && buffer.size() + out.size() > fullLength) {
+            submit(buffer);
+            buffer.clear();
+        }
+
+        auto oldSize = buffer.size();
+        buffer.resize(buffer.size() + out.size());
+//!WORKAROUND llvm < 16 does not provide std::ranges::copy
+#if defined(_LIBCPP_VERSION) && _LIBCPP_VERSION < 160000
+        std::copy(out.begin(), out.end(), buffer.data() + oldSize);
+#else
+        std::ranges::copy(out, buffer.data() + oldSize);
+#endif
+
+        size_t start{};
+        while (buffer.size() - start >= fullLength) {
+            submit({buffer.data() + start, fullLength});
+            start += fullLength;
+        }
+        // move left over data to the beginning
+        std::memmove(buffer.data(), buffer.data() + start, buffer.size() - start);
+        buffer.resize(buffer.size() - start);
+        return out.size();
+    }
+
+    void close() {
+        if (closed) return;
+        closed = true;
+
+        try {
+            if (!buffer.empty()) {
+                submit(buffer);
+                buffer.clear();
+            }
+            while (writeOldest(/*.wait=*/true)) {}
+        } catch(...) {
+            stopThreads();
+            throw;
+        }
+        stopThreads();
+        file.write(bgzf_writer::detail::eof_marker);
+        file.close();
+    }
+};
+
+#else
+
+template <writer_c Writer>
+struct bgzf_mt_writer_impl : bgzf_writer_impl<Writer> {
+    template <typename T>
+    bgzf_mt_writer_impl(T&& name, size_t threadNbr, bool alignWrites = false)
+        : bgzf_writer_impl<Writer>{std::forward<T>(name), alignWrites}
+    {
+        (void)threadNbr;
+    }
+};
+
+#endif
+
+using bgzf_mt_file_writer   = bgzf_mt_writer_impl<file_writer>;
+using bgzf_mt_stream_writer = bgzf_mt_writer_impl<stream_writer>;
+
+static_assert(writer_c<bgzf_mt_file_writer>);
+static_assert(writer_c<bgzf_mt_stream_writer>);
+
+// picks a sequential or a multi threaded BGZF writer, wrapped by an async_writer if requested
+template <typename Variant, writer_c Writer>
+auto makeBgzfWriter(Writer writer, size_t threadNbr, bool alignWrites, bool async) -> Variant {
+    if (threadNbr > 0) {
+        return makeAsyncOptional<Variant>(async, bgzf_mt_writer_impl<Writer>{std::move(writer), threadNbr, alignWrites});
+    }
+    return makeAsyncOptional<Variant>(async, bgzf_writer_impl<Writer>{std::move(writer), alignWrites});
+}
+}
@@ -5,13 +5,14 @@
 
 #include "buffered_reader.h"
 #include "file_reader.h"
+#include "libdeflate_context.h"
 #include "mmap_reader.h"
 #include "portable_endian.h"
 #include "stream_reader.h"
+#include "zlib_backend.h"
 
 #include <algorithm>
 #include <ranges>
-#include <zlib.h>
 
 namespace ivio {
 
@@ -61,11 +62,11 @@ struct ZlibContext {
     inline static constexpr size_t BlockHeaderLength = magic_bgzf_header.size();
     inline static constexpr size_t BlockFooterLength = 8;
 
-    z_stream strm{};
+    zlib::stream strm{};
 
     ZlibContext() {
         constexpr auto GzipWindowBits = -15; // no zlib header
-        auto status = inflateInit2(&strm, GzipWindowBits);
+        auto status = zlib::inflate_init2(strm, GzipWindowBits);
         if (status != Z_OK) {
             throw std::runtime_error{"BGZF inflateInit2() failed"};
         }
@@ -75,7 +76,7 @@ struct ZlibContext {
     ZlibContext(ZlibContext&&) = delete;
 
     ~ZlibContext() noexcept(false) {
-        auto status = inflateEnd(&strm);
+        auto status = zlib::inflate_end(strm);
         if (status != Z_OK) {
             throw std::runtime_error{"BGZF inflateEnd() failed"};
         }
@@ -86,7 +87,7 @@ struct ZlibContext {
 
 
     void reset() {
-        auto status = inflateReset(&strm);
+        auto status = zlib::inflate_reset(strm);
         if (status != Z_OK) {
             throw std::runtime_error{"BGZF inflateReset() failed"};
         }
@@ -111,18 +112,18 @@ struct ZlibContext {
 //        if (!detail::bgzf_compression::validate_header(std::span{srcBegin, srcLength})) {
 //            throw io_error("Invalid BGZF block header.");
 //        }
-        strm.next_in   = (Bytef *)in.data();
-        strm.next_out  = (Bytef *)out.data();
+        strm.next_in   = (unsigned char*)in.data();
+        strm.next_out  = (unsigned char*)out.data();
         strm.avail_in  = static_cast<uint32_t>(in.size()) - BlockFooterLength;
         strm.avail_out = static_cast<uint32_t>(out.size());
 
-        auto status = inflate(&strm, Z_FINISH);
+        auto status = zlib::inflate(strm, Z_FINISH);
         if (status != Z_STREAM_END) {
             throw std::runtime_error{"Inflation failed. Decompressed BGZF data is too big. " + std::to_string(strm.avail_in) + " " + std::to_string(strm.avail_out)};
         }
 
         // Compute and check checksum
-        unsigned crc = crc32(crc32(0, nullptr, 0), (Bytef *)out.data(), static_cast<uint32_t>(out.size() - strm.avail_out));
+        unsigned crc = zlib::crc32(0, out.data(), static_cast<uint32_t>(out.size() - strm.avail_out));
         unsigned ecrc = bgzfUnpack<uint32_t>(in.data() + in.size() - 8);
         if (ecrc != crc)
             throw std::runtime_error{"BGZF wrong checksum." + std::to_string(ecrc) + " " + std::to_string(crc)};
@@ -137,9 +138,17 @@ struct ZlibContext {
     }
 };
 
+// Backend used for decompressing BGZF blocks, selected by the cmake option IVIO_BGZF_BACKEND
+#ifdef IVIO_BGZF_BACKEND_LIBDEFLATE
+using BgzfContext = LibdeflateContext;
+#else
+using BgzfContext = ZlibContext;
+#endif
+
 struct bgzf_reader {
     VarBufferedReader reader;
-    ZlibContext       zlibCtx;
+    BgzfContext       bgzfCtx;
+    size_t            nextBlock{}; // compressed offset of the next block
 
     bgzf_reader(VarBufferedReader reader)
         : reader{std::move(reader)}
@@ -148,6 +157,7 @@ struct bgzf_reader {
     bgzf_reader(bgzf_reader const&) = delete;
     bgzf_reader(bgzf_reader&& _other)
         : reader{std::move(_other.reader)}
+        , nextBlock{_other.nextBlock}
     {}
 
     auto operator=(bgzf_reader const&) -> bgzf_reader& = delete;
@@ -169,11 +179,25 @@ struct bgzf_reader {
 
             assert(range.size() >= (1<<16));
 
-            size_t size = zlibCtx.decompressBlock({ptr+18, compressedLen-18}, {range.data(), range.size()});
+            size_t size = bgzfCtx.decompressBlock({ptr+18, compressedLen-18}, {range.data(), range.size()});
             reader.dropUntil(compressedLen);
+            nextBlock += compressedLen;
             return size;
         }
     }
+
+    /* Compressed offset of the block returned by the next call to `read`
+     * (Not named tell, the offset is not related to the decompressed data)
+     */
+    auto blockOffset() const -> size_t {
+        return nextBlock;
+    }
+
+    // Continues reading at the block starting at compressed offset `offset`
+    void seekBlock(size_t offset) {
+        reader.seek(offset);
+        nextBlock = offset;
+    }
 };
 
 static_assert(Readable<bgzf_reader>);
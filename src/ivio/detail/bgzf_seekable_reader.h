@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "bgzf_reader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace ivio {
+
+/* \brief BufferedReadable over a bgzf file, which supports tell/seek with virtual offsets
+ *
+ * A virtual offset is the compressed offset of a block shifted by 16 bits,
+ * combined with an offset into the decompressed data of that block, as used
+ * by BAI, CSI and TBI indices. If the window starts exactly at the end of a
+ * block, tell() reports the beginning of the next block.
+ */
+class bgzf_seekable_reader {
+    static constexpr size_t blockSize = 1<<16; // maximal size of a decompressed block
+
+    struct Block {
+        size_t coffset; // compressed offset of the block
+        size_t begin;   // logical position of its first decompressed byte
+    };
+
+    bgzf_reader         reader;
+    std::vector<char>   buffer;   // decompressed data, valid until `filled`
+    size_t              pos{};     // start of the window
+    size_t              filled{};
+    size_t              dropped{}; // logical position of buffer[0]
+    std::vector<Block>  blocks{};  // blocks with data in the buffer, each ends where the next one begins
+
+    // Appends the next non empty block, returns false at the end of the file
+    bool readBlock() {
+        // move the window to the front of the buffer and forget blocks in front of it
+        if (pos > 0) {
+            std::memmove(buffer.data(), buffer.data() + pos, filled - pos);
+            dropped += pos;
+            filled  -= pos;
+            pos      = 0;
+            size_t first{};
+            while (first + 1 < blocks.size() && blocks[first + 1].begin <= dropped) {
+                ++first;
+            }
+            if (filled == 0) {
+                first = blocks.size();
+            }
+            blocks.erase(blocks.begin(), blocks.begin() + first);
+        }
+        while (true) {
+            if (buffer.size() < filled + blockSize) {
+                buffer.resize(filled + blockSize);
+            }
+            auto coffset = reader.blockOffset();
+            auto size    = reader.read(std::span{buffer.data() + filled, blockSize});
+            if (size > 0) {
+                blocks.push_back({coffset, dropped + filled});
+                filled += size;
+                return true;
+            }
+            if (reader.blockOffset() == coffset) return false; // end of file
+            // empty block (e.g. an eof marker in between), continue with the next one
+        }
+    }
+
+    auto window() const -> std::string_view {
+        return {buffer.data() + pos, filled - pos};
+    }
+
+public:
+    bgzf_seekable_reader(VarBufferedReader reader)
+        : reader{std::move(reader)}
+    {}
+
+    bgzf_seekable_reader(bgzf_seekable_reader const&) = delete;
+    bgzf_seekable_reader(bgzf_seekable_reader&&) = default;
+    auto operator=(bgzf_seekable_reader const&) -> bgzf_seekable_reader& = delete;
+    auto operator=(bgzf_seekable_reader&&) -> bgzf_seekable_reader& = delete;
+
+    size_t readUntil(char c, size_t lastUsed) {
+        while (true) {
+            auto p = window().find(c, lastUsed);
+            if (p != std::string_view::npos) {
+                return p;
+            }
+            lastUsed = std::max(lastUsed, filled - pos); // only search new data
+            if (!readBlock()) {
+                return filled - pos;
+            }
+        }
+    }
+
+    auto read(size_t ct) -> std::tuple<char const*, size_t> {
+        while (filled - pos < ct) {
+            if (!readBlock()) break;
+        }
+        return {buffer.data() + pos, filled - pos};
+    }
+
+    void dropUntil(size_t i) {
+        assert(pos + i <= filled);
+        pos += i;
+    }
+
+    bool eof(size_t i) {
+        while (i >= filled - pos) {
+            if (!readBlock()) return true;
+        }
+        return false;
+    }
+
+    auto string_view(size_t start, size_t end) -> std::string_view {
+        return window().substr(start, end - start);
+    }
+
+    // virtual offset of the start of the window
+    auto tell() const -> size_t {
+        if (pos == filled) {
+            return reader.blockOffset() << 16;
+        }
+        auto p    = dropped + pos;
+        auto iter = std::ranges::upper_bound(blocks, p, {}, &Block::begin);
+        assert(iter != blocks.begin());
+        --iter;
+        return (iter->coffset << 16) | (p - iter->begin);
+    }
+
+    // moves the window to the virtual offset `offset`
+    void seek(size_t offset) {
+        auto coffset = offset >> 16;
+        auto uoffset = offset & 0xffff;
+        dropped = pos = filled = 0;
+        blocks.clear();
+        reader.seekBlock(coffset);
+        if (uoffset == 0) return;
+        if (!readBlock() || uoffset > filled) {
+            throw std::runtime_error{"invalid bgzf virtual offset " + std::to_string(offset)};
+        }
+        pos = uoffset;
+    }
+};
+
+static_assert(BufferedReadable<bgzf_seekable_reader>);
+static_assert(Seekable<bgzf_seekable_reader>);
+
+}
@@ -4,14 +4,16 @@
 #pragma once
 
 #include "file_writer.h"
+#include "stream_writer.h"
+#include "libdeflate_context.h"
 #include "portable_endian.h"
+#include "zlib_backend.h"
 
 #include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <cstring>
 #include <ranges>
-#include <zlib.h>
 
 namespace ivio {
 
@@ -48,6 +50,10 @@ inline constexpr char _magic_bgzf_header[] =
 
 inline constexpr auto magic_bgzf_header = std::string_view{_magic_bgzf_header, sizeof(_magic_bgzf_header)};
 
+// empty block, which marks the end of a BGZF file
+inline constexpr auto eof_marker = std::string_view{
+    "\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00", 28};
+
 template <typename T>
 inline auto bgzfPack(T v, char* buffer) -> size_t {
     if constexpr (std::integral<T>) {
@@ -61,18 +67,18 @@ struct ZlibContext {
     inline static constexpr size_t BlockHeaderLength = magic_bgzf_header.size();
     inline static constexpr size_t BlockFooterLength = 8;
 
-    z_stream stream{};
+    zlib::stream stream{};
 
     ZlibContext() {
         constexpr auto GzipWindowBits = -15; // no zlib header
-        auto status = deflateInit2(&stream, 6, Z_DEFLATED, GzipWindowBits, 8, Z_DEFAULT_STRATEGY);
+        auto status = zlib::deflate_init2(stream, 6, GzipWindowBits, 8, Z_DEFAULT_STRATEGY);
         if (status != Z_OK) {
             throw "BGZF deflateInit2() failed";
         }
     }
 
     ~ZlibContext() noexcept(false) {
-        auto status = deflateEnd(&stream);
+        auto status = zlib::deflate_end(stream);
         if (status != Z_OK) {
             throw "BGZF inflateEnd() failed";
         }
@@ -80,7 +86,7 @@ struct ZlibContext {
     }
 
     void reset() {
-        auto status = deflateReset(&stream);
+        auto status = zlib::deflate_reset(stream);
         if (status != Z_OK) {
             throw "BGZF deflateReset() failed";
         }
@@ -105,12 +111,12 @@ struct ZlibContext {
         for (size_t i{0}; i < sizeof(_magic_bgzf_header); ++i) {
             out[i] = _magic_bgzf_header[i];
         }
-        stream.next_in   = (Bytef *)in.data();
-        stream.next_out  = (Bytef *)out.data()+18;
+        stream.next_in   = (unsigned char*)in.data();
+        stream.next_out  = (unsigned char*)out.data()+18;
         stream.avail_in  = static_cast<uint32_t>(in.size());
         stream.avail_out = static_cast<uint32_t>(out.size())-18-BlockFooterLength;
 
-        auto status = deflate(&stream, Z_FINISH);
+        auto status = zlib::deflate(stream, Z_FINISH);
         if (status != Z_STREAM_END) {
             throw std::runtime_error{"Deflation failed. compressed BGZF data is too big. " + std::to_string(stream.avail_in) + " " + std::to_string(stream.avail_out)};
         }
@@ -118,7 +124,7 @@ struct ZlibContext {
         auto length = out.size() - stream.avail_out;
         bgzf_writer::detail::bgzfPack(static_cast<uint16_t>(length-1ul), &out[16]);
 
-        uint32_t crc = crc32(crc32(0, nullptr, 0), (Bytef *)in.data(), static_cast<uint32_t>(in.size()));
+        uint32_t crc = zlib::crc32(0, in.data(), static_cast<uint32_t>(in.size()));
 
         bgzf_writer::detail::bgzfPack(static_cast<uint32_t>(crc), &out[length-8ul]);
         bgzf_writer::detail::bgzfPack(static_cast<uint32_t>(in.size()), &out[length-4ul]);
@@ -140,31 +146,77 @@ struct ZlibContext {
     }
 };
 
+// uncompressed and compressed size of a written block, used to compute virtual offsets
+struct BlockSize {
+    uint32_t uncompressed;
+    uint32_t compressed;
+};
+
+// Backend used for compressing BGZF blocks, selected by the cmake option IVIO_BGZF_BACKEND
+#ifdef IVIO_BGZF_BACKEND_LIBDEFLATE
+using BgzfContext = LibdeflateContext;
+#else
+using BgzfContext = ZlibContext;
+#endif
+
 }
 
 template <writer_c Writer>
 struct bgzf_writer_impl {
     Writer      file;
-    bgzf_writer::detail::ZlibContext zlibCtx;
+    bgzf_writer::detail::BgzfContext bgzfCtx;
+    bool        alignWrites; // a single write is not split over two blocks, if it fits into one
+    bool        closed{};
+    bool        trackBlocks{}; // record the size of each written block in `blocks`
 
     std::vector<char> buffer{};
     std::vector<char> outBuffer{};
+    std::vector<bgzf_writer::detail::BlockSize> blocks{};
 
     template <typename T>
-    bgzf_writer_impl(T&& name)
+    bgzf_writer_impl(T&& name, bool alignWrites = false)
         : file(std::forward<T>(name))
+        , alignWrites{alignWrites}
     {}
 
     bgzf_writer_impl(bgzf_writer_impl&& _other)
         : file{std::move(_other.file)}
-    {}
+        , alignWrites{_other.alignWrites}
+        , trackBlocks{_other.trackBlocks}
+        , buffer{std::move(_other.buffer)}
+        , blocks{std::move(_other.blocks)}
+    {
+        _other.closed = true;
+    }
 
     ~bgzf_writer_impl() {
-        close();
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
+    }
+
+private:
+    void writeBlock(std::span<char const> v) {
+        outBuffer.resize(1<<16); // maximum size of a BGZF block
+        auto length = bgzfCtx.compressBlock(v, outBuffer);
+        outBuffer.resize(length);
+        if (trackBlocks) {
+            blocks.push_back({static_cast<uint32_t>(v.size()), static_cast<uint32_t>(length)});
+        }
+
+        // write to file
+        file.write(outBuffer);
     }
 
+public:
     static constexpr auto fullLength = 65280;
     auto write(std::span<char const> out) -> size_t {
+        // finish the current block early, instead of splitting `out`
+        if (alignWrites && !buffer.empty() && buffer.size() + out.size() > fullLength) {
+            writeBlock(buffer);
+            buffer.clear();
+        }
+
         auto oldSize = buffer.size();
         buffer.resize(buffer.size() + out.size());
 //!WORKAROUND llvm < 16 does not provide std::ranges::copy
@@ -174,17 +226,8 @@ struct bgzf_writer_impl {
         std::ranges::copy(out, buffer.data() + oldSize);
 #endif
 
-        auto writeData = [&](std::span<char const> v) {
-            outBuffer.resize(fullLength);
-            auto length = zlibCtx.compressBlock(v, outBuffer);
-            outBuffer.resize(length);
-
-            // write to file
-            file.write(outBuffer);
-        };
-
         while (buffer.size() >= fullLength) {
-            writeData({buffer.data(), buffer.data() + fullLength});
+            writeBlock({buffer.data(), buffer.data() + fullLength});
 
             // move left over data to the beginning
             std::memcpy(buffer.data(), buffer.data() + fullLength, buffer.size() - fullLength);//!TODO maybe with ranges::copy?
@@ -194,22 +237,21 @@ struct bgzf_writer_impl {
     }
 
     void close() {
+        if (closed) return;
+        closed = true;
+
         assert(buffer.size() < fullLength);
         if (!buffer.empty()) {
-            outBuffer.resize(fullLength);
-            auto length = zlibCtx.compressBlock({buffer.data(), buffer.size()}, outBuffer);
-            outBuffer.resize(length);
-
-            // write to file
-            file.write(outBuffer);
-
+            writeBlock(buffer);
             buffer.clear();
         }
+        file.write(bgzf_writer::detail::eof_marker);
         file.close();
     }
 };
 
 using bgzf_file_writer   = bgzf_writer_impl<file_writer>;
+using bgzf_stream_writer = bgzf_writer_impl<stream_writer>;
 //using bgzf_mmap_reader   = bgzf_reader_impl<mmap_reader>;
 //using bgzf_stream_reader = bgzf_reader_impl<buffered_reader<stream_reader>>;
 //
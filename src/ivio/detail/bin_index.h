@@ -0,0 +1,388 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "bgzf_reader.h"
+#include "bgzf_writer.h"
+#include "buffered_reader.h"
+#include "mmap_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ivio {
+
+// range of a bgzf file [begin, end), given as virtual offsets
+struct bgzf_chunk {
+    uint64_t begin;
+    uint64_t end;
+
+    auto operator<=>(bgzf_chunk const&) const = default;
+};
+
+/* \brief binning index of a coordinate sorted bgzf file (BAI, CSI and TBI)
+ *
+ * Each reference is divided into a hierarchy of bins, the first level covers
+ * 2^(minShift+3*depth) positions, each further level splits a bin into 8. A
+ * record is assigned to the smallest bin which contains it completely, each
+ * bin lists the chunks of the file holding its records. BAI uses minShift 14
+ * and depth 5 together with a linear index of 16KiB windows, CSI stores
+ * minShift and depth explicitly and a lowest offset per bin instead.
+ */
+struct bin_index {
+    struct bin {
+        std::vector<bgzf_chunk> chunks;
+        uint64_t                loffset{}; // CSI: virtual offset of the first record overlapping the bin
+    };
+    // content of the pseudo bin
+    struct reference_meta {
+        uint64_t begin;    // virtual offset of the first record
+        uint64_t end;      // virtual offset behind the last record
+        uint64_t mapped;   // number of placed records
+        uint64_t unmapped; // number of unplaced records (with a reference, but without a position)
+    };
+    struct reference {
+        std::unordered_map<uint32_t, bin> bins;
+        std::vector<uint64_t>             intervals; // BAI/TBI: virtual offset of the first record of each 2^minShift window
+        std::optional<reference_meta>     meta;
+    };
+    // header of TBI indices, also stored as aux data of CSI indices created by tabix
+    struct tabix_meta {
+        int32_t format{2};  // 0: generic, 1: SAM, 2: VCF, 0x10000 is set for 0-based half-open coordinates
+        int32_t colSeq{1};  // 1-based column of the reference name
+        int32_t colBeg{2};  // 1-based column of the start position
+        int32_t colEnd{0};  // 1-based column of the end position, 0 if not present
+        char    meta{'#'};  // lines starting with this character are skipped
+        int32_t skip{};     // number of lines skipped at the beginning of the file
+        std::vector<std::string> names; // name of each reference
+    };
+
+    int32_t                 minShift{14};
+    int32_t                 depth{5};
+    std::vector<reference>  references;
+    std::optional<uint64_t> unplacedCount; // number of records without coordinates, if recorded
+    std::vector<char>       aux;           // CSI: auxiliary data (e.g. the tabix header)
+    std::optional<tabix_meta> tabix;       // TBI and CSI indices of text files
+
+    // the pseudo bin stores meta data and no records
+    auto pseudoBin() const -> uint32_t {
+        return static_cast<uint32_t>(((1ull << ((depth + 1) * 3)) - 1) / 7 + 1);
+    }
+
+    // first bin of level `level`
+    static auto levelOffset(int32_t level) -> uint32_t {
+        return static_cast<uint32_t>(((1ull << (level * 3)) - 1) / 7);
+    }
+
+    // bin of level `level` containing position `pos`
+    auto binAt(int32_t level, int64_t pos) const -> uint32_t {
+        return levelOffset(level) + static_cast<uint32_t>(pos >> (minShift + (depth - level) * 3));
+    }
+
+    // smallest bin containing [begin, end) completely (reg2bin of the SAM specification)
+    auto regionToBin(int64_t begin, int64_t end) const -> uint32_t {
+        end -= 1;
+        for (auto level = depth; level > 0; --level) {
+            auto shift = minShift + (depth - level) * 3;
+            if (begin >> shift == end >> shift) {
+                return binAt(level, begin);
+            }
+        }
+        return 0;
+    }
+
+    // all bins which may contain records overlapping [begin, end) (reg2bins of the SAM specification)
+    auto regionToBins(int64_t begin, int64_t end) const -> std::vector<uint32_t> {
+        auto res = std::vector<uint32_t>{};
+        end -= 1;
+        for (int32_t level{0}; level <= depth; ++level) {
+            auto first = binAt(level, begin);
+            auto last  = binAt(level, end);
+            for (auto b = first; b <= last; ++b) {
+                res.push_back(b);
+            }
+        }
+        return res;
+    }
+
+    // first position covered by bin `b`
+    auto binBegin(uint32_t b) const -> int64_t {
+        int32_t level{0};
+        while (level < depth && b >= levelOffset(level+1)) {
+            ++level;
+        }
+        return int64_t{b - levelOffset(level)} << (minShift + (depth - level) * 3);
+    }
+
+    // largest position that can be represented by this index
+    auto maxPosition() const -> int64_t {
+        return int64_t{1} << (minShift + depth * 3);
+    }
+
+    /* Returns the sorted and merged chunks, which contain all records of
+     * reference `refID` overlapping [begin, end) (0-based).
+     * The chunks may contain further records, which must be filtered by the caller.
+     */
+    auto query(size_t refID, int64_t begin, int64_t end) const -> std::vector<bgzf_chunk> {
+        begin = std::max<int64_t>(begin, 0);
+        end   = std::min(end, maxPosition());
+        if (refID >= references.size() || begin >= end) return {};
+        auto const& ref = references[refID];
+
+        // records in front of this offset end before `begin`
+        uint64_t minOffset{};
+        if (!ref.intervals.empty()) {
+            auto i = static_cast<size_t>(begin >> minShift);
+            minOffset = ref.intervals[std::min(i, ref.intervals.size()-1)];
+        } else {
+            for (auto level = depth; level >= 0; --level) {
+                if (auto iter = ref.bins.find(binAt(level, begin)); iter != ref.bins.end()) {
+                    minOffset = iter->second.loffset;
+                    break;
+                }
+            }
+        }
+
+        auto chunks = std::vector<bgzf_chunk>{};
+        for (auto b : regionToBins(begin, end)) {
+            auto iter = ref.bins.find(b);
+            if (iter == ref.bins.end()) continue;
+            for (auto const& c : iter->second.chunks) {
+                if (c.end > minOffset) {
+                    chunks.push_back({std::max(c.begin, minOffset), c.end});
+                }
+            }
+        }
+        std::ranges::sort(chunks);
+
+        // merge overlapping chunks and chunks which touch the same bgzf block
+        auto merged = std::vector<bgzf_chunk>{};
+        for (auto const& c : chunks) {
+            if (!merged.empty() && (c.begin <= merged.back().end || (c.begin >> 16) == (merged.back().end >> 16))) {
+                merged.back().end = std::max(merged.back().end, c.end);
+            } else {
+                merged.push_back(c);
+            }
+        }
+        return merged;
+    }
+
+private:
+    // reads little endian values from a buffer, checking its bounds
+    struct cursor {
+        std::string_view data;
+
+        template <typename T>
+        auto get() -> T {
+            if (data.size() < sizeof(T)) {
+                throw std::runtime_error{"index file is truncated"};
+            }
+            auto v = bgzfUnpack<T>(data.data());
+            data = data.substr(sizeof(T));
+            return v;
+        }
+
+        auto getBytes(size_t len) -> std::string_view {
+            if (data.size() < len) {
+                throw std::runtime_error{"index file is truncated"};
+            }
+            auto v = data.substr(0, len);
+            data = data.substr(len);
+            return v;
+        }
+    };
+
+    // reads the bins of all references, `withLoffset` for CSI
+    void readReferences(cursor& c, bool withLoffset) {
+        readReferences(c, withLoffset, c.get<int32_t>());
+    }
+    void readReferences(cursor& c, bool withLoffset, int32_t n_ref) {
+        if (n_ref < 0) throw std::runtime_error{"invalid number of references in index"};
+        references.resize(n_ref);
+        for (auto& ref : references) {
+            auto n_bin = c.get<int32_t>();
+            for (int32_t i{0}; i < n_bin; ++i) {
+                auto binNbr  = c.get<uint32_t>();
+                auto loffset = withLoffset ? c.get<uint64_t>() : uint64_t{};
+                auto n_chunk = c.get<int32_t>();
+                auto b = bin{.chunks = {}, .loffset = loffset};
+                for (int32_t j{0}; j < n_chunk; ++j) {
+                    auto begin = c.get<uint64_t>();
+                    auto end   = c.get<uint64_t>();
+                    b.chunks.push_back({begin, end});
+                }
+                if (binNbr != pseudoBin()) {
+                    ref.bins.emplace(binNbr, std::move(b));
+                } else if (b.chunks.size() == 2) {
+                    ref.meta = reference_meta{b.chunks[0].begin, b.chunks[0].end, b.chunks[1].begin, b.chunks[1].end};
+                }
+            }
+            if (!withLoffset) {
+                auto n_intv = c.get<int32_t>();
+                ref.intervals.reserve(std::max(0, n_intv));
+                for (int32_t i{0}; i < n_intv; ++i) {
+                    ref.intervals.push_back(c.get<uint64_t>());
+                }
+            }
+        }
+        if (c.data.size() >= sizeof(uint64_t)) {
+            unplacedCount = c.get<uint64_t>();
+        }
+    }
+
+    static auto readTabixMeta(cursor& c) -> tabix_meta {
+        auto meta = tabix_meta{};
+        meta.format = c.get<int32_t>();
+        meta.colSeq = c.get<int32_t>();
+        meta.colBeg = c.get<int32_t>();
+        meta.colEnd = c.get<int32_t>();
+        meta.meta   = static_cast<char>(c.get<int32_t>());
+        meta.skip   = c.get<int32_t>();
+        auto l_nm   = c.get<int32_t>();
+        if (l_nm < 0) throw std::runtime_error{"invalid tabix header"};
+        auto names = c.getBytes(l_nm);
+        while (!names.empty()) { // concatenated, null terminated names
+            auto len = std::min(names.find('\0'), names.size());
+            meta.names.emplace_back(names.substr(0, len));
+            names = names.substr(std::min(len + 1, names.size()));
+        }
+        return meta;
+    }
+
+public:
+    // parses a BAI index (uncompressed)
+    static auto fromBai(std::string_view data) -> bin_index {
+        auto c = cursor{data};
+        if (c.getBytes(4) != std::string_view{"BAI\1", 4}) {
+            throw std::runtime_error{"not a BAI index"};
+        }
+        auto index = bin_index{};
+        index.readReferences(c, /*.withLoffset=*/false);
+        return index;
+    }
+
+    // parses a CSI index (already decompressed)
+    static auto fromCsi(std::string_view data) -> bin_index {
+        auto c = cursor{data};
+        if (c.getBytes(4) != std::string_view{"CSI\1", 4}) {
+            throw std::runtime_error{"not a CSI index"};
+        }
+        auto index = bin_index{};
+        index.minShift = c.get<int32_t>();
+        index.depth    = c.get<int32_t>();
+        if (index.minShift < 0 || index.depth < 0 || index.minShift + index.depth * 3 > 60) {
+            throw std::runtime_error{"invalid CSI index parameters"};
+        }
+        auto l_aux = c.get<int32_t>();
+        if (l_aux < 0) throw std::runtime_error{"invalid CSI index"};
+        auto aux = c.getBytes(l_aux);
+        index.aux.assign(aux.begin(), aux.end());
+        if (aux.size() >= 7 * sizeof(int32_t)) { // tabix header
+            auto ac = cursor{aux};
+            index.tabix = readTabixMeta(ac);
+        }
+        index.readReferences(c, /*.withLoffset=*/true);
+        return index;
+    }
+
+    // parses a TBI index (already decompressed)
+    static auto fromTbi(std::string_view data) -> bin_index {
+        auto c = cursor{data};
+        if (c.getBytes(4) != std::string_view{"TBI\1", 4}) {
+            throw std::runtime_error{"not a TBI index"};
+        }
+        auto index = bin_index{};
+        auto n_ref = c.get<int32_t>();
+        index.tabix = readTabixMeta(c);
+        index.readReferences(c, /*.withLoffset=*/false, n_ref);
+        return index;
+    }
+
+    // serializes the index in CSI format (uncompressed), bins are sorted by number
+    auto toCsi() const -> std::string {
+        auto res = std::string{"CSI\1"};
+        auto put = [&]<typename T>(T v) {
+            char buffer[sizeof(T)];
+            bgzf_writer::detail::bgzfPack(v, buffer);
+            res.append(buffer, sizeof(T));
+        };
+        put(int32_t{minShift});
+        put(int32_t{depth});
+        put(static_cast<int32_t>(aux.size()));
+        res.append(aux.data(), aux.size());
+        put(static_cast<int32_t>(references.size()));
+        for (auto const& ref : references) {
+            auto binNbrs = std::vector<uint32_t>{};
+            for (auto const& [binNbr, b] : ref.bins) {
+                binNbrs.push_back(binNbr);
+            }
+            std::ranges::sort(binNbrs);
+            put(static_cast<int32_t>(binNbrs.size() + (ref.meta ? 1 : 0)));
+            for (auto binNbr : binNbrs) {
+                auto const& b = ref.bins.at(binNbr);
+                put(binNbr);
+                put(b.loffset);
+                put(static_cast<int32_t>(b.chunks.size()));
+                for (auto const& c : b.chunks) {
+                    put(c.begin);
+                    put(c.end);
+                }
+            }
+            if (ref.meta) {
+                put(pseudoBin());
+                put(uint64_t{});
+                put(int32_t{2});
+                put(ref.meta->begin);
+                put(ref.meta->end);
+                put(ref.meta->mapped);
+                put(ref.meta->unmapped);
+            }
+        }
+        if (unplacedCount) {
+            put(*unplacedCount);
+        }
+        return res;
+    }
+
+    /* Loads a BAI, CSI or TBI index from file
+     * CSI and TBI files are bgzf compressed, BAI files are not.
+     */
+    static auto load(std::filesystem::path const& path) -> bin_index {
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error{"index file " + path.string() + " does not exist"};
+        }
+        auto data = readFile(path);
+        if (data.starts_with("BAI\1")) {
+            return fromBai(data);
+        }
+        if (data.starts_with("CSI\1")) {
+            return fromCsi(data);
+        }
+        if (data.starts_with("TBI\1")) {
+            return fromTbi(data);
+        }
+        throw std::runtime_error{"unknown index format of " + path.string()};
+    }
+
+    // reads a file completely, decompressing it if it is bgzf compressed
+    static auto readFile(std::filesystem::path const& path) -> std::string {
+        auto reader = VarBufferedReader{mmap_reader{path}};
+        auto [ptr, size] = reader.read(2);
+        if (size >= 2 && ptr[0] == '\x1f' && ptr[1] == '\x8b') {
+            reader = VarBufferedReader{make_buffered_reader<1<<16>(bgzf_reader{std::move(reader)})};
+        }
+        std::tie(ptr, size) = reader.read(std::numeric_limits<size_t>::max());
+        return std::string{ptr, size};
+    }
+};
+
+}
@@ -0,0 +1,131 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "bgzf_writer.h"
+#include "bin_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ivio {
+
+/* \brief builds a CSI index while a coordinate sorted bgzf file is written
+ *
+ * Records are added in the order they are written, together with their offsets
+ * in the uncompressed data. Chunks of consecutive records sharing a bin are
+ * extended on the fly, and the first record overlapping each 2^minShift window
+ * is noted. When the file is complete, finish() translates all offsets into
+ * virtual offsets with the help of the sizes of the written bgzf blocks, so the
+ * file never has to be read again.
+ */
+struct bin_index_builder {
+    static constexpr auto noOffset = std::numeric_limits<uint64_t>::max();
+
+    bin_index index{};
+    std::vector<std::vector<uint64_t>> windows{}; // per reference: offset of the first record overlapping each window
+    int32_t lastRefID{-1};
+    int64_t lastBegin{};
+
+    /* Adds a record of reference `refID` covering [begin, end) (0-based)
+     * `offset` and `offsetEnd` are the uncompressed offsets of the record and behind it.
+     */
+    void add(int32_t refID, int64_t begin, int64_t end, uint64_t offset, uint64_t offsetEnd) {
+        if (refID < 0) {
+            index.unplacedCount = index.unplacedCount.value_or(0) + 1;
+            return;
+        }
+        if (refID < lastRefID || (refID == lastRefID && begin < lastBegin)) {
+            throw std::runtime_error{"records must be sorted by reference and position to be indexed"};
+        }
+        end = std::max(end, begin + 1);
+        if (begin < 0 || end > index.maxPosition()) {
+            throw std::runtime_error{"position " + std::to_string(begin) + " can not be indexed"};
+        }
+        lastRefID = refID;
+        lastBegin = begin;
+        if (static_cast<size_t>(refID) >= index.references.size()) {
+            index.references.resize(refID + 1);
+            windows.resize(refID + 1);
+        }
+        auto& ref = index.references[refID];
+
+        auto& chunks = ref.bins[index.regionToBin(begin, end)].chunks;
+        if (!chunks.empty() && chunks.back().end == offset) {
+            chunks.back().end = offsetEnd;
+        } else {
+            chunks.push_back({offset, offsetEnd});
+        }
+
+        auto& w = windows[refID];
+        auto last = static_cast<size_t>((end - 1) >> index.minShift);
+        if (w.size() <= last) {
+            w.resize(last + 1, noOffset);
+        }
+        for (auto i = static_cast<size_t>(begin >> index.minShift); i <= last; ++i) {
+            if (w[i] == noOffset) w[i] = offset;
+        }
+
+        if (!ref.meta) {
+            ref.meta = bin_index::reference_meta{offset, offsetEnd, 0, 0};
+        }
+        ref.meta->end     = offsetEnd;
+        ref.meta->mapped += 1;
+    }
+
+    /* Returns the CSI index of at least `referenceCount` references, `blocks` are the sizes
+     * of all written bgzf blocks, starting at the beginning of the file.
+     */
+    auto finish(size_t referenceCount, std::span<bgzf_writer::detail::BlockSize const> blocks) -> bin_index {
+        // uncompressed and compressed offset of each block
+        auto ustarts = std::vector<uint64_t>{0};
+        auto cstarts = std::vector<uint64_t>{0};
+        for (auto const& b : blocks) {
+            ustarts.push_back(ustarts.back() + b.uncompressed);
+            cstarts.push_back(cstarts.back() + b.compressed);
+        }
+        // an offset at the end of a block points to the beginning of the next one
+        auto toVirtual = [&](uint64_t offset) -> uint64_t {
+            if (offset >= ustarts.back()) {
+                return cstarts.back() << 16;
+            }
+            auto i = static_cast<size_t>(std::ranges::upper_bound(ustarts, offset) - ustarts.begin()) - 1;
+            return (cstarts[i] << 16) | (offset - ustarts[i]);
+        };
+
+        if (index.references.size() < referenceCount) {
+            index.references.resize(referenceCount);
+            windows.resize(referenceCount);
+        }
+        for (size_t refID{0}; refID < index.references.size(); ++refID) {
+            auto& ref = index.references[refID];
+            auto& w   = windows[refID];
+            // empty windows take the offset of the next record, which lies behind them
+            for (size_t i{w.size()}; i > 1; --i) {
+                if (w[i-2] == noOffset) w[i-2] = w[i-1];
+            }
+            for (auto& [binNbr, b] : ref.bins) {
+                b.loffset = toVirtual(w[static_cast<size_t>(index.binBegin(binNbr) >> index.minShift)]);
+                for (auto& c : b.chunks) {
+                    c = {toVirtual(c.begin), toVirtual(c.end)};
+                }
+            }
+            if (ref.meta) {
+                ref.meta->begin = toVirtual(ref.meta->begin);
+                ref.meta->end   = toVirtual(ref.meta->end);
+            }
+        }
+        if (!index.unplacedCount) {
+            index.unplacedCount = 0;
+        }
+        return std::move(index);
+    }
+};
+
+}
@@ -4,20 +4,28 @@
 #pragma once
 
 #include "concepts.h"
+#include "ring_buffer.h"
 
+#include <algorithm>
 #include <any>
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <tuple>
 #include <vector>
 
 namespace ivio {
 
+/* \brief buffers a Readable and makes it a BufferedReadable
+ *
+ * Data is read into a ring_buffer, dropping data only advances an offset. At
+ * least `minV` bytes are requested from the reader on each refill.
+ */
 template <typename Reader, size_t minV = (1<<12)>
 class buffered_reader {
     Reader reader;
-    std::vector<char> buf = []() { auto vec = std::vector<char>{}; vec.reserve(minV); return vec; }();
-    size_t inPos{};
+    ring_buffer buf{std::max<size_t>(minV*4, 1<<16)};
 
 public:
     buffered_reader(Reader reader)
@@ -28,64 +36,52 @@ public:
 
 private:
     auto readMore() -> bool {
-        size_t lastSize = buf.size();
-        if (buf.capacity() - buf.size() >= minV) {
-            buf.resize(buf.capacity());
-        } else {
-            buf.resize(buf.capacity()*2);
-        }
-
-        auto bytes_read = reader.read(std::span{buf.data() + lastSize, buf.size() - lastSize});
-        buf.resize(lastSize + bytes_read);
-
+        auto bytes_read = reader.read(buf.free(minV));
+        buf.commit(bytes_read);
         return bytes_read != 0;
     }
 
+    auto view() const -> std::string_view {
+        return {buf.data(), buf.size()};
+    }
+
 public:
     size_t readUntil(char c, size_t lastUsed) {
         while (true) {
-            auto pos = std::string_view{buf.data(), buf.size()}.find(c, lastUsed + inPos);
+            auto pos = view().find(c, lastUsed);
             if (pos != std::string_view::npos) {
-                return pos - inPos;
+                return pos;
             }
-
+            lastUsed = std::max(lastUsed, buf.size()); // only search new data
             if (!readMore()) {
-                return buf.size() - inPos;
+                return buf.size();
             }
         }
     }
 
     auto read(size_t ct) -> std::tuple<char const*, size_t> {
-        while (buf.size()-inPos < ct) {
+        while (buf.size() < ct) {
             if (!readMore()) break;
         }
-        return {buf.data()+inPos, buf.size()-inPos};
+        return {buf.data(), buf.size()};
     }
 
     void dropUntil(size_t i) {
-        i = i + inPos;
-        if (i < minV) {
-            inPos = i;
-            return;
-        }
-        std::copy(begin(buf)+i, end(buf), begin(buf));
-        buf.resize(buf.size()-i);
-        inPos = 0;
+        buf.drop(i);
     }
 
     bool eof(size_t i) const {
-        return i+inPos == buf.size();
+        return i == buf.size();
     }
 
     auto string_view(size_t start, size_t end) -> std::string_view {
-        return std::string_view{buf.data()+start+inPos, buf.data()+end+inPos};
+        return view().substr(start, end - start);
     }
 
     auto tell() const -> size_t requires Seekable<Reader> {
-        return reader.tell() - buf.size() + inPos;
+        return reader.tell() - buf.size();
     }
     void seek(size_t offset) requires Seekable<Reader> {
-        inPos = 0;
         buf.clear();
         reader.seek(offset);
     }
@@ -96,9 +92,35 @@ auto make_buffered_reader(Reader&& reader) {
     return buffered_reader<Reader, minV>{std::forward<Reader>(reader)};
 }
 
+/* \brief type erased BufferedReadable
+ *
+ * The window currently buffered by the underlying reader is cached, so
+ * readUntil, eof, string_view and read (if enough data is buffered) are
+ * answered without calling through the type erasure. The underlying reader is
+ * only called to refill the buffer, to drop data or to tell/seek.
+ */
 struct VarBufferedReader {
     std::any storage;
 
+private:
+    using Window = std::tuple<char const*, size_t>;
+
+    char const* windowPtr{};
+    size_t      windowSize{};
+
+    std::function<Window(size_t)> read_;      // reads until at least the given size is available
+    std::function<Window(size_t)> dropUntil_; // drops data and returns the remaining window
+    std::function<size_t()>       tell_;
+    std::function<Window(size_t)> seek_;      // seeks and returns the new window
+
+    // returns false if no new data could be read
+    bool refill(size_t ct) {
+        auto oldSize = windowSize;
+        std::tie(windowPtr, windowSize) = read_(ct);
+        return windowSize > oldSize;
+    }
+
+public:
     VarBufferedReader() = default;
     VarBufferedReader(VarBufferedReader const&) = delete;
     VarBufferedReader(VarBufferedReader&&) = default;
@@ -108,32 +130,24 @@ struct VarBufferedReader {
         : storage{std::move(_storage)} {
 
         auto sptr = std::make_shared<T>(std::forward<T>(t));
-        readUntil = [sptr] (char c, size_t s) {
-            return sptr->readUntil(c, s);
-        };
-        dropUntil = [sptr] (size_t s) {
-            return sptr->dropUntil(s);
-        };
-        read = [sptr] (size_t s) {
+        read_ = [sptr] (size_t s) -> Window {
             return sptr->read(s);
         };
-        eof = [sptr] (size_t s) {
-            return sptr->eof(s);
-        };
-        string_view = [sptr] (size_t s, size_t e) {
-            return sptr->string_view(s, e);
+        dropUntil_ = [sptr] (size_t s) -> Window {
+            sptr->dropUntil(s);
+            return sptr->read(0);
         };
-        tell = [sptr] () -> size_t {
+        tell_ = [sptr] () -> size_t {
             if constexpr (Seekable<T>) {
                 return sptr->tell();
             }
             return 0;
 //            throw std::runtime_error("this file format does not support tell/seek(1)");
         };
-        seek = [sptr](size_t offset) {
+        seek_ = [sptr](size_t offset) -> Window {
             if constexpr (Seekable<T>) {
                 sptr->seek(offset);
-                return;
+                return sptr->read(0);
             } else {
                 (void)offset;
             }
@@ -148,13 +162,48 @@ struct VarBufferedReader {
     auto operator=(VarBufferedReader const&) -> VarBufferedReader& = delete;
     auto operator=(VarBufferedReader&&) -> VarBufferedReader& = default;
 
-    std::function<size_t(char, size_t)>                    readUntil;
-    std::function<void(size_t)>                            dropUntil;
-    std::function<std::tuple<char const*, size_t>(size_t)> read;
-    std::function<bool(size_t)>                            eof;
-    std::function<std::string_view(size_t, size_t)>        string_view;
-    std::function<size_t()>                                tell;
-    std::function<void(size_t)>                            seek;
+    size_t readUntil(char c, size_t lastUsed) {
+        while (true) {
+            auto pos = std::string_view{windowPtr, windowSize}.find(c, lastUsed);
+            if (pos != std::string_view::npos) {
+                return pos;
+            }
+            lastUsed = std::max(lastUsed, windowSize); // only search new data
+            if (!refill(windowSize+1)) {
+                return windowSize;
+            }
+        }
+    }
+
+    auto read(size_t ct) -> std::tuple<char const*, size_t> {
+        if (ct > windowSize) {
+            refill(ct);
+        }
+        return {windowPtr, windowSize};
+    }
+
+    void dropUntil(size_t i) {
+        std::tie(windowPtr, windowSize) = dropUntil_(i);
+    }
+
+    bool eof(size_t i) {
+        while (i >= windowSize) {
+            if (!refill(i+1)) return true;
+        }
+        return false;
+    }
+
+    auto string_view(size_t start, size_t end) const -> std::string_view {
+        return std::string_view{windowPtr+start, windowPtr+end};
+    }
+
+    auto tell() const -> size_t {
+        return tell_();
+    }
+
+    void seek(size_t offset) {
+        std::tie(windowPtr, windowSize) = seek_(offset);
+    }
 };
 
 }
@@ -27,7 +27,9 @@ public:
     buffered_writer(buffered_writer const&) = delete;
     buffered_writer(buffered_writer&& _other) = default;
     ~buffered_writer() {
-        close();
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
     }
 
     auto write(std::span<char const> _buffer) -> size_t {
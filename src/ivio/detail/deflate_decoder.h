@@ -0,0 +1,664 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "portable_endian.h"
+#include "zlib_backend.h"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Deflate (RFC 1951) decoder, which can start at any block boundary
+ *
+ * Used for decompressing plain gzip files in parallel (see gzip_mt_reader.h).
+ * A block in the middle of a stream may reference up to 32KiB of data
+ * before it, which is unknown when decoding speculatively. Such references
+ * are recorded as markers (0x8000 | position inside the unknown window) and
+ * replaced by the actual bytes, once the preceding chunk has been decoded.
+ * As soon as the last 32KiB of output are free of markers, decoding continues
+ * with plain bytes.
+ */
+namespace ivio::deflate {
+
+/* \brief reads a deflate stream bit by bit (least significant bit first)
+ *
+ * Reading beyond the end of the data yields zeros, `overrun()` reports this.
+ */
+struct bit_reader {
+    uint8_t const* data{};
+    size_t         size{};
+    size_t         bytePos{}; // next byte to be loaded into buffer
+    uint64_t       buffer{};
+    size_t         count{};   // number of valid bits in buffer
+
+    bit_reader(std::span<uint8_t const> data_, size_t bitPos)
+        : data{data_.data()}
+        , size{data_.size()}
+        , bytePos{bitPos / 8}
+    {
+        refill();
+        consume(bitPos % 8);
+    }
+
+    // ensures that at least 56 bits are buffered
+    void refill() {
+        if (bytePos + 8 <= size) {
+            uint64_t v;
+            std::memcpy(&v, data + bytePos, sizeof(v));
+            buffer |= le64toh(v) << count;
+            auto n = (63 - count) / 8;
+            bytePos += n;
+            count   += n * 8;
+            return;
+        }
+        while (count <= 56) {
+            if (bytePos < size) {
+                buffer |= uint64_t{data[bytePos]} << count;
+            } else if (bytePos > size + 8) {
+                throw std::runtime_error{"deflate stream is truncated"};
+            }
+            bytePos += 1;
+            count   += 8;
+        }
+    }
+
+    auto bitPos() const -> size_t { return bytePos * 8 - count; }
+    bool overrun() const { return bitPos() > size * 8; }
+
+    auto peek(size_t n) const -> uint32_t {
+        return static_cast<uint32_t>(buffer & ((uint64_t{1} << n) - 1));
+    }
+    void consume(size_t n) {
+        buffer >>= n;
+        count  -= n;
+    }
+    auto bits(size_t n) -> uint32_t {
+        if (count < n) refill();
+        auto v = peek(n);
+        consume(n);
+        return v;
+    }
+    void alignToByte() {
+        consume(count % 8);
+    }
+};
+
+/* \brief canonical huffman code, decoded via lookup tables
+ *
+ * Codes up to `rootBits` are decoded by a single lookup, longer codes by a
+ * second lookup in a sub table. Each entry is `symbol << 8 | code length`,
+ * sub tables are referenced by `offset << 8 | 0x80 | sub table bits`.
+ * A length of 0 marks an invalid code.
+ */
+struct huffman {
+    static constexpr size_t rootBits = 10;
+
+    std::vector<uint32_t> table;
+    size_t                bits{}; // number of bits for the root table
+
+    // returns false if the lengths do not describe a valid code
+    bool build(uint8_t const* lengths, size_t n, bool allowIncomplete) {
+        auto count = std::array<uint16_t, 16>{};
+        for (size_t i{0}; i < n; ++i) {
+            count[lengths[i]] += 1;
+        }
+        count[0] = 0;
+        size_t maxLen{0};
+        for (size_t len{1}; len < 16; ++len) {
+            if (count[len]) maxLen = len;
+        }
+
+        // over subscribed codes are never valid, incomplete codes only with a single code (see zlib's inftrees.c)
+        int left = 1;
+        for (size_t len{1}; len < 16; ++len) {
+            left = (left << 1) - count[len];
+            if (left < 0) return false;
+        }
+        if (left > 0 && (!allowIncomplete || maxLen > 1)) return false;
+
+        auto next = std::array<uint16_t, 16>{};
+        for (size_t len{1}, code{0}; len < 16; ++len) {
+            code = (code + count[len-1]) << 1;
+            next[len] = static_cast<uint16_t>(code);
+        }
+
+        bits = std::min(maxLen, rootBits);
+        auto subBits = maxLen - bits;
+        table.assign(size_t{1} << bits, 0);
+        for (size_t sym{0}; sym < n; ++sym) {
+            size_t len = lengths[sym];
+            if (len == 0) continue;
+            auto code = next[len]++;
+            size_t reversed{};
+            for (size_t i{0}; i < len; ++i) {
+                reversed |= ((code >> i) & 1) << (len - 1 - i);
+            }
+            auto entry = static_cast<uint32_t>(sym << 8 | len);
+            if (len <= bits) {
+                for (auto k = reversed; k < (size_t{1} << bits); k += size_t{1} << len) {
+                    table[k] = entry;
+                }
+                continue;
+            }
+            // long codes share a sub table with all codes of the same prefix
+            auto& root = table[reversed & ((size_t{1} << bits) - 1)];
+            if (root == 0) {
+                root = static_cast<uint32_t>(table.size() << 8 | 0x80 | subBits);
+                table.resize(table.size() + (size_t{1} << subBits));
+            }
+            auto offset = table[reversed & ((size_t{1} << bits) - 1)] >> 8;
+            for (auto k = reversed >> bits; k < (size_t{1} << subBits); k += size_t{1} << (len - bits)) {
+                table[offset + k] = entry;
+            }
+        }
+        return true;
+    }
+
+    // bit reader must be refilled
+    auto decode(bit_reader& br) const -> uint32_t {
+        return decode(table.data(), bits, br);
+    }
+
+    static auto decode(uint32_t const* table, size_t bits, bit_reader& br) -> uint32_t {
+        auto e = table[br.peek(bits)];
+        if (e & 0x80) {
+            e = table[(e >> 8) + ((br.buffer >> bits) & ((uint64_t{1} << (e & 0x7f)) - 1))];
+        }
+        auto len = e & 0xff;
+        if (len == 0) {
+            throw std::runtime_error{"invalid huffman code in deflate stream"};
+        }
+        br.consume(len);
+        return e >> 8;
+    }
+};
+
+/* \brief allocator which default initializes, growing a vector leaves the new elements uninitialized
+ *
+ * Output buffers are always written before they are read, zeroing them on
+ * every resize would only cost time.
+ */
+template <typename T>
+struct default_init_allocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = default_init_allocator<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template <typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T>
+using buffer_vector = std::vector<T, default_init_allocator<T>>;
+
+template <typename T>
+struct output {
+    buffer_vector<T> buffer;
+    size_t           size{};
+
+    void reserve(size_t n) {
+        if (size + n > buffer.size()) {
+            buffer.resize(std::max(buffer.size() * 2, size + n + (1<<16)));
+        }
+    }
+};
+
+// position of a gzip member footer inside the decompressed data
+struct footer {
+    size_t   position;
+    uint32_t crc;
+    uint32_t isize;
+};
+
+/* \brief result of decoding a range of deflate blocks
+ *
+ * The decompressed data consists of `marked` followed by
+ * plain[plainPrefix..]. The first plainPrefix bytes of `plain` are a copy of
+ * the window, which the plain decoding started with.
+ */
+struct chunk {
+    size_t startBitMin{}; // decoding started somewhere in [startBitMin, startBit]
+    size_t startBit{};    // all positions in between are padding bits
+    size_t endBit{};      // position of the first block not being decoded
+    bool   endOfStream{}; // stream ended after the last member
+
+    buffer_vector<uint16_t> marked;
+    buffer_vector<char>     plain;
+    size_t                  plainPrefix{};
+
+    std::vector<footer>   footers;
+    std::vector<uint32_t> plainCrcs; // crc of the plain data, split at the footers
+
+    auto plainSize() const -> size_t { return plain.size() - plainPrefix; }
+    auto size() const -> size_t { return marked.size() + plainSize(); }
+};
+
+/* \brief parses a gzip member header (RFC 1952)
+ *
+ * \return position of the first deflate block
+ */
+inline auto parseGzipHeader(std::span<uint8_t const> data, size_t pos) -> size_t {
+    auto need = [&](size_t n) {
+        if (pos + n > data.size()) throw std::runtime_error{"gzip header is truncated"};
+    };
+    need(10);
+    if (data[pos] != 0x1f || data[pos+1] != 0x8b || data[pos+2] != 8) {
+        throw std::runtime_error{"invalid gzip header"};
+    }
+    auto flags = data[pos+3];
+    pos += 10;
+    if (flags & 4) { // FEXTRA
+        need(2);
+        size_t xlen = data[pos] | (data[pos+1] << 8);
+        pos += 2;
+        need(xlen);
+        pos += xlen;
+    }
+    for (auto flag : {8, 16}) { // FNAME, FCOMMENT
+        if (!(flags & flag)) continue;
+        do {
+            need(1);
+        } while (data[pos++] != 0);
+    }
+    if (flags & 2) { // FHCRC
+        need(2);
+        pos += 2;
+    }
+    return pos;
+}
+
+inline auto crc32(uint32_t crc, char const* ptr, size_t len) -> uint32_t {
+    while (len > 0) {
+        auto n = std::min<size_t>(len, 1<<30);
+        crc = zlib::crc32(crc, ptr, static_cast<uint32_t>(n));
+        ptr += n;
+        len -= n;
+    }
+    return crc;
+}
+
+struct decoder {
+    static constexpr size_t windowSize = 1<<15;
+
+    static constexpr auto lengthBase  = std::array<uint16_t, 29>{3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr auto lengthExtra = std::array<uint8_t, 29>{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr auto distBase    = std::array<uint16_t, 30>{1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr auto distExtra   = std::array<uint8_t, 30>{0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    static constexpr auto precodeOrder = std::array<uint8_t, 19>{16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    huffman precode, literals, distances;
+    huffman fixedLiterals, fixedDistances;
+
+    output<uint16_t> marked;
+    output<char>     plain;
+
+    decoder() {
+        auto lengths = std::array<uint8_t, 288>{};
+        std::fill(lengths.begin(),       lengths.begin() + 144, 8);
+        std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+        std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+        std::fill(lengths.begin() + 280, lengths.end(),         8);
+        fixedLiterals.build(lengths.data(), lengths.size(), false);
+        std::fill(lengths.begin(), lengths.begin() + 32, 5);
+        fixedDistances.build(lengths.data(), 32, false);
+    }
+
+    // reads the code lengths of a dynamic block into literals and distances, returns false if invalid
+    bool readDynamicHeader(bit_reader& br) {
+        br.refill();
+        size_t nlen  = br.bits(5) + 257;
+        size_t ndist = br.bits(5) + 1;
+        size_t ncode = br.bits(4) + 4;
+        if (nlen > 286 || ndist > 30) return false;
+
+        auto lengths = std::array<uint8_t, 320>{};
+        for (size_t i{0}; i < ncode; ++i) {
+            lengths[precodeOrder[i]] = static_cast<uint8_t>(br.bits(3));
+        }
+        if (!precode.build(lengths.data(), 19, false)) return false;
+
+        size_t i{0};
+        while (i < nlen + ndist) {
+            br.refill();
+            auto sym = precode.decode(br);
+            if (sym < 16) {
+                lengths[i++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+            uint8_t value{};
+            size_t  repeat{};
+            if (sym == 16) {
+                if (i == 0) return false;
+                value  = lengths[i-1];
+                repeat = 3 + br.bits(2);
+            } else if (sym == 17) {
+                repeat = 3 + br.bits(3);
+            } else {
+                repeat = 11 + br.bits(7);
+            }
+            if (i + repeat > nlen + ndist) return false;
+            std::fill_n(lengths.begin() + i, repeat, value);
+            i += repeat;
+        }
+        if (lengths[256] == 0) return false; // end of block must be encodable
+        if (!literals.build(lengths.data(), nlen, true)) return false;
+        if (!distances.build(lengths.data() + nlen, ndist, true)) return false;
+        return !br.overrun();
+    }
+
+    /* \brief decodes the symbols of a single huffman compressed block
+     *
+     * \param minSrc: smallest valid position a back reference may point to
+     * \param lastMarker: last output position holding a marker (only for marked output)
+     */
+    template <typename T>
+    void decodeBlock(bit_reader& br_, huffman const& lit, huffman const& dist, output<T>& out, ptrdiff_t minSrc, ptrdiff_t& lastMarker) {
+        // local copies, stores into the output (char) would otherwise force reloading them
+        auto br        = br_;
+        auto litTable  = lit.table.data();
+        auto litBits   = lit.bits;
+        auto distTable = dist.table.data();
+        auto distBits  = dist.bits;
+        auto buffer    = out.buffer.data();
+        auto size      = out.size;
+        auto capacity  = out.buffer.size();
+
+        while (true) {
+            if (size + 258 + 8 > capacity) {
+                out.size = size;
+                out.reserve(258 + 8);
+                buffer   = out.buffer.data();
+                capacity = out.buffer.size();
+            }
+            br.refill();
+            auto sym = huffman::decode(litTable, litBits, br);
+            if (sym < 256) {
+                buffer[size++] = static_cast<T>(sym);
+                continue;
+            }
+            if (sym == 256) break;
+            sym -= 257;
+            if (sym >= lengthBase.size()) {
+                throw std::runtime_error{"invalid length symbol in deflate stream"};
+            }
+            size_t len = lengthBase[sym] + br.peek(lengthExtra[sym]);
+            br.consume(lengthExtra[sym]);
+            auto dsym = huffman::decode(distTable, distBits, br);
+            if (dsym >= distBase.size()) {
+                throw std::runtime_error{"invalid distance symbol in deflate stream"};
+            }
+            size_t d = distBase[dsym] + br.peek(distExtra[dsym]);
+            br.consume(distExtra[dsym]);
+
+            auto src = static_cast<ptrdiff_t>(size) - static_cast<ptrdiff_t>(d);
+            if (src < minSrc) {
+                throw std::runtime_error{"invalid distance in deflate stream"};
+            }
+            auto dst = buffer + size;
+            if constexpr (std::same_as<T, char>) {
+                auto ptr = buffer + src;
+                if (d >= 8) { // copies in words of 8 bytes, may write up to 7 bytes too many
+                    for (size_t k{0}; k < len; k += 8) {
+                        std::memcpy(dst + k, ptr + k, 8);
+                    }
+                } else if (d == 1) {
+                    std::memset(dst, *ptr, len);
+                } else {
+                    for (size_t k{0}; k < len; ++k) {
+                        dst[k] = ptr[k];
+                    }
+                }
+            } else {
+                uint64_t flags{};
+                size_t k{0};
+                for (; k < len && src + static_cast<ptrdiff_t>(k) < 0; ++k) {
+                    dst[k] = static_cast<uint16_t>(0x8000 | (windowSize + src + k));
+                    flags  = 0x8000;
+                }
+                if (d >= 4) { // copies in words of 4 symbols, may write up to 3 symbols too many (flags may include them)
+                    for (; k < len; k += 4) {
+                        uint64_t v;
+                        std::memcpy(&v, buffer + src + k, sizeof(v));
+                        std::memcpy(dst + k, &v, sizeof(v));
+                        flags |= v;
+                    }
+                } else {
+                    for (; k < len; ++k) {
+                        dst[k] = buffer[src + k];
+                        flags |= dst[k];
+                    }
+                }
+                if (flags & 0x8000'8000'8000'8000) {
+                    lastMarker = static_cast<ptrdiff_t>(size + len) - 1;
+                }
+            }
+            size += len;
+        }
+        br_      = br;
+        out.size = size;
+    }
+
+    /* \brief decodes all blocks starting at `startBit`
+     *
+     * Decoding stops at the first block boundary at or behind `endBit` or at the end of the stream.
+     * \param window: the 32KiB (or less) in front of startBit. If missing, back references
+     *                into the window are recorded as markers
+     * \param memberStart: startBit points to a gzip header, instead of a deflate block
+     */
+    void decode(std::span<uint8_t const> data, size_t startBit, size_t endBit, std::optional<std::span<char const>> window, bool memberStart, chunk& result) {
+        // decode directly into the buffers of result
+        std::swap(marked.buffer, result.marked);
+        std::swap(plain.buffer, result.plain);
+        marked.size = 0;
+        plain.size  = 0;
+        result.footers.clear();
+        result.plainCrcs.clear();
+        result.endOfStream = false;
+
+        bool      isMarked   = !window.has_value();
+        ptrdiff_t lastMarker = -1;
+        ptrdiff_t minSrc     = -static_cast<ptrdiff_t>(windowSize);
+        size_t    markedSize{};
+        size_t    plainPrefix{};
+
+        if (!isMarked) {
+            plain.reserve(window->size());
+            std::copy(window->begin(), window->end(), plain.buffer.begin());
+            plain.size  = window->size();
+            plainPrefix = window->size();
+            minSrc      = 0;
+        }
+        auto outputPos = [&]() {
+            return isMarked ? marked.size : markedSize + plain.size - plainPrefix;
+        };
+
+        auto br = bit_reader{data, memberStart ? parseGzipHeader(data, startBit / 8) * 8 : startBit};
+        if (memberStart && !isMarked) {
+            minSrc = static_cast<ptrdiff_t>(plain.size);
+        }
+
+        while (true) {
+            if (br.bitPos() >= endBit) {
+                result.endBit = br.bitPos();
+                break;
+            }
+
+            // continue with plain output, if no marker can be referenced anymore
+            if (isMarked) {
+                auto n = static_cast<ptrdiff_t>(marked.size);
+                if ((minSrc >= 0 && lastMarker < minSrc) || n - static_cast<ptrdiff_t>(windowSize) > lastMarker) {
+                    auto start = std::max(minSrc, n - static_cast<ptrdiff_t>(windowSize));
+                    plain.reserve(n - start);
+                    for (auto i = start; i < n; ++i) {
+                        plain.buffer[plain.size++] = static_cast<char>(marked.buffer[i]);
+                    }
+                    markedSize  = marked.size;
+                    plainPrefix = plain.size;
+                    minSrc      = 0;
+                    isMarked    = false;
+                }
+            }
+
+            br.refill();
+            auto final = br.bits(1);
+            auto type  = br.bits(2);
+            if (type == 0) { // stored block
+                br.alignToByte();
+                auto len  = br.bits(16);
+                auto nlen = br.bits(16);
+                if (len != (~nlen & 0xffff)) {
+                    throw std::runtime_error{"invalid stored block in deflate stream"};
+                }
+                auto pos = br.bitPos() / 8;
+                if (pos + len > data.size()) {
+                    throw std::runtime_error{"deflate stream is truncated"};
+                }
+                if (isMarked) {
+                    marked.reserve(len);
+                    std::copy_n(data.data() + pos, len, marked.buffer.data() + marked.size);
+                    marked.size += len;
+                } else {
+                    plain.reserve(len);
+                    std::memcpy(plain.buffer.data() + plain.size, data.data() + pos, len);
+                    plain.size += len;
+                }
+                br = bit_reader{data, (pos + len) * 8};
+            } else if (type == 1 || type == 2) {
+                if (type == 2 && !readDynamicHeader(br)) {
+                    throw std::runtime_error{"invalid dynamic block header in deflate stream"};
+                }
+                auto& lit  = (type == 1) ? fixedLiterals  : literals;
+                auto& dist = (type == 1) ? fixedDistances : distances;
+                if (isMarked) {
+                    decodeBlock(br, lit, dist, marked, minSrc, lastMarker);
+                } else {
+                    decodeBlock(br, lit, dist, plain, minSrc, lastMarker);
+                }
+            } else {
+                throw std::runtime_error{"invalid block type in deflate stream"};
+            }
+
+            if (final) {
+                br.alignToByte();
+                auto crc   = br.bits(32);
+                auto isize = br.bits(32);
+                if (br.overrun()) {
+                    throw std::runtime_error{"gzip footer is truncated"};
+                }
+                result.footers.push_back({outputPos(), crc, isize});
+
+                // next member or end of stream
+                auto pos = br.bitPos() / 8;
+                if (pos + 2 > data.size() || data[pos] != 0x1f || data[pos+1] != 0x8b) {
+                    result.endBit      = pos * 8;
+                    result.endOfStream = true;
+                    break;
+                }
+                br = bit_reader{data, parseGzipHeader(data, pos) * 8};
+                minSrc = static_cast<ptrdiff_t>(isMarked ? marked.size : plain.size);
+            }
+        }
+
+        if (isMarked) {
+            markedSize = marked.size;
+        }
+        result.startBit = startBit;
+        marked.buffer.resize(markedSize);
+        plain.buffer.resize(plain.size);
+        std::swap(marked.buffer, result.marked);
+        std::swap(plain.buffer, result.plain);
+        result.plainPrefix = plainPrefix;
+
+        // checksums of the plain part, split at the member boundaries
+        auto first = result.marked.size();
+        auto last  = result.size();
+        auto a     = first;
+        for (auto const& f : result.footers) {
+            if (f.position <= first || f.position >= last) continue;
+            result.plainCrcs.push_back(crc32(0, result.plain.data() + plainPrefix + (a - first), f.position - a));
+            a = f.position;
+        }
+        if (a < last) {
+            result.plainCrcs.push_back(crc32(0, result.plain.data() + plainPrefix + (a - first), last - a));
+        }
+    }
+
+    /* \brief searches for a position in [from, until), at which a deflate block might start
+     *
+     * Only non final stored and dynamic blocks are detected.
+     * \return range of equivalent start positions, stored blocks are preceded by padding
+     */
+    auto findBlock(std::span<uint8_t const> data, size_t from, size_t until) -> std::optional<std::pair<size_t, size_t>> {
+        until = std::min(until, data.size() * 8);
+        auto load = [&](size_t bytePos) -> uint64_t {
+            uint64_t v{};
+            if (bytePos + 8 <= data.size()) {
+                std::memcpy(&v, data.data() + bytePos, sizeof(v));
+                return le64toh(v);
+            }
+            for (size_t i{0}; bytePos + i < data.size(); ++i) {
+                v |= uint64_t{data[bytePos + i]} << (i*8);
+            }
+            return v;
+        };
+        auto bit = [&](size_t p) {
+            return (data[p / 8] >> (p % 8)) & 1;
+        };
+
+        for (auto p = from; p < until; ++p) {
+            // stored block: 3 header bits, padding up to the next byte, followed by LEN and NLEN
+            if ((p + 3) % 8 == 0) {
+                auto pos = (p + 3) / 8;
+                if (pos + 4 <= data.size()) {
+                    size_t len  = data[pos]   | (data[pos+1] << 8);
+                    size_t nlen = data[pos+2] | (data[pos+3] << 8);
+                    if (len == (~nlen & 0xffff) && pos + 4 + len <= data.size()
+                        && !bit(p) && !bit(p+1) && !bit(p+2)) {
+                        auto min = p;
+                        while (min > from && min + 10 > pos * 8 && !bit(min - 1)) {
+                            --min;
+                        }
+                        return std::pair{min, p};
+                    }
+                }
+            }
+
+            // dynamic block: BFINAL = 0, BTYPE = 2, HLIT <= 29, HDIST <= 29
+            auto v = load(p / 8) >> (p % 8);
+            if ((v & 7) != 4 || ((v >> 3) & 31) > 29 || ((v >> 8) & 31) > 29) {
+                continue;
+            }
+            try {
+                auto br = bit_reader{data, p + 3};
+                if (readDynamicHeader(br)) {
+                    return std::pair{p, p};
+                }
+            } catch (std::runtime_error const&) {} // header reaches beyond the end of the data
+
+        }
+        return std::nullopt;
+    }
+};
+
+}
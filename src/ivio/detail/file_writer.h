@@ -4,8 +4,197 @@
 #pragma once
 
 #include "concepts.h"
+#include "file_writer_config.h"
 
 #include <filesystem>
+#include <span>
+
+#if (defined(unix) || defined(__unix__) || defined(__unix))
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+
+namespace ivio {
+
+/* \brief writes into a file via its file descriptor
+ *
+ * Data is collected in a page aligned buffer and written in large chunks.
+ * Writes larger than the buffer are passed together with the buffered data
+ * to a single writev call, without copying them.
+ */
+class file_writer {
+protected:
+    static constexpr size_t alignment = 4096;
+
+    struct aligned_free {
+        void operator()(char* ptr) const { std::free(ptr); }
+    };
+
+    int fd{-1};
+    bool direct{}; // file was opened with O_DIRECT
+    size_t capacity;
+    std::unique_ptr<char[], aligned_free> buffer;
+    size_t size{};
+
+    void writeAll(char const* data, size_t len) {
+        while (len > 0) {
+            auto r = ::write(fd, data, len);
+            if (r == -1) {
+                if (errno == EINTR) continue;
+                if (direct && errno == EINVAL) { // alignment not supported, continue without O_DIRECT
+                    disableDirectIO();
+                    continue;
+                }
+                throw std::runtime_error{std::string{"write failed "} + strerror(errno)};
+            }
+            data += r;
+            len  -= r;
+        }
+    }
+
+    // writes the buffer and `extra` with as few syscalls as possible
+    void writeBuffered(std::span<char const> extra) {
+        auto iov = std::array<iovec, 2>{iovec{buffer.get(), size}, iovec{const_cast<char*>(extra.data()), extra.size()}};
+        auto first = size_t{0};
+        while (first < iov.size()) {
+            if (iov[first].iov_len == 0) {
+                ++first;
+                continue;
+            }
+            auto r = ::writev(fd, iov.data() + first, static_cast<int>(iov.size() - first));
+            if (r == -1) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error{std::string{"write failed "} + strerror(errno)};
+            }
+            auto written = static_cast<size_t>(r);
+            for (auto i = first; i < iov.size() && written > 0; ++i) {
+                auto n = std::min(written, iov[i].iov_len);
+                iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + n;
+                iov[i].iov_len -= n;
+                written -= n;
+            }
+        }
+        size = 0;
+    }
+
+    void disableDirectIO() {
+#ifdef O_DIRECT
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+#endif
+        direct = false;
+    }
+
+public:
+    file_writer(std::filesystem::path path, file_writer_config config = {})
+        : capacity{std::max(alignment, (config.bufferSize + alignment - 1) / alignment * alignment)}
+        , buffer{static_cast<char*>(std::aligned_alloc(alignment, capacity))}
+    {
+        if (!buffer) {
+            throw std::bad_alloc{};
+        }
+        auto flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+        if (config.directIO) {
+            fd = ::open(path.c_str(), flags | O_DIRECT, 0666);
+            direct = (fd != -1);
+        }
+#endif
+        if (fd == -1) {
+            fd = ::open(path.c_str(), flags, 0666);
+        }
+        if (fd == -1) {
+            throw std::runtime_error{"file " + path.string() + " not writable"};
+        }
+#if defined(F_NOCACHE) && !defined(O_DIRECT)
+        if (config.directIO) {
+            fcntl(fd, F_NOCACHE, 1);
+        }
+#endif
+#ifdef FALLOC_FL_KEEP_SIZE
+        if (config.expectedSize > 0) {
+            // failure is not an error, the reservation is only a hint
+            [[maybe_unused]] auto r = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(config.expectedSize));
+        }
+#endif
+    }
+
+    file_writer() = delete;
+    file_writer(file_writer const&) = delete;
+    file_writer(file_writer&& _other) noexcept
+        : fd{_other.fd}
+        , direct{_other.direct}
+        , capacity{_other.capacity}
+        , buffer{std::move(_other.buffer)}
+        , size{_other.size}
+    {
+        _other.fd   = -1;
+        _other.size = 0;
+    }
+
+    ~file_writer() {
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
+    }
+
+    auto operator=(file_writer const&) -> file_writer& = delete;
+    auto operator=(file_writer&&) -> file_writer& = delete;
+
+    auto write(std::span<char const> data) -> size_t {
+        auto total = data.size();
+        // large writes are passed through, O_DIRECT requires aligned chunks from the buffer
+        if (!direct && size + data.size() > capacity) {
+            writeBuffered(data);
+            return total;
+        }
+        while (!data.empty()) {
+            auto n = std::min(capacity - size, data.size());
+            std::memcpy(buffer.get() + size, data.data(), n);
+            size += n;
+            data = data.subspan(n);
+            if (size == capacity) {
+                writeAll(buffer.get(), size);
+                size = 0;
+            }
+        }
+        return total;
+    }
+
+    void close() {
+        if (fd == -1) return;
+        try {
+            if (size > 0) {
+                if (direct) { // the tail is not a multiple of the block size
+                    disableDirectIO();
+                }
+                writeAll(buffer.get(), size);
+                size = 0;
+            }
+        } catch(...) { // the file is closed anyway, a second close() has nothing left to report
+            size = 0;
+            ::close(std::exchange(fd, -1));
+            throw;
+        }
+        if (::close(std::exchange(fd, -1)) == -1 && errno != EINTR) {
+            throw std::runtime_error{std::string{"close failed "} + strerror(errno)};
+        }
+    }
+};
+
+}
+
+#else
+
 #include <fstream>
 
 namespace ivio {
@@ -15,9 +204,11 @@ protected:
     std::ofstream ofs;
 
 public:
-    file_writer(std::filesystem::path path)
+    file_writer(std::filesystem::path path, file_writer_config config = {})
         : ofs(path, std::ios_base::out | std::ios_base::binary)
-    {}
+    {
+        (void)config;
+    }
 
     file_writer() = delete;
     file_writer(file_writer const&) = delete;
@@ -37,5 +228,8 @@ public:
     }
 };
 
-static_assert(writer_c<file_writer>);
 }
+
+#endif
+
+static_assert(ivio::writer_c<ivio::file_writer>);
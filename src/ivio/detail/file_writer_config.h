@@ -0,0 +1,27 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <cstddef>
+
+namespace ivio {
+
+/* \brief describes how output files are written
+ *
+ * Only used for files, which are written via a file descriptor (unix).
+ * Unsupported hints are ignored.
+ */
+struct file_writer_config {
+    // Size of the internal buffer, rounded up to a multiple of 4KiB
+    size_t bufferSize = 1<<20;
+
+    // Bypass the page cache (O_DIRECT), for huge outputs which are not read again soon.
+    // Falls back to normal writes if not supported by the file system
+    bool directIO = false;
+
+    // If known, disk space for the file is reserved up front (fallocate), 0 disables
+    size_t expectedSize = 0;
+};
+
+}
@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace ivio::detail {
+
+// region [begin, end) of reference `name`, 0-based
+struct genomic_region {
+    std::string name;
+    int64_t     begin{};
+    int64_t     end{std::numeric_limits<int64_t>::max()};
+};
+
+/* Parses a position of a region string, e.g. "140000000", "140,000,000", "140e6" or "1.4e8"
+ * Returns std::nullopt if `str` is not a valid position.
+ */
+inline auto parsePosition(std::string_view str) -> std::optional<int64_t> {
+    constexpr auto maxValue = std::numeric_limits<int64_t>::max() / 10;
+
+    int64_t value{};
+    int64_t fractionDigits{};
+    int64_t exponent{};
+    bool    anyDigit{};
+    bool    inFraction{};
+    size_t  i{0};
+    for (; i < str.size(); ++i) {
+        auto c = str[i];
+        if (c >= '0' && c <= '9') {
+            if (value > maxValue) return std::nullopt;
+            value = value * 10 + (c - '0');
+            fractionDigits += inFraction ? 1 : 0;
+            anyDigit = true;
+        } else if (c == ',' && !inFraction) {
+            continue;
+        } else if (c == '.' && !inFraction) {
+            inFraction = true;
+        } else {
+            break;
+        }
+    }
+    if (!anyDigit) return std::nullopt;
+    if (i < str.size()) {
+        if (str[i] != 'e' && str[i] != 'E') return std::nullopt;
+        if (++i == str.size()) return std::nullopt;
+        for (; i < str.size(); ++i) {
+            if (str[i] < '0' || str[i] > '9' || exponent > 18) return std::nullopt;
+            exponent = exponent * 10 + (str[i] - '0');
+        }
+    }
+    // only integral values are valid
+    for (; exponent < fractionDigits; --fractionDigits) {
+        if (value % 10 != 0) return std::nullopt;
+        value /= 10;
+    }
+    for (; exponent > fractionDigits; --exponent) {
+        if (value > maxValue) return std::nullopt;
+        value *= 10;
+    }
+    return value;
+}
+
+/* Parses a region string as used by samtools and tabix: "name", "name:begin" or "name:begin-end"
+ *
+ * Positions are 1-based and inclusive, the result is 0-based and half-open.
+ * If the part behind the last ':' is not a valid range, the complete string is
+ * taken as name (reference names may contain ':').
+ */
+inline auto parseRegion(std::string_view str) -> genomic_region {
+    if (str.empty()) {
+        throw std::runtime_error{"empty region"};
+    }
+    auto colon = str.rfind(':');
+    if (colon == std::string_view::npos || colon == 0) {
+        return {.name = std::string{str}, .begin = 0, .end = std::numeric_limits<int64_t>::max()};
+    }
+    auto range = str.substr(colon+1);
+    auto dash  = range.find('-');
+    auto begin = parsePosition(range.substr(0, dash));
+    auto end   = std::optional<int64_t>{std::numeric_limits<int64_t>::max()};
+    if (dash != std::string_view::npos && dash+1 < range.size()) {
+        end = parsePosition(range.substr(dash+1));
+    }
+    if (!begin || !end || *begin == 0) {
+        return {.name = std::string{str}, .begin = 0, .end = std::numeric_limits<int64_t>::max()};
+    }
+    if (*end < *begin) {
+        throw std::runtime_error{"invalid region " + std::string{str} + ", end lies in front of begin"};
+    }
+    return {.name = std::string{str.substr(0, colon)}, .begin = *begin - 1, .end = *end};
+}
+
+}
@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "bgzf_reader.h"
+#include "mmap_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ivio {
+
+/* \brief GZI index of a bgzf file, as written by `bgzip -i`
+ *
+ * Lists the compressed and uncompressed offset of each bgzf block, which maps
+ * any uncompressed offset to the block containing it. The file consists of the
+ * number of entries followed by pairs of little endian uint64 values, the first
+ * block (at offset 0/0) is implicit.
+ */
+struct gzi_index {
+    struct block {
+        uint64_t coffset; // compressed offset of the block
+        uint64_t uoffset; // uncompressed offset of its first byte
+    };
+    std::vector<block> blocks{{0, 0}}; // sorted by both offsets
+
+    // block containing the uncompressed offset `uoffset`
+    auto find(uint64_t uoffset) const -> block {
+        // the last block starting at or in front of uoffset, this skips empty blocks
+        auto iter = std::ranges::upper_bound(blocks, uoffset, {}, &block::uoffset);
+        return *(iter - 1);
+    }
+
+    static auto fromGzi(std::string_view data) -> gzi_index {
+        auto get = [&]() -> uint64_t {
+            if (data.size() < sizeof(uint64_t)) {
+                throw std::runtime_error{"index file is truncated"};
+            }
+            auto v = bgzfUnpack<uint64_t>(data.data());
+            data = data.substr(sizeof(uint64_t));
+            return v;
+        };
+        auto index = gzi_index{};
+        auto n = get();
+        if (n > data.size() / 16) {
+            throw std::runtime_error{"index file is truncated"};
+        }
+        index.blocks.reserve(n + 1);
+        for (uint64_t i{0}; i < n; ++i) {
+            auto coffset = get();
+            auto uoffset = get();
+            if (coffset < index.blocks.back().coffset || uoffset < index.blocks.back().uoffset) {
+                throw std::runtime_error{"gzi index is not sorted"};
+            }
+            index.blocks.push_back({coffset, uoffset});
+        }
+        return index;
+    }
+
+    static auto load(std::filesystem::path const& path) -> gzi_index {
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error{"index file " + path.string() + " does not exist"};
+        }
+        auto reader = mmap_reader{path};
+        auto [ptr, size] = reader.read(std::numeric_limits<size_t>::max());
+        return fromGzi({ptr, size});
+    }
+};
+
+}
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "bgzf_reader.h"
+#include "bgzf_writer.h"
+#include "file_writer.h"
+#include "mmap_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ivio {
+
+/* \brief random access points into a regular gzip file (as in zlib's zran example)
+ *
+ * A checkpoint is a deflate block boundary. It stores the position inside the
+ * compressed data (which might be in the middle of a byte) and the last 32KiB
+ * of decompressed data in front of it, which later blocks might refer to.
+ * With both, inflating can restart at the checkpoint. The start of the file is
+ * an implicit checkpoint.
+ *
+ * Serialized as "IVGZIDX\2", followed by the fingerprint of the compressed file
+ * (its size and its last 8 bytes), the spacing and the number of checkpoints.
+ * Each checkpoint consists of its uncompressed offset, compressed offset,
+ * number of bits and the window size followed by the window. All values are
+ * little endian uint64.
+ */
+struct gzip_checkpoint_index {
+    static constexpr size_t windowSize = 1<<15;
+    static constexpr auto   magic      = std::string_view{"IVGZIDX\2", 8};
+
+    // identifies the gzip file an index belongs to, detects stale indices
+    struct fingerprint {
+        uint64_t fileSize{}; // size of the compressed file
+        uint64_t trailer{};  // last 8 bytes of the file, CRC32 and ISIZE of the last gzip member
+
+        static auto of(std::filesystem::path const& path) -> fingerprint {
+            auto res = fingerprint{.fileSize = std::filesystem::file_size(path)};
+            if (res.fileSize < 8) return res;
+            auto ifs = std::ifstream{path, std::ios::binary};
+            char buffer[8];
+            if (!ifs.seekg(-8, std::ios::end) || !ifs.read(buffer, sizeof(buffer))) {
+                throw std::runtime_error{"failed reading the gzip trailer of " + path.string()};
+            }
+            res.trailer = bgzfUnpack<uint64_t>(buffer);
+            return res;
+        }
+
+        bool operator==(fingerprint const&) const = default;
+    };
+
+    struct checkpoint {
+        uint64_t    uoffset; // offset of the first decompressed byte behind the checkpoint
+        uint64_t    coffset; // offset of the first compressed byte that was not consumed
+        uint8_t     bits;    // number of bits of the byte in front of coffset, which were not consumed
+        std::string window;  // decompressed data in front of uoffset, up to windowSize bytes
+    };
+
+    fingerprint             file;      // compressed file this index belongs to
+    uint64_t                spacing{}; // decompressed bytes between two checkpoints
+    std::vector<checkpoint> points;    // sorted by both offsets
+
+    // last checkpoint at or in front of `uoffset`, nullptr if there is none (start of the file)
+    auto find(uint64_t uoffset) const -> checkpoint const* {
+        auto iter = std::ranges::upper_bound(points, uoffset, {}, &checkpoint::uoffset);
+        if (iter == points.begin()) return nullptr;
+        return &*(iter - 1);
+    }
+
+    auto toGzidx() const -> std::string {
+        auto res = std::string{magic};
+        auto put = [&](uint64_t v) {
+            char buffer[sizeof(v)];
+            bgzf_writer::detail::bgzfPack(v, buffer);
+            res.append(buffer, sizeof(v));
+        };
+        put(file.fileSize);
+        put(file.trailer);
+        put(spacing);
+        put(points.size());
+        for (auto const& p : points) {
+            put(p.uoffset);
+            put(p.coffset);
+            put(p.bits);
+            put(p.window.size());
+            res += p.window;
+        }
+        return res;
+    }
+
+    static auto fromGzidx(std::string_view data) -> gzip_checkpoint_index {
+        auto take = [&](size_t n) -> std::string_view {
+            if (data.size() < n) {
+                throw std::runtime_error{"gzip checkpoint index is truncated"};
+            }
+            auto v = data.substr(0, n);
+            data = data.substr(n);
+            return v;
+        };
+        auto get = [&]() -> uint64_t {
+            return bgzfUnpack<uint64_t>(take(sizeof(uint64_t)).data());
+        };
+        if (take(magic.size()) != magic) {
+            throw std::runtime_error{"not a gzip checkpoint index"};
+        }
+        auto index = gzip_checkpoint_index{};
+        index.file.fileSize = get();
+        index.file.trailer  = get();
+        index.spacing       = get();
+        auto n = get();
+        if (n > data.size() / 32) {
+            throw std::runtime_error{"gzip checkpoint index is truncated"};
+        }
+        index.points.reserve(n);
+        for (uint64_t i{0}; i < n; ++i) {
+            auto p = checkpoint{};
+            p.uoffset = get();
+            p.coffset = get();
+            auto bits = get();
+            auto size = get();
+            if (bits > 7 || size > windowSize || (bits > 0 && p.coffset == 0)) {
+                throw std::runtime_error{"invalid checkpoint in gzip checkpoint index"};
+            }
+            if (!index.points.empty()
+                && (p.uoffset <= index.points.back().uoffset || p.coffset < index.points.back().coffset)) {
+                throw std::runtime_error{"gzip checkpoint index is not sorted"};
+            }
+            p.bits   = static_cast<uint8_t>(bits);
+            p.window = take(size);
+            index.points.push_back(std::move(p));
+        }
+        return index;
+    }
+
+    // returns std::nullopt for indices written in an older format
+    static auto load(std::filesystem::path const& path) -> std::optional<gzip_checkpoint_index> {
+        auto reader = mmap_reader{path};
+        auto [ptr, size] = reader.read(std::numeric_limits<size_t>::max());
+        auto data = std::string_view{ptr, size};
+        if (data.starts_with(magic.substr(0, 7)) && !data.starts_with(magic)) {
+            return std::nullopt;
+        }
+        return fromGzidx(data);
+    }
+
+    void save(std::filesystem::path const& path) const {
+        auto data   = toGzidx();
+        auto writer = file_writer{path};
+        writer.write(data);
+        writer.close();
+    }
+};
+
+}
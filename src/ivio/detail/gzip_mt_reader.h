@@ -0,0 +1,325 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "deflate_decoder.h"
+#include "job_ring.h"
+#include "zlib_file_reader.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ivio {
+
+//!WORKAROUND llvm < 18 and MSVC < 19.28 do not provide jthread
+// libstdc++ defines `__GLIBCXX__` -> Has jthread
+// libstd++ defines `_LIBCPP_VERSION` -> jthread since 18 but not on macOS? (!TODO not sure why on macos it doesn't work)
+// msvc defines `_MSC_VER` -> jthread since 19.28
+// !TODO this should work, but emcc can't find std::jthread
+#if (defined(__GLIBCXX__) || (_LIBCPP_VERSION >= 180000 && !__APPLE__) || _MSC_VER >= 1928) && !defined(__EMSCRIPTEN__) \
+    && (defined(unix) || defined(__unix__) || defined(__unix))
+
+/* \brief decompresses a memory mapped gzip file (not BGZF) with multiple threads
+ *
+ * The compressed file is split into chunks of equal size. Each worker searches
+ * the first deflate block inside its chunk and decodes until the beginning of
+ * the next chunk, without knowing the 32KiB window in front of it (see
+ * deflate_decoder.h). The consumer verifies that the chunks connect seamlessly,
+ * replaces the unresolved back references and checks the crc of each member.
+ * If a worker picked a wrong block start, the chunk is decoded again by the
+ * consumer.
+ */
+struct gzip_mt_reader {
+    struct Job {
+        deflate::chunk     chunk;
+        bool               found{}; // false if no block start could be found in this chunk
+        std::exception_ptr error;
+    };
+
+    VarBufferedReader            reader; // owns the mapping
+    std::span<uint8_t const>     data;
+    size_t                       released{}; // bytes of data handed back to `reader`
+    size_t                       chunkSize;
+    size_t                       chunkCount;
+
+    std::mutex                   mutex;
+    size_t                       threadNbr;
+    job_ring<Job>                jobs;
+    std::vector<std::jthread>    threads;
+
+    // end of chunk i, decoding continues until the first block boundary behind it
+    auto nominalEnd(size_t i) const -> size_t {
+        if (i+1 >= chunkCount) return std::numeric_limits<size_t>::max();
+        return (i+1) * chunkSize * 8;
+    }
+
+    // returns if should be aborted
+    bool work(deflate::decoder& decoder) {
+        auto g = std::unique_lock{mutex};
+        auto index = jobs.nextTicket;
+        if (index >= chunkCount) return true;
+        auto slot = jobs.acquire();
+        if (!slot) return true;
+        g.unlock();
+
+        auto& job = slot->job;
+        job.found = false;
+        job.error = {};
+        try {
+            if (index == 0) {
+                decoder.decode(data, 0, nominalEnd(0), std::span<char const>{}, true, job.chunk);
+                job.chunk.startBitMin = 0;
+                job.found = true;
+            } else {
+                // speculative decoding, until a valid position was found
+                auto from = index * chunkSize * 8;
+                while (auto candidate = decoder.findBlock(data, from, nominalEnd(index))) {
+                    auto [min, start] = *candidate;
+                    try {
+                        decoder.decode(data, start, nominalEnd(index), std::nullopt, false, job.chunk);
+                        job.chunk.startBitMin = min;
+                        job.found = true;
+                        break;
+                    } catch (std::runtime_error const&) {
+                        from = start + 1;
+                    }
+                }
+            }
+        } catch(...) {
+            job.error = std::current_exception();
+        }
+        jobs.publish(*slot);
+        return false;
+    }
+
+    // threads are started lazily on the first read, this keeps gzip_mt_reader movable until then
+    void startThreads() {
+        while (threads.size() < threadNbr) {
+            threads.emplace_back(std::jthread{[this](std::stop_token stoken) {
+                auto decoder = deflate::decoder{};
+                while(!stoken.stop_requested()) {
+                    if (work(decoder)) {
+                        return;
+                    }
+                }
+            }});
+        }
+    }
+
+    // The complete file is mapped into memory, workers decompress directly from the mapping
+    gzip_mt_reader(mmap_reader reader_, size_t threadNbr=1, size_t chunkSize=4<<20)
+        : data{[&]() {
+            auto [ptr, size] = reader_.read(0);
+            return std::span<uint8_t const>{reinterpret_cast<uint8_t const*>(ptr), size};
+        }()}
+        , chunkSize{std::max<size_t>(1, chunkSize)}
+        , chunkCount{std::max<size_t>(1, (data.size() + this->chunkSize - 1) / this->chunkSize)}
+        , threadNbr{std::max<size_t>(1, threadNbr)}
+        , jobs{this->threadNbr+1}
+    {
+        // consumed chunks are passed to mmap_reader::dropUntil (see releaseData),
+        // which applies the mmap_policy, the rest of the mapping stays valid
+        reader = std::move(reader_);
+    }
+
+    gzip_mt_reader(gzip_mt_reader const&) = delete;
+    gzip_mt_reader(gzip_mt_reader&& _other)
+        : reader{std::move(_other.reader)}
+        , data{_other.data}
+        , released{_other.released}
+        , chunkSize{_other.chunkSize}
+        , chunkCount{_other.chunkCount}
+        , threadNbr{_other.threadNbr}
+        , jobs{threadNbr+1}
+    {
+        assert(_other.threads.empty());
+    }
+
+    auto operator=(gzip_mt_reader const&) -> gzip_mt_reader& = delete;
+    auto operator=(gzip_mt_reader&&) -> gzip_mt_reader& = delete;
+
+    ~gzip_mt_reader() {
+        jobs.finish();
+    }
+
+private:
+    deflate::decoder              redoDecoder; // for chunks which have to be decoded again
+    deflate::chunk                redo;
+
+    size_t                        current{};    // next chunk to process
+    size_t                        prevEnd{};    // bit position, at which the previous chunk stopped
+    bool                          finished{};
+    bool                          holdingSlot{};
+
+    std::array<char, deflate::decoder::windowSize> window{}; // last 32KiB of output
+    std::array<char, 1<<16>       lookup{}; // resolves literals and markers
+    deflate::buffer_vector<char>  resolved; // marked part of the current chunk with resolved back references
+    size_t                        totalSize{};
+
+    uint32_t                      memberCrc{};
+    size_t                        memberSize{};
+
+    std::array<std::span<char const>, 2> pending; // data not yet returned to the caller
+
+    void appendWindow(std::span<char const> s) {
+        if (s.size() >= window.size()) {
+            std::memcpy(window.data(), s.data() + s.size() - window.size(), window.size());
+        } else if (!s.empty()) {
+            std::memmove(window.data(), window.data() + s.size(), window.size() - s.size());
+            std::memcpy(window.data() + window.size() - s.size(), s.data(), s.size());
+        }
+        totalSize += s.size();
+    }
+
+    // updates the crc of the current member with the data [a, b) of chunk c
+    void updateCrc(deflate::chunk const& c, size_t a, size_t b, size_t& crcIdx) {
+        auto m = c.marked.size();
+        if (a < m) {
+            auto e = std::min(b, m);
+            memberCrc = deflate::crc32(memberCrc, resolved.data() + a, e - a);
+            memberSize += e - a;
+            a = e;
+        }
+        if (a < b) {
+            memberCrc = zlib::crc32_combine(memberCrc, c.plainCrcs[crcIdx++], b - a);
+            memberSize += b - a;
+        }
+    }
+
+    void accept(deflate::chunk const& c) {
+        // maps literals to themselves and markers to the window
+        for (size_t i{0}; i < 256; ++i) {
+            lookup[i] = static_cast<char>(i);
+        }
+        std::memcpy(lookup.data() + 0x8000, window.data(), window.size());
+        resolved.resize(c.marked.size());
+        for (size_t i{0}; i < c.marked.size(); ++i) {
+            resolved[i] = lookup[c.marked[i]];
+        }
+
+        size_t a{}, crcIdx{};
+        for (auto const& f : c.footers) {
+            updateCrc(c, a, f.position, crcIdx);
+            if (f.crc != memberCrc || f.isize != static_cast<uint32_t>(memberSize)) {
+                throw std::runtime_error{"gzip member has wrong checksum"};
+            }
+            memberCrc  = 0;
+            memberSize = 0;
+            a = f.position;
+        }
+        updateCrc(c, a, c.size(), crcIdx);
+
+        pending[0] = resolved;
+        pending[1] = {c.plain.data() + c.plainPrefix, c.plainSize()};
+        appendWindow(pending[0]);
+        appendWindow(pending[1]);
+
+        prevEnd  = c.endBit;
+        finished = c.endOfStream;
+    }
+
+    /* data in front of `offset` is not read anymore, neither by workers nor by the consumer
+     * This unmaps/drops consumed pages and announces read ahead, according to the mmap_policy.
+     */
+    void releaseData(size_t offset) {
+        if (offset <= released) return;
+        reader.dropUntil(offset - released);
+        released = offset;
+    }
+
+    void nextChunk() {
+        auto i = current++;
+        // workers start at the chunk's beginning, the consumer continues at prevEnd
+        releaseData(std::min(i * chunkSize, prevEnd / 8));
+        auto& job = jobs.front().job;
+        holdingSlot = true;
+        if (i == 0 || (job.found && job.chunk.startBitMin <= prevEnd && prevEnd <= job.chunk.startBit)) {
+            if (job.error) {
+                std::rethrow_exception(job.error);
+            }
+            accept(job.chunk);
+            return;
+        }
+        jobs.recycle();
+        holdingSlot = false;
+        if (prevEnd >= nominalEnd(i)) { // previous chunk already covered this chunk
+            return;
+        }
+        // wrong guess of the worker, decoding with known window
+        auto w = std::min(totalSize, window.size());
+        redoDecoder.decode(data, prevEnd, nominalEnd(i), std::span<char const>{window.data() + window.size() - w, w}, false, redo);
+        accept(redo);
+    }
+
+public:
+    size_t read(std::ranges::contiguous_range auto&& range) {
+        static_assert(std::same_as<std::ranges::range_value_t<decltype(range)>, char>);
+        startThreads();
+        while (true) {
+            for (auto& p : pending) {
+                if (p.empty()) continue;
+                auto n = std::min(p.size(), range.size());
+                std::memcpy(range.data(), p.data(), n);
+                p = p.subspan(n);
+                return n;
+            }
+            if (holdingSlot) {
+                jobs.recycle();
+                holdingSlot = false;
+            }
+            if (finished) return 0;
+            if (current >= chunkCount) {
+                throw std::runtime_error{"gzip file is truncated"};
+            }
+            nextChunk();
+        }
+    }
+};
+
+#else
+
+struct gzip_mt_reader : zlib_reader {
+    gzip_mt_reader(mmap_reader reader_, size_t threadNbr=1, size_t chunkSize=4<<20)
+        : zlib_reader{std::move(reader_)}
+    {
+        (void)threadNbr;
+        (void)chunkSize;
+    }
+};
+
+#endif
+static_assert(Readable<gzip_mt_reader>);
+
+/* \brief same as makeZlibReader, but regular gzip files are decompressed with `threadNbr` threads
+ *
+ * A value of 0 decompresses sequentially.
+ */
+inline auto makeZlibReader(std::filesystem::path file, size_t threadNbr, mmap_policy policy = {}, io_uring_reader_config readAhead = {}) -> VarBufferedReader {
+    if (threadNbr == 0 || !is_regular_file(file)) {
+        return makeZlibReader(file, policy, readAhead);
+    }
+    auto reader = mmap_reader{file, policy}; // create a reader and peak into the file
+    auto [buffer, len] = reader.read(2);
+    if (zlib_reader::isGZipHeader({buffer, len})) {
+        return gzip_mt_reader{std::move(reader), threadNbr};
+    }
+    return reader;
+}
+
+// streams are always decompressed sequentially
+inline auto makeZlibReader(std::istream& file, size_t threadNbr, mmap_policy = {}, io_uring_reader_config = {}) -> VarBufferedReader {
+    (void)threadNbr;
+    return makeZlibReader(file);
+}
+
+}
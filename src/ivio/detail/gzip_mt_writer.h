@@ -0,0 +1,321 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "async_writer.h"
+#include "zlib_file_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivio {
+
+namespace gzip_writer::detail {
+
+// raw deflate stream (no zlib/gzip header), used to compress a single chunk
+struct DeflateContext {
+    zlib::stream stream{};
+
+    DeflateContext(int level) {
+        constexpr auto RawWindowBits = -15;
+        if (zlib::deflate_init2(stream, level, RawWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error{"error initializing zlib/deflateInit2"};
+        }
+    }
+    DeflateContext(DeflateContext const&) = delete;
+    auto operator=(DeflateContext const&) -> DeflateContext& = delete;
+
+    ~DeflateContext() {
+        zlib::deflate_end(stream);
+    }
+
+    /* Compresses `in`, back references may point into `dictionary` (the data in front of `in`).
+     * If not `last`, the output ends on a byte boundary (Z_SYNC_FLUSH), so the next chunk can be
+     * appended directly. The last chunk finishes the deflate stream.
+     */
+    void compress(std::span<char const> dictionary, std::span<char const> in, bool last, std::vector<char>& out) {
+        if (zlib::deflate_reset(stream) != Z_OK) {
+            throw std::runtime_error{"error resetting zlib/deflateReset"};
+        }
+        if (!dictionary.empty() && zlib::deflate_set_dictionary(stream, dictionary.data(), static_cast<uint32_t>(dictionary.size())) != Z_OK) {
+            throw std::runtime_error{"error setting dictionary zlib/deflateSetDictionary"};
+        }
+        assert(in.size() <= std::numeric_limits<uint32_t>::max());
+
+        stream.next_in  = (unsigned char*)in.data();
+        stream.avail_in = static_cast<uint32_t>(in.size());
+
+        out.resize(in.size() + in.size() / 1000 + 64);
+        size_t length{};
+        auto flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+        while (true) {
+            if (length == out.size()) {
+                out.resize(out.size() * 2);
+            }
+            stream.next_out  = (unsigned char*)out.data() + length;
+            stream.avail_out = static_cast<uint32_t>(out.size() - length);
+            auto ret = zlib::deflate(stream, flush);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                throw std::runtime_error{"error deflating data with zlib"};
+            }
+            length = out.size() - stream.avail_out;
+            if (last ? ret == Z_STREAM_END : (stream.avail_in == 0 && stream.avail_out > 0)) break;
+        }
+        out.resize(length);
+    }
+};
+
+}
+
+//!WORKAROUND llvm < 18 and MSVC < 19.28 do not provide jthread
+// see bgzf_mt_reader.h for details
+#if (defined(__GLIBCXX__) || (_LIBCPP_VERSION >= 180000 && !__APPLE__) || _MSC_VER >= 1928) && !defined(__EMSCRIPTEN__)
+
+/* \brief gzip writer that compresses chunks on a pool of worker threads (like pigz)
+ *
+ * The input is split into chunks of `chunkSize` bytes. Each chunk is compressed
+ * independently as raw deflate data, primed with the last 32KiB of the chunk in
+ * front of it as dictionary. All chunks, except the last one, end with an empty
+ * stored block (Z_SYNC_FLUSH), so they can be concatenated into a single deflate
+ * stream. The calling thread writes the chunks in order and combines their crcs.
+ * The result is a single gzip member, readable by any gzip implementation.
+ * At most 2*threadNbr chunks are in flight.
+ */
+template <writer_c Writer>
+struct gzip_mt_writer_impl {
+    static constexpr size_t windowSize = 1<<15;
+
+    struct Job {
+        std::vector<char>  uncompressed;
+        std::vector<char>  dictionary;
+        std::vector<char>  compressed;
+        uint32_t           crc{};
+        bool               last{};
+        bool               ready{};
+        std::exception_ptr error;
+        std::unique_ptr<gzip_writer::detail::DeflateContext> ctx;
+    };
+
+    Writer file;
+    size_t threadNbr;
+    int    level;
+    size_t chunkSize;
+    std::vector<char> buffer{};
+    std::vector<char> dictionary{}; // last 32KiB of the previously submitted chunk
+
+    uint32_t crc{};       // crc of all written chunks
+    size_t   totalSize{}; // uncompressed size of all written chunks
+
+    std::mutex              mutex;
+    std::condition_variable cvWork; // notifies workers about new jobs
+    std::condition_variable cvDone; // notifies the writer about finished jobs
+    std::vector<Job>        jobs;   // used as ring buffer
+    size_t submitted{};             // number of jobs handed to the workers
+    size_t claimed{};               // number of jobs picked up by a worker
+    size_t written{};               // number of jobs written to file
+    bool   terminate{};
+    bool   closed{};
+
+    std::vector<std::jthread> threads;
+
+    gzip_mt_writer_impl(Writer&& _file, size_t threadNbr, int level = Z_DEFAULT_COMPRESSION, size_t chunkSize = 1<<17)
+        : file{std::move(_file)}
+        , threadNbr{std::max<size_t>(1, threadNbr)}
+        , level{level}
+        , chunkSize{std::max(windowSize, chunkSize)}
+    {}
+
+    // Threads are started lazily, so moving is only possible before the first chunk was submitted
+    gzip_mt_writer_impl(gzip_mt_writer_impl&& _other)
+        : file{std::move(_other.file)}
+        , threadNbr{_other.threadNbr}
+        , level{_other.level}
+        , chunkSize{_other.chunkSize}
+        , buffer{std::move(_other.buffer)}
+    {
+        assert(_other.threads.empty());
+        _other.closed = true;
+    }
+
+    gzip_mt_writer_impl(gzip_mt_writer_impl const&) = delete;
+    auto operator=(gzip_mt_writer_impl const&) -> gzip_mt_writer_impl& = delete;
+    auto operator=(gzip_mt_writer_impl&&) -> gzip_mt_writer_impl& = delete;
+
+    ~gzip_mt_writer_impl() {
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
+        stopThreads();
+    }
+
+private:
+    void startThreads() {
+        jobs.resize(threadNbr*2);
+        for (auto& job : jobs) {
+            job.ctx = std::make_unique<gzip_writer::detail::DeflateContext>(level);
+        }
+        while (threads.size() < threadNbr) {
+            threads.emplace_back([this]() {
+                while (true) {
+                    auto g = std::unique_lock{mutex};
+                    cvWork.wait(g, [&]() { return terminate || claimed < submitted; });
+                    if (claimed == submitted) return; // terminate was requested and all work is done
+                    auto& job = jobs[claimed % jobs.size()];
+                    claimed += 1;
+                    g.unlock();
+
+                    try {
+                        job.ctx->compress(job.dictionary, job.uncompressed, job.last, job.compressed);
+                        job.crc = zlib::crc32(0, job.uncompressed.data(), static_cast<uint32_t>(job.uncompressed.size()));
+                    } catch(...) {
+                        job.error = std::current_exception();
+                    }
+
+                    g.lock();
+                    job.ready = true;
+                    cvDone.notify_one();
+                }
+            });
+        }
+    }
+
+    // writes the oldest job to file, if wait is false it will only write if it is already compressed
+    bool writeOldest(bool wait) {
+        auto g = std::unique_lock{mutex};
+        if (written == submitted) return false;
+        auto& job = jobs[written % jobs.size()];
+        if (!wait && !job.ready) return false;
+        cvDone.wait(g, [&]() { return job.ready; });
+        job.ready = false;
+        written += 1;
+        g.unlock();
+
+        if (job.error) {
+            std::rethrow_exception(std::exchange(job.error, nullptr));
+        }
+        if (written == 1) {
+            // gzip header: ID1 ID2 CM FLG [MTIME    ] XFL OS
+            auto header = std::array<char, 10>{'\x1f', '\x8b', '\x08', 0, 0, 0, 0, 0, 0, '\x03'};
+            file.write(header);
+        }
+        file.write(job.compressed);
+        crc = zlib::crc32_combine(crc, job.crc, job.uncompressed.size());
+        totalSize += job.uncompressed.size();
+        if (job.last) {
+            auto trailer = std::array<char, 8>{};
+            for (size_t i{0}; i < 4; ++i) {
+                trailer[i]   = static_cast<char>(crc >> (i*8));
+                trailer[i+4] = static_cast<char>(totalSize >> (i*8)); // size modulo 2^32
+            }
+            file.write(trailer);
+        }
+        return true;
+    }
+
+    void stopThreads() {
+        {
+            auto g = std::unique_lock{mutex};
+            terminate = true;
+            cvWork.notify_all();
+        }
+        threads.clear();
+    }
+
+    void submit(std::span<char const> data, bool last) {
+        if (threads.empty()) {
+            startThreads();
+        }
+        // make room, if all jobs are in flight
+        if (submitted - written == jobs.size()) {
+            writeOldest(/*.wait=*/true);
+        }
+        auto& job = jobs[submitted % jobs.size()];
+        job.uncompressed.assign(data.begin(), data.end());
+        job.dictionary.swap(dictionary);
+        job.last = last;
+
+        // the tail of this chunk primes the next one
+        auto tail = data.subspan(data.size() - std::min(data.size(), windowSize));
+        dictionary.assign(tail.begin(), tail.end());
+        {
+            auto g = std::unique_lock{mutex};
+            submitted += 1;
+            cvWork.notify_one();
+        }
+        // write out everything that is already finished
+        while (writeOldest(/*.wait=*/false)) {}
+    }
+
+public:
+    auto write(std::span<char const> out) -> size_t {
+        buffer.insert(buffer.end(), out.begin(), out.end());
+
+        size_t start{};
+        while (buffer.size() - start >= chunkSize) {
+            submit({buffer.data() + start, chunkSize}, /*.last=*/false);
+            start += chunkSize;
+        }
+        // move left over data to the beginning
+        std::memmove(buffer.data(), buffer.data() + start, buffer.size() - start);
+        buffer.resize(buffer.size() - start);
+        return out.size();
+    }
+
+    void close() {
+        if (closed) return;
+        closed = true;
+
+        try {
+            // the last chunk finishes the deflate stream, even if it is empty
+            submit(buffer, /*.last=*/true);
+            buffer.clear();
+            while (writeOldest(/*.wait=*/true)) {}
+        } catch(...) {
+            stopThreads();
+            throw;
+        }
+        stopThreads();
+        file.close();
+    }
+};
+
+#else
+
+template <writer_c Writer>
+struct gzip_mt_writer_impl : buffered_writer<zlib_writer_impl<Writer>> {
+    gzip_mt_writer_impl(Writer&& _file, size_t threadNbr, int level = Z_DEFAULT_COMPRESSION, size_t chunkSize = 1<<17)
+        : buffered_writer<zlib_writer_impl<Writer>>{zlib_writer_impl<Writer>{std::move(_file), level}}
+    {
+        (void)threadNbr;
+        (void)chunkSize;
+    }
+};
+
+#endif
+
+using gzip_mt_file_writer   = gzip_mt_writer_impl<file_writer>;
+using gzip_mt_stream_writer = gzip_mt_writer_impl<stream_writer>;
+
+static_assert(writer_c<gzip_mt_file_writer>);
+static_assert(writer_c<gzip_mt_stream_writer>);
+
+// picks a sequential or a multi threaded gzip writer, wrapped by an async_writer if requested
+template <typename Variant, writer_c Writer>
+auto makeGzipWriter(Writer writer, size_t threadNbr, int level, bool async) -> Variant {
+    if (threadNbr > 0) {
+        return makeAsyncOptional<Variant>(async, gzip_mt_writer_impl<Writer>{std::move(writer), threadNbr, level});
+    }
+    return makeAsyncOptional<Variant>(async, buffered_writer{zlib_writer_impl<Writer>{std::move(writer), level}});
+}
+}
@@ -0,0 +1,311 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "buffered_reader.h"
+#include "gzip_checkpoint_index.h"
+#include "mmap_reader.h"
+#include "zlib_backend.h"
+#include "zlib_file_reader.h"
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace ivio {
+
+/* \brief BufferedReadable over a regular gzip file, which supports tell/seek with uncompressed offsets
+ *
+ * While decompressing, a checkpoint (see gzip_checkpoint_index) is recorded
+ * every `spacing` bytes. seek() restarts inflating at the last checkpoint in
+ * front of the target and only decompresses the remaining distance. Once the
+ * end of the file was reached, all checkpoints are known and are written to
+ * `indexPath` (best effort, failures are ignored). If that file already exists and belongs to the same gzip file
+ * (same size and same trailer of the last member), it is loaded instead, so seeks are cheap from the start.
+ * Concatenated gzip members are supported. The compressed data must be seekable.
+ */
+class gzip_seekable_reader {
+    static constexpr size_t stepSize = 1<<18; // bytes decompressed at once
+
+    VarBufferedReader       reader;
+    zlib::stream            stream{};
+    gzip_checkpoint_index   index;
+    std::filesystem::path   indexPath;
+    bool                    indexComplete{}; // all checkpoints of the file are known
+    size_t                  coffset{};       // compressed offset of the reader's window
+    bool                    raw{};           // decoding raw deflate data (restarted at a checkpoint)
+    bool                    finished{};
+
+    std::vector<char>       buffer;    // decompressed data, valid until `filled`
+    size_t                  pos{};     // start of the window
+    size_t                  filled{};
+    size_t                  dropped{}; // uncompressed offset of buffer[0]
+
+    // uncompressed offset at which the next checkpoint is due
+    auto nextCheckpoint() const -> size_t {
+        return (index.points.empty() ? 0 : index.points.back().uoffset) + index.spacing;
+    }
+
+    void addCheckpoint() {
+        auto window = std::string(gzip_checkpoint_index::windowSize, '\0');
+        auto len    = uint32_t{};
+        if (zlib::inflate_get_dictionary(stream, window.data(), &len) != Z_OK) {
+            throw std::runtime_error{"error reading the inflate window"};
+        }
+        window.resize(len);
+        index.points.push_back({
+            .uoffset = dropped + filled,
+            .coffset = coffset,
+            .bits    = static_cast<uint8_t>(stream.data_type & 7),
+            .window  = std::move(window),
+        });
+    }
+
+    // continues with the next gzip member or marks the end of the file
+    void nextMember() {
+        if (raw) { // zlib only decoded the deflate data, the member's trailer (crc32 and size) is left
+            auto [ptr, len] = reader.read(8);
+            if (len < 8) {
+                throw std::runtime_error{"gzip stream is truncated"};
+            }
+            reader.dropUntil(8);
+            coffset += 8;
+        }
+        auto [next, len] = reader.read(2);
+        if (len >= 2 && std::string_view{next, 2} == "\x1f\x8b") {
+            zlib::inflate_reset2(stream, 16 + MAX_WBITS);
+            raw = false;
+            return;
+        }
+        finished = true;
+        if (!indexComplete) {
+            indexComplete = true;
+            if (!indexPath.empty()) {
+                try {
+                    index.save(indexPath);
+                } catch(...) {} // the index only speeds up later runs, e.g. the directory might be read only
+            }
+        }
+    }
+
+    // decompresses the next step, returns false if the end of the data is reached
+    bool readMore() {
+        if (pos > 0) { // move the window to the front of the buffer
+            std::memmove(buffer.data(), buffer.data() + pos, filled - pos);
+            dropped += pos;
+            filled  -= pos;
+            pos      = 0;
+        }
+        if (buffer.size() < filled + stepSize) {
+            buffer.resize(filled + stepSize);
+        }
+        while (!finished) {
+            auto [ptr, avail_in] = reader.read(stepSize);
+            if (avail_in == 0) {
+                throw std::runtime_error{"gzip stream is truncated"};
+            }
+            avail_in = std::min<size_t>(std::numeric_limits<uint32_t>::max(), avail_in);
+
+            // stop at deflate block boundaries, if a checkpoint is due
+            auto indexing = !indexComplete && dropped + filled >= nextCheckpoint();
+
+            stream.next_in   = (unsigned char*)(ptr);
+            stream.avail_in  = static_cast<uint32_t>(avail_in);
+            stream.next_out  = (unsigned char*)(buffer.data() + filled);
+            stream.avail_out = static_cast<uint32_t>(stepSize);
+            auto ret = zlib::inflate(stream, indexing ? Z_BLOCK : Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                throw std::runtime_error{"error inflating gzip data"};
+            }
+            auto consumedBytes = avail_in - stream.avail_in;
+            reader.dropUntil(consumedBytes);
+            coffset += consumedBytes;
+
+            auto producedBytes = stepSize - stream.avail_out;
+            filled += producedBytes;
+
+            // a block ended, which is not the last block of the member
+            if (indexing && (stream.data_type & 128) && !(stream.data_type & 64)) {
+                addCheckpoint();
+            }
+            if (ret == Z_STREAM_END) {
+                nextMember();
+            }
+            if (producedBytes > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // restarts inflating at checkpoint `p` (nullptr: start of the file)
+    void restart(gzip_checkpoint_index::checkpoint const* p) {
+        pos = filled = 0;
+        finished = false;
+        if (p == nullptr) {
+            dropped = coffset = 0;
+            reader.seek(0);
+            zlib::inflate_reset2(stream, 16 + MAX_WBITS);
+            raw = false;
+            return;
+        }
+        dropped = p->uoffset;
+        coffset = p->coffset - (p->bits > 0 ? 1 : 0);
+        reader.seek(coffset);
+        zlib::inflate_reset2(stream, -MAX_WBITS);
+        raw = true;
+        if (p->bits > 0) { // the remaining bits of the partially consumed byte
+            auto [ptr, len] = reader.read(1);
+            if (len < 1) {
+                throw std::runtime_error{"gzip checkpoint is beyond the end of the file"};
+            }
+            zlib::inflate_prime(stream, p->bits, static_cast<unsigned char>(ptr[0]) >> (8 - p->bits));
+            reader.dropUntil(1);
+            coffset += 1;
+        }
+        if (zlib::inflate_set_dictionary(stream, p->window.data(), static_cast<uint32_t>(p->window.size())) != Z_OK) {
+            throw std::runtime_error{"error restoring the inflate window"};
+        }
+    }
+
+    auto window() const -> std::string_view {
+        return {buffer.data() + pos, filled - pos};
+    }
+
+public:
+    gzip_seekable_reader(VarBufferedReader reader_, gzip_checkpoint_index::fingerprint file, size_t spacing, std::filesystem::path indexPath_)
+        : reader{std::move(reader_)}
+        , indexPath{std::move(indexPath_)}
+    {
+        if (!indexPath.empty() && std::filesystem::exists(indexPath)) {
+            auto loaded = gzip_checkpoint_index::load(indexPath);
+            if (loaded && loaded->file == file) { // otherwise the index is stale and is replaced
+                index         = std::move(*loaded);
+                indexComplete = true;
+            }
+        }
+        if (!indexComplete) {
+            index.file    = file;
+            index.spacing = std::max<size_t>(spacing, 1);
+        }
+        if (zlib::inflate_init2(stream, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error{"error initializing zlib/inflateInit2"};
+        }
+    }
+    gzip_seekable_reader(gzip_seekable_reader&& _other)
+        : reader{std::move(_other.reader)}
+        , index{std::move(_other.index)}
+        , indexPath{std::move(_other.indexPath)}
+        , indexComplete{_other.indexComplete}
+    {
+        assert(_other.coffset == 0); // only unused readers can be moved
+        if (zlib::inflate_init2(stream, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error{"error initializing zlib/inflateInit2"};
+        }
+    }
+    gzip_seekable_reader(gzip_seekable_reader const&) = delete;
+    ~gzip_seekable_reader() {
+        zlib::inflate_end(stream);
+    }
+
+    auto operator=(gzip_seekable_reader const&) -> gzip_seekable_reader& = delete;
+    auto operator=(gzip_seekable_reader&&) -> gzip_seekable_reader& = delete;
+
+    size_t readUntil(char c, size_t lastUsed) {
+        while (true) {
+            auto p = window().find(c, lastUsed);
+            if (p != std::string_view::npos) {
+                return p;
+            }
+            lastUsed = std::max(lastUsed, filled - pos); // only search new data
+            if (!readMore()) {
+                return filled - pos;
+            }
+        }
+    }
+
+    auto read(size_t ct) -> std::tuple<char const*, size_t> {
+        while (filled - pos < ct) {
+            if (!readMore()) break;
+        }
+        return {buffer.data() + pos, filled - pos};
+    }
+
+    void dropUntil(size_t i) {
+        assert(pos + i <= filled);
+        pos += i;
+    }
+
+    bool eof(size_t i) {
+        while (i >= filled - pos) {
+            if (!readMore()) return true;
+        }
+        return false;
+    }
+
+    auto string_view(size_t start, size_t end) -> std::string_view {
+        return window().substr(start, end - start);
+    }
+
+    // uncompressed offset of the start of the window
+    auto tell() const -> size_t {
+        return dropped + pos;
+    }
+
+    // moves the window to the uncompressed offset `offset`
+    void seek(size_t offset) {
+        if (offset < dropped || offset > dropped + filled) {
+            // continue inflating, unless restarting at a checkpoint skips more data
+            auto p = index.find(offset);
+            if (offset < dropped || (p != nullptr && p->uoffset > dropped + filled)) {
+                restart(p);
+            }
+        }
+        while (offset > dropped + filled) {
+            pos = filled; // skip all decompressed data
+            if (!readMore()) {
+                throw std::runtime_error{"offset " + std::to_string(offset) + " is beyond the end of the gzip file"};
+            }
+        }
+        pos = offset - dropped;
+    }
+};
+
+static_assert(BufferedReadable<gzip_seekable_reader>);
+static_assert(Seekable<gzip_seekable_reader>);
+
+/* \brief same as makeZlibReader, but regular gzip files are decompressed by a gzip_seekable_reader
+ *
+ * A checkpoint is recorded every `spacing` decompressed bytes, the index is
+ * stored at `indexPath` (if empty "<file>.gzidx").
+ */
+inline auto makeSeekableZlibReader(std::filesystem::path file, size_t spacing, std::filesystem::path indexPath, mmap_policy policy = {}, io_uring_reader_config readAhead = {}) -> VarBufferedReader {
+    if (!is_regular_file(file)) {
+        return makeZlibReader(file, policy, readAhead);
+    }
+    auto reader = mmap_reader{file, policy}; // create a reader and peak into the file
+    auto [buffer, len] = reader.read(2);
+    if (!zlib_reader::isGZipHeader({buffer, len})) {
+        return reader;
+    }
+    if (indexPath.empty()) {
+        indexPath = file.string() + ".gzidx";
+    }
+    return gzip_seekable_reader{std::move(reader), gzip_checkpoint_index::fingerprint::of(file), spacing, std::move(indexPath)};
+}
+
+// streams can not seek, they are decompressed as usual
+inline auto makeSeekableZlibReader(std::istream& file, size_t spacing, std::filesystem::path indexPath, mmap_policy = {}, io_uring_reader_config = {}) -> VarBufferedReader {
+    (void)spacing;
+    (void)indexPath;
+    return makeZlibReader(file);
+}
+
+}
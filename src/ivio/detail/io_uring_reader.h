@@ -0,0 +1,421 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "file_reader.h"
+#include "io_uring_reader_config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ivio {
+
+/* \brief reads a file with up to `depth` reads of `blockSize` bytes in flight
+ *
+ * Reads are submitted via io_uring ahead of the consumer, parsing and I/O
+ * overlap. For regular files all `depth` blocks are read concurrently at their
+ * offsets. Pipes, fifos and character devices are read with a single read in
+ * flight, since the order of concurrent reads is not defined.
+ * If io_uring is not available (old kernel, disabled by seccomp or sysctl), the
+ * blocks are read synchronously.
+ */
+class io_uring_reader {
+    struct Slot {
+        std::vector<char> buffer;
+        size_t offset{};  // file offset of buffer[0]
+        size_t filled{};  // bytes available in buffer
+        size_t pos{};     // bytes already consumed
+        bool   ready{};   // read has completed (filled == 0 indicates end of file)
+        int    error{};
+    };
+
+    int  fd{-1};
+    bool seekable{};
+    size_t blockSize;
+    std::vector<Slot> slots;
+
+    size_t head{};        // oldest queued slot
+    size_t queued{};      // number of slots that are in flight or ready
+    size_t inFlight{};
+    size_t nextOffset{};  // file offset of the next block to submit
+    size_t position{};    // file offset of the next byte returned by read
+    bool   endOfFile{};   // a read returned 0, no further reads are submitted
+
+    // io_uring state, ringFd == -1 if reading synchronously
+    int       ringFd{-1};
+    void*     sqRing{};
+    size_t    sqRingSize{};
+    void*     cqRing{};
+    size_t    cqRingSize{};
+    io_uring_sqe* sqes{};
+    size_t    sqesSize{};
+    unsigned* sqTail{};
+    unsigned* sqMask{};
+    unsigned* sqArray{};
+    unsigned* cqHead{};
+    unsigned* cqTail{};
+    unsigned* cqMask{};
+    io_uring_cqe* cqes{};
+    unsigned  pendingSubmits{};
+
+    static auto load(unsigned* p) -> unsigned {
+        return std::atomic_ref<unsigned>{*p}.load(std::memory_order_acquire);
+    }
+    static void store(unsigned* p, unsigned v) {
+        std::atomic_ref<unsigned>{*p}.store(v, std::memory_order_release);
+    }
+
+    void setupRing() {
+        auto params = io_uring_params{};
+        auto r = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(slots.size()), &params));
+        if (r < 0) return;
+        ringFd = r;
+        // IORING_OP_READ and reading at the current file position are available since the same kernel version
+        if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+            releaseRing();
+            return;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            releaseRing();
+            return;
+        }
+        if (singleMap) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = nullptr;
+                releaseRing();
+                return;
+            }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        auto sqesPtr = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqesPtr == MAP_FAILED) {
+            releaseRing();
+            return;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesPtr);
+
+        auto sq = static_cast<char*>(sqRing);
+        auto cq = static_cast<char*>(cqRing);
+        sqTail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    void releaseRing() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (ringFd != -1) ::close(ringFd);
+        ringFd = -1;
+        sqRing = cqRing = nullptr;
+        sqes = nullptr;
+    }
+
+    // reads the remaining part of slot i
+    void submit(size_t i) {
+        auto& slot = slots[i];
+        auto dst = slot.buffer.data() + slot.filled;
+        auto len = slot.buffer.size() - slot.filled;
+        if (ringFd == -1) {
+            auto r = seekable ? ::pread(fd, dst, len, static_cast<off_t>(slot.offset + slot.filled))
+                              : ::read(fd, dst, len);
+            complete(i, r < 0 ? -errno : static_cast<int>(r));
+            return;
+        }
+        auto tail = *sqTail;
+        auto idx  = tail & *sqMask;
+        auto& sqe = sqes[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode    = IORING_OP_READ;
+        sqe.fd        = fd;
+        sqe.addr      = reinterpret_cast<uint64_t>(dst);
+        sqe.len       = static_cast<uint32_t>(len);
+        sqe.off       = seekable ? slot.offset + slot.filled : uint64_t(-1); // -1: current position
+        sqe.user_data = i;
+        sqArray[idx]  = static_cast<unsigned>(idx);
+        store(sqTail, tail + 1);
+        ++pendingSubmits;
+        ++inFlight;
+    }
+
+    void complete(size_t i, int res) {
+        auto& slot = slots[i];
+        if (res == -EINTR || res == -EAGAIN) {
+            submit(i);
+            return;
+        }
+        if (res < 0) {
+            slot.error = -res;
+            slot.ready = true;
+            return;
+        }
+        slot.filled += static_cast<size_t>(res);
+        // short reads of regular files are continued, unless the end of the file is reached
+        if (seekable && res > 0 && slot.filled < slot.buffer.size()) {
+            submit(i);
+            return;
+        }
+        slot.ready = true;
+    }
+
+    // submits pending reads and waits for at least `minComplete` completions
+    void enter(unsigned minComplete) {
+        while (pendingSubmits > 0 || minComplete > 0) {
+            auto flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0u;
+            auto r = syscall(__NR_io_uring_enter, ringFd, pendingSubmits, minComplete, flags, nullptr, 0);
+            if (r < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                throw std::runtime_error{std::string{"io_uring_enter failed "} + strerror(errno)};
+            }
+            pendingSubmits -= std::min(pendingSubmits, static_cast<unsigned>(r));
+            if (minComplete > 0) return;
+        }
+    }
+
+    // processes all available completions, returns how many have been processed
+    auto reap() -> size_t {
+        size_t ct{};
+        auto h = *cqHead;
+        while (h != load(cqTail)) {
+            auto& cqe = cqes[h & *cqMask];
+            auto i   = static_cast<size_t>(cqe.user_data);
+            auto res = cqe.res;
+            store(cqHead, ++h);
+            --inFlight;
+            ++ct;
+            complete(i, res);
+        }
+        return ct;
+    }
+
+    // fills free slots with new reads
+    void pump() {
+        while (!endOfFile && queued < slots.size()) {
+            if (ringFd == -1) {
+                if (queued > 0) break; // synchronous reads are only done on demand
+            } else if (inFlight >= (seekable ? slots.size() : 1)) {
+                break; // reads of pipes must not overtake each other
+            }
+            auto i = (head + queued) % slots.size();
+            auto& slot = slots[i];
+            slot.offset = nextOffset;
+            slot.filled = 0;
+            slot.pos    = 0;
+            slot.ready  = false;
+            slot.error  = 0;
+            nextOffset += slot.buffer.size();
+            ++queued;
+            submit(i);
+        }
+        if (ringFd != -1 && pendingSubmits > 0) {
+            enter(0);
+        }
+    }
+
+    // waits until slot i has completed
+    void wait(size_t i) {
+        while (!slots[i].ready) {
+            if (reap() == 0) {
+                enter(1);
+            }
+        }
+    }
+
+    // reads might still be in flight after a failed drain(), the kernel may write into the buffers at any time
+    void leakBuffers() noexcept {
+        if (auto p = new (std::nothrow) std::vector<Slot>{}) {
+            p->swap(slots);
+        }
+    }
+
+    // waits until no read is in flight anymore
+    void drain() {
+        while (ringFd != -1 && inFlight > 0) {
+            if (reap() == 0) {
+                enter(1);
+            }
+        }
+    }
+
+public:
+    io_uring_reader(std::filesystem::path const& path, size_t depth = 4, size_t blockSize = 1<<17)
+        : fd{[&]() {
+            auto r = ::open(path.c_str(), O_RDONLY);
+            if (r == -1) {
+                throw std::runtime_error{"file " + path.string() + " not readable"};
+            }
+            return r;
+        }()}
+        , blockSize{std::max<size_t>(1, blockSize)}
+        , slots(std::max<size_t>(1, depth))
+    {
+        struct stat st;
+        seekable = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+        for (auto& slot : slots) {
+            slot.buffer.resize(this->blockSize);
+        }
+        setupRing();
+    }
+    io_uring_reader(std::filesystem::path const& path, io_uring_reader_config config)
+        : io_uring_reader{path, config.depth, config.blockSize}
+    {}
+
+    io_uring_reader() = delete;
+    io_uring_reader(io_uring_reader const&) = delete;
+    io_uring_reader(io_uring_reader&& _other) noexcept
+        : fd{_other.fd}
+        , seekable{_other.seekable}
+        , blockSize{_other.blockSize}
+        , slots{std::move(_other.slots)} // buffers of reads in flight stay at the same address
+        , head{_other.head}
+        , queued{_other.queued}
+        , inFlight{_other.inFlight}
+        , nextOffset{_other.nextOffset}
+        , position{_other.position}
+        , endOfFile{_other.endOfFile}
+        , ringFd{_other.ringFd}
+        , sqRing{_other.sqRing}
+        , sqRingSize{_other.sqRingSize}
+        , cqRing{_other.cqRing}
+        , cqRingSize{_other.cqRingSize}
+        , sqes{_other.sqes}
+        , sqesSize{_other.sqesSize}
+        , sqTail{_other.sqTail}
+        , sqMask{_other.sqMask}
+        , sqArray{_other.sqArray}
+        , cqHead{_other.cqHead}
+        , cqTail{_other.cqTail}
+        , cqMask{_other.cqMask}
+        , cqes{_other.cqes}
+        , pendingSubmits{_other.pendingSubmits}
+    {
+        _other.fd       = -1;
+        _other.ringFd   = -1;
+        _other.sqRing   = nullptr;
+        _other.cqRing   = nullptr;
+        _other.sqes     = nullptr;
+        _other.inFlight = 0;
+    }
+    auto operator=(io_uring_reader const&) -> io_uring_reader& = delete;
+    auto operator=(io_uring_reader&&) -> io_uring_reader& = delete;
+
+    ~io_uring_reader() {
+        try {
+            drain(); // the kernel might still write into the buffers
+        } catch(...) {
+            leakBuffers();
+        }
+        releaseRing();
+        if (fd != -1) ::close(fd);
+    }
+
+    size_t read(std::ranges::contiguous_range auto&& range) {
+        static_assert(std::same_as<std::ranges::range_value_t<decltype(range)>, char>);
+        size_t total{};
+        pump();
+        while (total < std::ranges::size(range) && queued > 0) {
+            auto& slot = slots[head];
+            if (!slot.ready) {
+                if (total > 0) break; // don't block if data is available
+                wait(head);
+            }
+            if (slot.error) {
+                throw std::runtime_error{std::string{"read failed "} + strerror(slot.error)};
+            }
+            if (slot.filled == 0) { // end of file, later slots are beyond the end as well
+                endOfFile = true;
+                break;
+            }
+            auto n = std::min(slot.filled - slot.pos, std::ranges::size(range) - total);
+            std::memcpy(std::ranges::data(range) + total, slot.buffer.data() + slot.pos, n);
+            slot.pos += n;
+            total    += n;
+            if (slot.pos == slot.filled) {
+                // a partially filled block of a regular file marks the end of file
+                if (seekable && slot.filled < slot.buffer.size()) {
+                    endOfFile = true;
+                }
+                head = (head + 1) % slots.size();
+                --queued;
+            }
+        }
+        pump();
+        position += total;
+        return total;
+    }
+
+    auto tell() const -> size_t {
+        return position;
+    }
+
+    void seek(size_t offset) {
+        drain();
+        if (!seekable && ::lseek64(fd, static_cast<off64_t>(offset), SEEK_SET) == -1) { // e.g. pipes
+            throw std::runtime_error{std::string{"seek failed "} + strerror(errno)};
+        }
+        head       = 0;
+        queued     = 0;
+        nextOffset = offset;
+        position   = offset;
+        endOfFile  = false;
+    }
+};
+
+}
+
+#else
+
+namespace ivio {
+
+// reads synchronously, io_uring is only available on linux
+struct io_uring_reader : file_reader {
+    io_uring_reader(std::filesystem::path const& path, size_t depth = 4, size_t blockSize = 1<<17)
+        : file_reader{path}
+    {
+        (void)depth;
+        (void)blockSize;
+    }
+    io_uring_reader(std::filesystem::path const& path, io_uring_reader_config)
+        : file_reader{path}
+    {}
+};
+
+}
+
+#endif
+
+static_assert(ivio::Readable<ivio::io_uring_reader>);
+static_assert(ivio::Seekable<ivio::io_uring_reader>);
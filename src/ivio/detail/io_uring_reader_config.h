@@ -0,0 +1,23 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <cstddef>
+
+namespace ivio {
+
+/* \brief describes how far io_uring_reader reads ahead of the consumer
+ *
+ * Only used for files, which can not be memory mapped (pipes, fifos, character devices).
+ */
+struct io_uring_reader_config {
+    // Number of blocks read ahead. Regular files have all of them in flight at once,
+    // pipes only a single one, since the order of concurrent reads is not defined
+    size_t depth = 4;
+
+    // Size of each read in bytes
+    size_t blockSize = 1<<17;
+};
+
+}
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+
+namespace ivio {
+
+/* \brief fixed capacity ring of jobs, which are filled and consumed in order
+ *
+ * Each slot carries a sequence number, which encodes its state for a ticket t:
+ *  - 2*t   : slot is free and waits to be filled with ticket t
+ *  - 2*t+1 : slot holds the finished job of ticket t
+ * Tickets are drawn in order by the workers, the single consumer waits on the
+ * sequence number of the next ticket via std::atomic::wait, no lock involved.
+ */
+template <typename Job>
+struct job_ring {
+    static constexpr size_t terminated = std::numeric_limits<size_t>::max();
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Job job;
+    };
+
+    size_t                  capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic_bool        terminate{};
+    size_t                  nextTicket{};   // next ticket to fill, only accessed while holding the reader lock
+    size_t                  frontTicket{};  // next ticket to consume, only accessed by the consumer
+
+    job_ring(size_t capacity)
+        : capacity{capacity}
+        , slots{std::make_unique<Slot[]>(capacity)}
+    {
+        for (size_t i{0}; i < capacity; ++i) {
+            slots[i].sequence.store(2*i, std::memory_order_relaxed);
+        }
+    }
+    job_ring(job_ring const&) = delete;
+    job_ring(job_ring&&) = delete;
+    auto operator=(job_ring const&) -> job_ring& = delete;
+    auto operator=(job_ring&&) -> job_ring& = delete;
+    ~job_ring() = default;
+
+    // wakes up all waiting producers and tells them to quit
+    void finish() {
+        terminate.store(true);
+        for (size_t i{0}; i < capacity; ++i) {
+            slots[i].sequence.store(terminated);
+            slots[i].sequence.notify_all();
+        }
+    }
+
+    // restores the initial state, only valid while no producer or consumer is active
+    void reset() {
+        terminate.store(false);
+        nextTicket  = 0;
+        frontTicket = 0;
+        for (size_t i{0}; i < capacity; ++i) {
+            slots[i].sequence.store(2*i, std::memory_order_relaxed);
+        }
+    }
+
+    // draws the next ticket and waits until its slot is free, returns nullptr if terminated
+    auto acquire() -> Slot* {
+        auto ticket = nextTicket++;
+        auto& slot = slots[ticket % capacity];
+        auto v = slot.sequence.load(std::memory_order_acquire);
+        while (v != 2*ticket) {
+            if (terminate.load()) return nullptr;
+            slot.sequence.wait(v, std::memory_order_acquire);
+            v = slot.sequence.load(std::memory_order_acquire);
+        }
+        return &slot;
+    }
+
+    // marks the slot as finished, the consumer can pick it up
+    void publish(Slot& slot) {
+        slot.sequence.fetch_add(1, std::memory_order_release);
+        slot.sequence.notify_all();
+    }
+
+    // waits until the next ticket in order is finished
+    auto front() -> Slot& {
+        auto& slot = slots[frontTicket % capacity];
+        auto v = slot.sequence.load(std::memory_order_acquire);
+        while (v != 2*frontTicket+1) {
+            slot.sequence.wait(v, std::memory_order_acquire);
+            v = slot.sequence.load(std::memory_order_acquire);
+        }
+        return slot;
+    }
+
+    // releases the front slot, so it can be reused for ticket frontTicket+capacity
+    void recycle() {
+        auto& slot = slots[frontTicket % capacity];
+        frontTicket += 1;
+        slot.sequence.store(2*(frontTicket + capacity - 1), std::memory_order_release);
+        slot.sequence.notify_all();
+    }
+};
+
+}
@@ -0,0 +1,148 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+// Only available if ivio was configured with IVIO_BGZF_BACKEND=libdeflate
+#ifdef IVIO_BGZF_BACKEND_LIBDEFLATE
+
+#include "portable_endian.h"
+
+#include <cstdint>
+#include <cstring>
+#include <libdeflate.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace ivio {
+
+/* \brief BGZF block decompression via libdeflate
+ *
+ * BGZF blocks are always decompressed as a whole, which allows using
+ * libdeflate's one-shot decompressor instead of a zlib stream.
+ * Same interface as ZlibContext.
+ */
+struct LibdeflateContext {
+    inline static constexpr size_t BlockFooterLength = 8;
+
+    libdeflate_decompressor* decompressor{};
+
+    LibdeflateContext()
+        : decompressor{libdeflate_alloc_decompressor()}
+    {
+        if (decompressor == nullptr) {
+            throw std::runtime_error{"BGZF libdeflate_alloc_decompressor() failed"};
+        }
+    }
+
+    LibdeflateContext(LibdeflateContext const&) = delete;
+    LibdeflateContext(LibdeflateContext&&) = delete;
+
+    ~LibdeflateContext() {
+        libdeflate_free_decompressor(decompressor);
+    }
+
+    auto operator=(LibdeflateContext const&) -> LibdeflateContext = delete;
+    auto operator=(LibdeflateContext&&) -> LibdeflateContext = delete;
+
+    size_t decompressedSize(std::span<char const> in) const {
+        uint32_t v;
+        std::memcpy(&v, in.data() + in.size() - 4, sizeof(v));
+        return le32toh(v);
+    }
+
+    size_t decompressBlock(std::span<char const> in, std::span<char> out) {
+        if (in.size() < BlockFooterLength) {
+            throw std::runtime_error{"BGZF block too short. " + std::to_string(in.size())};
+        }
+
+        size_t length{};
+        auto status = libdeflate_deflate_decompress(decompressor, in.data(), in.size() - BlockFooterLength, out.data(), out.size(), &length);
+        if (status != LIBDEFLATE_SUCCESS) {
+            throw std::runtime_error{"Inflation failed. libdeflate error code: " + std::to_string(status)};
+        }
+
+        // Compute and check checksum
+        uint32_t ecrc, dlen;
+        std::memcpy(&ecrc, in.data() + in.size() - 8, sizeof(ecrc));
+        std::memcpy(&dlen, in.data() + in.size() - 4, sizeof(dlen));
+        auto crc = libdeflate_crc32(0, out.data(), length);
+        if (le32toh(ecrc) != crc)
+            throw std::runtime_error{"BGZF wrong checksum." + std::to_string(le32toh(ecrc)) + " " + std::to_string(crc)};
+
+        // Check uncompressed data length
+        if (le32toh(dlen) != length)
+            throw std::runtime_error{"BGZF size mismatch."};
+
+        return length;
+    }
+};
+
+namespace bgzf_writer::detail {
+
+/* \brief BGZF block compression via libdeflate
+ *
+ * Same interface as bgzf_writer::detail::ZlibContext
+ */
+struct LibdeflateContext {
+    inline static constexpr size_t BlockHeaderLength = 18;
+    inline static constexpr size_t BlockFooterLength = 8;
+
+    libdeflate_compressor* compressor{};
+
+    LibdeflateContext()
+        : compressor{libdeflate_alloc_compressor(6)}
+    {
+        if (compressor == nullptr) {
+            throw std::runtime_error{"BGZF libdeflate_alloc_compressor() failed"};
+        }
+    }
+
+    LibdeflateContext(LibdeflateContext const&) = delete;
+    LibdeflateContext(LibdeflateContext&&) = delete;
+
+    ~LibdeflateContext() {
+        libdeflate_free_compressor(compressor);
+    }
+
+    auto operator=(LibdeflateContext const&) -> LibdeflateContext = delete;
+    auto operator=(LibdeflateContext&&) -> LibdeflateContext = delete;
+
+    size_t compressBlock(std::span<char const> in, std::span<char> out) {
+        constexpr char header[] =
+            // GZip header
+            "\x1f\x8b\x08"
+            // FLG[MTIME         ] XFL OS [XLEN  ]
+            "\x04\x00\x00\x00\x00\x00\xff\x06\x00"
+            // B   C [SLEN  ][BSIZE ]
+            "\x42\x43\x02\x00\x00\x00";
+        static_assert(sizeof(header) - 1 == BlockHeaderLength);
+
+        if (out.size() < BlockHeaderLength + BlockFooterLength) {
+            throw std::runtime_error{"output buffer is too short. " + std::to_string(out.size())};
+        }
+        std::memcpy(out.data(), header, BlockHeaderLength);
+
+        auto compressedLen = libdeflate_deflate_compress(compressor, in.data(), in.size(),
+                                                         out.data() + BlockHeaderLength,
+                                                         out.size() - BlockHeaderLength - BlockFooterLength);
+        if (compressedLen == 0) {
+            throw std::runtime_error{"Deflation failed. compressed BGZF data is too big. " + std::to_string(in.size())};
+        }
+
+        auto length = BlockHeaderLength + compressedLen + BlockFooterLength;
+        auto pack = [&](auto v, size_t pos) {
+            std::memcpy(out.data() + pos, &v, sizeof(v));
+        };
+        pack(htole16(static_cast<uint16_t>(length - 1)), 16);
+        pack(htole32(static_cast<uint32_t>(libdeflate_crc32(0, in.data(), in.size()))), length - 8);
+        pack(htole32(static_cast<uint32_t>(in.size())), length - 4);
+        return length;
+    }
+};
+
+}
+}
+
+#endif
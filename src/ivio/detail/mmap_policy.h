@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <cstddef>
+
+namespace ivio {
+
+/* \brief describes how a memory mapped file is accessed
+ *
+ * Only used for files, which are memory mapped (unix). The hints are passed to
+ * the kernel via madvise/posix_fadvise, unsupported hints are ignored.
+ */
+struct mmap_policy {
+    enum class access {
+        sequential, // MADV_SEQUENTIAL, consumed pages are unmapped
+        random,     // MADV_RANDOM, no read ahead, the file stays mapped (cheap backward seeks)
+    };
+    access pattern = access::sequential;
+
+    // Sequential access: bytes ahead of the consumer announced with MADV_WILLNEED (0 disables),
+    // on top of the read ahead the kernel already does for MADV_SEQUENTIAL
+    size_t readAhead = 0;
+
+    // Prefault the complete file when mapping it (MAP_POPULATE)
+    bool populate = false;
+
+    // Request transparent huge pages for the mapping (MADV_HUGEPAGE)
+    bool hugePages = false;
+
+    // Sequential access: drop consumed parts of the file from the page cache (POSIX_FADV_DONTNEED),
+    // avoids pushing data of other processes out of the page cache when scanning huge files once
+    bool dropBehind = false;
+
+    static auto random() -> mmap_policy {
+        return {.pattern = access::random};
+    }
+};
+
+}
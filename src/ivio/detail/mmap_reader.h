@@ -4,7 +4,9 @@
 #pragma once
 
 #include "file_reader.h"
+#include "mmap_policy.h"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <filesystem>
@@ -17,29 +19,66 @@ namespace ivio {
 class mmap_reader {
 protected:
     file_reader reader;
+    mmap_policy policy;
     size_t filesize_; // size of the file from inPos to the end
     char const* buffer;
     size_t inPos{};
+    size_t adviseEnd{}; // file offset until which MADV_WILLNEED was given
+
+    // file offset of buffer[0]
+    auto mappedStart() const -> size_t {
+        return reader.filesize() - filesize_;
+    }
+
+    auto map() -> char const* {
+        auto flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (policy.populate) flags |= MAP_POPULATE;
+#endif
+        auto ptr = (char const*)mmap(nullptr, filesize_, PROT_READ, flags, reader.getFileHandler(), 0);
+        if (ptr == MAP_FAILED) return ptr;
+
+        auto addr = (void*)ptr;
+        madvise(addr, filesize_, policy.pattern == mmap_policy::access::random ? MADV_RANDOM : MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        if (policy.hugePages) madvise(addr, filesize_, MADV_HUGEPAGE);
+#endif
+        adviseEnd = 0;
+        return ptr;
+    }
+
+    // announces the next `readAhead` bytes behind the current position
+    void willNeed() {
+        if (policy.pattern != mmap_policy::access::sequential || policy.readAhead == 0) return;
+        auto pos = tell();
+        if (pos + policy.readAhead / 2 < adviseEnd) return;
+        auto start = std::max(adviseEnd, mappedStart());
+        auto end   = std::min(pos + policy.readAhead, reader.filesize());
+        if (start >= end) return;
+        madvise((void*)(buffer + (start - mappedStart())), end - start, MADV_WILLNEED);
+        adviseEnd = (end == reader.filesize()) ? end : end & ~size_t{4095};
+    }
 
 public:
-    mmap_reader(std::filesystem::path path)
+    mmap_reader(std::filesystem::path path, mmap_policy policy = {})
         : reader{path}
+        , policy{policy}
         , filesize_{reader.filesize()}
-        , buffer{[&]() {
-            auto ptr = (char const*)mmap(nullptr, filesize_, PROT_READ, MAP_PRIVATE, reader.getFileHandler(), 0);
-            return ptr;
-        }()}
+        , buffer{map()}
     {
         assert(buffer);
+        willNeed();
     }
 
     mmap_reader() = delete;
     mmap_reader(mmap_reader const&) = delete;
     mmap_reader(mmap_reader&& _other) noexcept
         : reader{std::move(_other.reader)}
+        , policy{_other.policy}
         , filesize_{_other.filesize_}
         , buffer{_other.buffer}
         , inPos{_other.inPos}
+        , adviseEnd{_other.adviseEnd}
     {
         assert(buffer);
         _other.buffer = nullptr;
@@ -69,8 +108,9 @@ public:
     void dropUntil(size_t i) {
         i += inPos;
         assert(i <= filesize_);
-        if (i < 1'024ul * 1'024ul) {
+        if (i < 1'024ul * 1'024ul || policy.pattern == mmap_policy::access::random) {
             inPos = i;
+            willNeed();
             return;
         }
 
@@ -78,9 +118,13 @@ public:
         auto diff = (i & mask);
         assert(diff <= filesize_);
         munmap((void*)buffer, diff);
+        if (policy.dropBehind) {
+            posix_fadvise(reader.getFileHandler(), static_cast<off_t>(mappedStart()), static_cast<off_t>(diff), POSIX_FADV_DONTNEED);
+        }
         buffer = buffer + diff;
         filesize_ -= diff;
         inPos = i - diff;
+        willNeed();
     }
 
     bool eof(size_t i) const {
@@ -102,15 +146,17 @@ public:
     }
 
     void seek(size_t offset) {
-        if (offset >= tell()) { // Seeking forwards
-            inPos += offset - tell();
+        if (offset >= mappedStart()) { // target is still mapped
+            inPos = offset - mappedStart();
+            willNeed();
             return;
         }
-        // Seeking backwards requires remapping the file
+        // Seeking in front of the mapping requires remapping the file
         munmap((void*)buffer, filesize_);
         filesize_ = reader.filesize();
-        buffer = (char const*)mmap(nullptr, filesize_, PROT_READ, MAP_PRIVATE, reader.getFileHandler(), 0);
+        buffer = map();
         inPos = offset;
+        willNeed();
     }
 };
 
@@ -122,7 +168,14 @@ public:
 
 namespace ivio {
 
-using mmap_reader = buffered_reader<file_reader>;
+// without mmap, files are read via buffered_reader and the policy is ignored
+struct mmap_reader : buffered_reader<file_reader> {
+    mmap_reader(std::filesystem::path path, mmap_policy policy = {})
+        : buffered_reader<file_reader>{file_reader{path}}
+    {
+        (void)policy;
+    }
+};
 
 }
 
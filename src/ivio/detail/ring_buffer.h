@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ivio {
+
+/* \brief contiguous window of data, stored in a ring which is mapped twice
+ *
+ * A memfd of `capacity` bytes is mapped twice back-to-back. Data at the end of
+ * the ring continues seamlessly at its beginning, so the window and the free
+ * space behind it are always contiguous. Dropping data only advances an offset.
+ * Data is only copied if the ring is too small and has to grow.
+ *
+ * If the double mapping can not be created (not linux, memfd_create blocked by
+ * a sandbox, no file descriptors or mappings left), the data is kept in a
+ * std::vector instead. Consumed data is then removed by moving the remaining
+ * window to the front, once more than `compactAfter` bytes have been dropped.
+ */
+class ring_buffer {
+    char*  base{};     // start of the two mappings or of buf
+    size_t capacity{}; // size of a single mapping
+    size_t begin{};    // window is [begin, end) relative to base
+    size_t end{};
+    bool   mapped{};   // true if base is the double mapping, otherwise base points into buf
+
+    std::vector<char> buf;
+    size_t compactAfter{};
+
+#ifdef __linux__
+    static auto pageSize() -> size_t {
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    // returns nullptr if the double mapping is not available
+    static auto allocate(size_t capacity) -> char* {
+        auto fd = memfd_create("ivio_ring_buffer", MFD_CLOEXEC);
+        if (fd == -1) {
+            return nullptr;
+        }
+        if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+            close(fd);
+            return nullptr;
+        }
+        // reserve the address range, and place both mappings into it
+        auto ptr = static_cast<char*>(mmap(nullptr, capacity*2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (ptr == MAP_FAILED
+            || mmap(ptr,            capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+            || mmap(ptr + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            if (ptr != MAP_FAILED) munmap(ptr, capacity*2);
+            close(fd);
+            return nullptr;
+        }
+        close(fd);
+        return ptr;
+    }
+#endif
+
+public:
+    ring_buffer(size_t minCapacity) {
+#ifdef __linux__
+        auto p = pageSize();
+        capacity = std::max<size_t>(p, (minCapacity + p - 1) / p * p);
+        base     = allocate(capacity);
+        mapped   = base != nullptr;
+        if (mapped) return;
+#endif
+        buf.resize(minCapacity);
+        base         = buf.data();
+        compactAfter = minCapacity;
+    }
+    ring_buffer(ring_buffer const&) = delete;
+    ring_buffer(ring_buffer&& _other) noexcept
+        : base        {_other.base}
+        , capacity    {_other.capacity}
+        , begin       {_other.begin}
+        , end         {_other.end}
+        , mapped      {_other.mapped}
+        , buf         {std::move(_other.buf)}
+        , compactAfter{_other.compactAfter}
+    {
+        _other.base   = nullptr;
+        _other.mapped = false;
+    }
+    auto operator=(ring_buffer const&) -> ring_buffer& = delete;
+    auto operator=(ring_buffer&&) -> ring_buffer& = delete;
+
+    ~ring_buffer() {
+#ifdef __linux__
+        if (!mapped) return;
+        munmap(base, capacity*2);
+#endif
+    }
+
+    auto data() const -> char const* { return base + begin; }
+    auto size() const -> size_t { return end - begin; }
+
+    // returns writable memory behind the window, of at least n bytes
+    auto free(size_t n) -> std::span<char> {
+#ifdef __linux__
+        if (mapped && capacity - size() < n) {
+            grow(size() + n);
+        }
+        if (mapped) {
+            return {base + end, capacity - size()};
+        }
+#endif
+        if (buf.size() - end < n) {
+            buf.resize(std::max(buf.size()*2, end + n));
+            base = buf.data();
+        }
+        return {base + end, buf.size() - end};
+    }
+
+    // appends n bytes, which have been written into free()
+    void commit(size_t n) {
+        end += n;
+    }
+
+    void drop(size_t n) {
+        begin += n;
+        if (mapped) {
+            if (begin >= capacity) {
+                begin -= capacity;
+                end   -= capacity;
+            }
+            return;
+        }
+        if (begin < compactAfter) return;
+        std::copy(buf.begin() + begin, buf.begin() + end, buf.begin());
+        end  -= begin;
+        begin = 0;
+    }
+
+    void clear() {
+        begin = 0;
+        end   = 0;
+    }
+
+private:
+#ifdef __linux__
+    // moves the window into a larger ring, or into buf if no new ring can be mapped
+    void grow(size_t minCapacity) {
+        auto newCapacity = capacity;
+        while (newCapacity < minCapacity) {
+            newCapacity *= 2;
+        }
+        auto ptr       = allocate(newCapacity);
+        auto newMapped = ptr != nullptr;
+        if (!newMapped) {
+            buf.resize(newCapacity);
+            compactAfter = capacity;
+            ptr          = buf.data();
+        }
+        std::memcpy(ptr, data(), size());
+        munmap(base, capacity*2);
+        end      = size();
+        begin    = 0;
+        base     = ptr;
+        mapped   = newMapped;
+        capacity = newCapacity;
+    }
+#endif
+};
+
+}
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace ivio::detail {
+
+// bitmask of all positions of `c` in the 64 bytes starting at `data`
+inline auto charMask(char const* data, char c) -> uint64_t {
+#if defined(__AVX2__)
+    auto v = _mm256_set1_epi8(c);
+    auto l = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(data)), v)));
+    auto h = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + 32)), v)));
+    return uint64_t{l} | (uint64_t{h} << 32);
+#elif defined(__SSE2__) || defined(_M_X64)
+    auto v = _mm_set1_epi8(c);
+    uint64_t m{};
+    for (size_t i{0}; i < 4; ++i) {
+        auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i*16));
+        m |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, v)))} << (i*16);
+    }
+    return m;
+#else
+    uint64_t m{};
+    for (size_t i{0}; i < 64; ++i) {
+        m |= uint64_t{data[i] == c} << i;
+    }
+    return m;
+#endif
+}
+
+// bitmask of all positions of `c` in the first `len` (< 64) bytes starting at `data`
+inline auto charMask(char const* data, size_t len, char c) -> uint64_t {
+    auto tmp = std::array<char, 64>{};
+    std::memcpy(tmp.data(), data, len);
+    return charMask(tmp.data(), c) & ((uint64_t{1} << len) - 1);
+}
+
+/* \brief splits a line into `ct` fields, using a structural index of the separators
+ *
+ * The first ct-1 fields are terminated by `sep`, the last field is the remainder
+ * of the line. Instead of searching for each separator separately, a bitmask of
+ * all separators is computed for 64 bytes at a time (like simdjson's structural
+ * index) and the field boundaries are read off the set bits.
+ * Lines with at least `minCt` fields are accepted, missing fields are empty.
+ * Returns std::nullopt if the line has fewer than minCt fields.
+ */
+template <size_t ct>
+auto splitFields(std::string_view line, char sep, size_t minCt = ct) -> std::optional<std::array<std::string_view, ct>> {
+    static_assert(ct >= 2);
+    auto res = std::array<std::string_view, ct>{};
+    size_t field{};
+    size_t start{};
+    for (size_t block{0}; block < line.size(); block += 64) {
+        auto len  = std::min<size_t>(64, line.size() - block);
+        auto bits = (len == 64) ? charMask(line.data() + block, sep)
+                                : charMask(line.data() + block, len, sep);
+        while (bits != 0) {
+            auto end = block + static_cast<size_t>(std::countr_zero(bits));
+            res[field] = line.substr(start, end - start);
+            start = end+1;
+            if (++field == ct-1) {
+                res.back() = line.substr(start);
+                return res;
+            }
+            bits &= bits - 1;
+        }
+    }
+    if (field+1 < minCt) {
+        return std::nullopt;
+    }
+    res[field] = line.substr(start);
+    return res;
+}
+
+/* \brief calls `cb` for each field of `line`, for lines with a varying number of fields
+ *
+ * Fields are separated by `sep`, the last field is the remainder of the line
+ * (an empty line consists of a single empty field). Uses the same bitmask of
+ * separators as splitFields.
+ */
+template <typename CB>
+void forEachField(std::string_view line, char sep, CB&& cb) {
+    size_t start{};
+    for (size_t block{0}; block < line.size(); block += 64) {
+        auto len  = std::min<size_t>(64, line.size() - block);
+        auto bits = (len == 64) ? charMask(line.data() + block, sep)
+                                : charMask(line.data() + block, len, sep);
+        while (bits != 0) {
+            auto end = block + static_cast<size_t>(std::countr_zero(bits));
+            cb(line.substr(start, end - start));
+            start = end+1;
+            bits &= bits - 1;
+        }
+    }
+    cb(line.substr(start));
+}
+
+// parse error for a line with fewer than `minCt` fields, quotes the start of the line
+inline auto missingFieldsError(std::string_view format, size_t minCt, std::string_view line) -> std::runtime_error {
+    constexpr size_t maxLen = 80;
+    auto quote = std::string{line.substr(0, maxLen)} + (line.size() > maxLen ? "..." : "");
+    return std::runtime_error{"invalid " + std::string{format} + " line, expected at least "
+                              + std::to_string(minCt) + " fields: \"" + quote + "\""};
+}
+
+}
@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+// Library used for gzip/deflate streams, selected by the cmake option IVIO_ZLIB_BACKEND
+#ifdef IVIO_ZLIB_BACKEND_ZLIB_NG
+#include <zlib-ng.h>
+#else
+#include <zlib.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+/* Thin wrappers around the zlib API
+ *
+ * zlib-ng's native API prefixes every function with `zng_`, while zlib
+ * implements some of its functions as macros. These wrappers give both a
+ * common interface.
+ */
+namespace ivio::zlib {
+
+#ifdef IVIO_ZLIB_BACKEND_ZLIB_NG
+
+using stream = zng_stream;
+
+inline int inflate_init2(stream& s, int windowBits) { return zng_inflateInit2(&s, windowBits); }
+inline int inflate(stream& s, int flush)            { return zng_inflate(&s, flush); }
+inline int inflate_reset(stream& s)                 { return zng_inflateReset(&s); }
+inline int inflate_end(stream& s)                   { return zng_inflateEnd(&s); }
+inline int inflate_reset2(stream& s, int windowBits) { return zng_inflateReset2(&s, windowBits); }
+inline int inflate_prime(stream& s, int bits, int value) { return zng_inflatePrime(&s, bits, value); }
+inline int inflate_set_dictionary(stream& s, void const* dict, uint32_t len) {
+    return zng_inflateSetDictionary(&s, static_cast<uint8_t const*>(dict), len);
+}
+inline int inflate_get_dictionary(stream& s, void* dict, uint32_t* len) {
+    return zng_inflateGetDictionary(&s, static_cast<uint8_t*>(dict), len);
+}
+
+inline int deflate_init2(stream& s, int level, int windowBits, int memLevel, int strategy) {
+    return zng_deflateInit2(&s, level, Z_DEFLATED, windowBits, memLevel, strategy);
+}
+inline int deflate(stream& s, int flush) { return zng_deflate(&s, flush); }
+inline int deflate_reset(stream& s)      { return zng_deflateReset(&s); }
+inline int deflate_end(stream& s)        { return zng_deflateEnd(&s); }
+inline int deflate_set_dictionary(stream& s, void const* dict, uint32_t len) {
+    return zng_deflateSetDictionary(&s, static_cast<uint8_t const*>(dict), len);
+}
+
+inline uint32_t crc32(uint32_t crc, void const* buffer, uint32_t len) {
+    return zng_crc32(crc, static_cast<uint8_t const*>(buffer), len);
+}
+inline uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+    return zng_crc32_combine(crc1, crc2, static_cast<z_off64_t>(len2));
+}
+
+#else
+
+using stream = z_stream;
+
+inline int inflate_init2(stream& s, int windowBits) { return inflateInit2(&s, windowBits); }
+inline int inflate(stream& s, int flush)            { return ::inflate(&s, flush); }
+inline int inflate_reset(stream& s)                 { return ::inflateReset(&s); }
+inline int inflate_end(stream& s)                   { return ::inflateEnd(&s); }
+inline int inflate_reset2(stream& s, int windowBits) { return ::inflateReset2(&s, windowBits); }
+inline int inflate_prime(stream& s, int bits, int value) { return ::inflatePrime(&s, bits, value); }
+inline int inflate_set_dictionary(stream& s, void const* dict, uint32_t len) {
+    return ::inflateSetDictionary(&s, static_cast<Bytef const*>(dict), len);
+}
+inline int inflate_get_dictionary(stream& s, void* dict, uint32_t* len) {
+    return ::inflateGetDictionary(&s, static_cast<Bytef*>(dict), len);
+}
+
+inline int deflate_init2(stream& s, int level, int windowBits, int memLevel, int strategy) {
+    return deflateInit2(&s, level, Z_DEFLATED, windowBits, memLevel, strategy);
+}
+inline int deflate(stream& s, int flush) { return ::deflate(&s, flush); }
+inline int deflate_reset(stream& s)      { return ::deflateReset(&s); }
+inline int deflate_end(stream& s)        { return ::deflateEnd(&s); }
+inline int deflate_set_dictionary(stream& s, void const* dict, uint32_t len) {
+    return ::deflateSetDictionary(&s, static_cast<Bytef const*>(dict), len);
+}
+
+inline uint32_t crc32(uint32_t crc, void const* buffer, uint32_t len) {
+    return static_cast<uint32_t>(::crc32(crc, static_cast<Bytef const*>(buffer), len));
+}
+inline uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+    return static_cast<uint32_t>(::crc32_combine(crc1, crc2, static_cast<z_off_t>(len2)));
+}
+
+#endif
+
+}
@@ -5,46 +5,48 @@
 
 #include "buffered_reader.h"
 #include "file_reader.h"
+#include "io_uring_reader.h"
 #include "mmap_reader.h"
 #include "stream_reader.h"
+#include "zlib_backend.h"
+#include "zlib_mmap2_reader.h"
 
 #include <fstream>
 #include <ranges>
-#include <zlib.h>
 
 namespace ivio {
 
 struct zlib_reader {
     VarBufferedReader reader;
 
-    z_stream stream = []() {
-        auto _stream = z_stream{};
-        _stream.next_in   = Z_NULL;
+    zlib::stream stream = []() {
+        auto _stream = zlib::stream{};
+        _stream.next_in   = nullptr;
         _stream.avail_in  = 0;
         _stream.total_out = 0;
-        _stream.zalloc    = Z_NULL;
-        _stream.zfree     = Z_NULL;
-        _stream.opaque    = Z_NULL;
+        _stream.zalloc    = nullptr;
+        _stream.zfree     = nullptr;
+        _stream.opaque    = nullptr;
         return _stream;
     }();
 
     zlib_reader(VarBufferedReader reader)
         : reader{std::move(reader)}
     {
-        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        if (zlib::inflate_init2(stream, 16 + MAX_WBITS) != Z_OK) {
             throw std::runtime_error{"error"};
         }
     }
     zlib_reader(zlib_reader&& _other)
         : reader{std::move(_other.reader)}
     {
-        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        if (zlib::inflate_init2(stream, 16 + MAX_WBITS) != Z_OK) {
             throw std::runtime_error{"error"};
         }
     }
 
     ~zlib_reader() {
-        inflateEnd(&stream);
+        zlib::inflate_end(stream);
     }
 
     size_t read(std::ranges::contiguous_range auto&& range) {
@@ -58,7 +60,7 @@ struct zlib_reader {
             stream.avail_in = static_cast<uint32_t>(avail_in);
             stream.avail_out = static_cast<uint32_t>(avail_out);
             stream.next_out  = (unsigned char*)range.data();
-            auto ret = inflate(&stream, Z_NO_FLUSH);
+            auto ret = zlib::inflate(stream, Z_NO_FLUSH);
             auto diff = avail_in - stream.avail_in;
 
             reader.dropUntil(diff);
@@ -85,32 +87,40 @@ struct zlib_reader {
 
 static_assert(Readable<zlib_reader>);
 
-inline auto makeZlibReader(std::filesystem::path file) -> VarBufferedReader {
+// decompresses gzip data, on unix directly into a contiguous memory mapping (see zlib_mmap2_reader)
+inline auto makeGzipReader(VarBufferedReader reader, std::any storage = {}) -> VarBufferedReader {
+#if (defined(unix) || defined(__unix__) || defined(__unix))
+    return {zlib_mmap2_reader{std::move(reader)}, std::move(storage)};
+#else
+    return {zlib_reader{std::move(reader)}, std::move(storage)};
+#endif
+}
+
+inline auto makeZlibReader(std::filesystem::path file, mmap_policy policy = {}, io_uring_reader_config readAhead = {}) -> VarBufferedReader {
     if (is_regular_file(file)) {
-        auto reader = mmap_reader{file}; // create a reader and peak into the file
+        auto reader = mmap_reader{file, policy}; // create a reader and peak into the file
         auto [buffer, len] = reader.read(2);
         if (zlib_reader::isGZipHeader({buffer, len})) {
-            return zlib_reader{std::move(reader)};
+            return makeGzipReader(std::move(reader));
         }
         return reader;
     } else {
-        auto ifs = std::make_shared<std::ifstream>(file, std::ios::binary);
-
-        auto reader = stream_reader{*ifs}; // create a reader and peak into the file
-        auto buffer = std::array<char, 2>{};
-        auto len = reader.peek(buffer);
-        if (zlib_reader::isGZipHeader({buffer.data(), len})) {
-            return zlib_reader{std::move(reader)};
+        // pipes and other special files can not be mapped, they are read ahead asynchronously
+        auto reader = buffered_reader<io_uring_reader>{io_uring_reader{file, readAhead}}; // create a reader and peak into the file
+        auto [buffer, len] = reader.read(2);
+        if (zlib_reader::isGZipHeader({buffer, len})) {
+            return makeGzipReader(std::move(reader));
         }
-        return {std::move(reader), std::any{ifs}};
+        return reader;
     }
 }
-inline auto makeZlibReader(std::istream& file) -> VarBufferedReader {
+// the policy and read ahead are ignored, they only apply to files
+inline auto makeZlibReader(std::istream& file, mmap_policy = {}, io_uring_reader_config = {}) -> VarBufferedReader {
     auto reader = stream_reader{file};
     auto buffer = std::array<char, 2>{};
     auto len = reader.peek(buffer);
     if (zlib_reader::isGZipHeader({buffer.data(), len})) {
-        return zlib_reader{std::move(reader)};
+        return makeGzipReader(std::move(reader));
     }
     return reader;
 }
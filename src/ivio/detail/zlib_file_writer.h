@@ -6,34 +6,36 @@
 #include "buffered_writer.h"
 #include "file_writer.h"
 #include "stream_writer.h"
+#include "zlib_backend.h"
 
 #include <array>
 #include <cassert>
 #include <ranges>
-#include <zlib.h>
 
 namespace ivio {
 
 template <writer_c writer>
 struct zlib_writer_impl {
     writer file;
+    int    level;
 
-    z_stream stream = []() {
-        auto _stream = z_stream{};
-        _stream.next_in   = Z_NULL;
+    zlib::stream stream = []() {
+        auto _stream = zlib::stream{};
+        _stream.next_in   = nullptr;
         _stream.avail_in  = 0;
         _stream.total_out = 0;
-        _stream.zalloc    = Z_NULL;
-        _stream.zfree     = Z_NULL;
-        _stream.opaque    = Z_NULL;
+        _stream.zalloc    = nullptr;
+        _stream.zfree     = nullptr;
+        _stream.opaque    = nullptr;
         return _stream;
     }();
 
     zlib_writer_impl() = delete;
-    zlib_writer_impl(writer&& name)
+    zlib_writer_impl(writer&& name, int level = Z_DEFAULT_COMPRESSION)
         : file{std::move(name)}
+        , level{level}
     {
-        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        if (zlib::deflate_init2(stream, level, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
             throw std::runtime_error{"error initializing zlib/deflateInit2"};
         }
     }
@@ -41,14 +43,17 @@ struct zlib_writer_impl {
     zlib_writer_impl(zlib_writer_impl const& _other) = delete;
     zlib_writer_impl(zlib_writer_impl&& _other)
         : file{std::move(_other.file)}
+        , level{_other.level}
     {
-        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        if (zlib::deflate_init2(stream, level, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
             throw std::runtime_error{"error initializing zlib/deflateInit2"};
         }
     }
 
     ~zlib_writer_impl() {
-        close();
+        try {
+            close();
+        } catch(...) {} // errors are only reported by an explicit close()
     }
 
     auto operator=(zlib_writer_impl&&) = delete;
@@ -63,7 +68,7 @@ struct zlib_writer_impl {
         stream.next_out  = (unsigned char*)&outBuffer[0];
         stream.avail_out = static_cast<uint32_t>(outBuffer.size());
 
-        auto ret = deflate(&stream, Z_NO_FLUSH);
+        auto ret = zlib::deflate(stream, Z_NO_FLUSH);
         if (ret != Z_OK && ret != Z_STREAM_END) {
             throw std::runtime_error{"error deflating data with zlib"};
         }
@@ -79,7 +84,7 @@ struct zlib_writer_impl {
                 stream.next_out  = (unsigned char*)&outBuffer[0];
                 stream.avail_out = static_cast<uint32_t>(outBuffer.size());
 
-                auto ret = deflate(&stream, Z_FINISH);
+                auto ret = zlib::deflate(stream, Z_FINISH);
                 if (ret != Z_OK && ret != Z_STREAM_END) {
                     throw std::runtime_error{"error deflating data with zlib"};
                 }
@@ -88,7 +93,7 @@ struct zlib_writer_impl {
             file.close();
             stream.next_in = nullptr;
         }
-        deflateEnd(&stream);
+        zlib::deflate_end(stream);
     }
 };
 
@@ -2,147 +2,240 @@
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
 #pragma once
-#if 0
 
-#include "mmap_reader.h"
+#include "buffered_reader.h"
+#include "zlib_backend.h"
 
-#include <zlib.h>
-#include <ranges>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
+#if (defined(unix) || defined(__unix__) || defined(__unix))
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace ivio {
 
+/* \brief contiguous window of data, backed by an anonymous memory mapping
+ *
+ * An address range is reserved up front (MAP_NORESERVE, memory is only
+ * committed when touched). Data is appended at the end and consumed pages
+ * at the front are released (on linux moved behind the end for reuse), so
+ * the window never has to be moved. Only if the reserved range is exhausted,
+ * the window is copied into a new mapping.
+ */
 struct mmap_queue {
-    // this mmap_queue only sufficient for 4 Terabytes of data
-    size_t filesize = 1'024ul*1'024ul*1'024ul*1'024ul*4ul;
-    char* buffer {[&]() {
-        auto ptr = (char*)mmap(nullptr, filesize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
-        return ptr;
-    }()};
-    size_t inPos{};
-
-    mmap_queue() = default;
+    static constexpr size_t reservation = size_t{1} << 30; // 1GiB
+
+    // page size of the system, munmap/mremap require page aligned ranges
+    static auto pageSize() -> size_t {
+        static auto const size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    char*  base{};   // start of the still mapped range
+    size_t mapped{}; // size of the still mapped range
+    size_t begin{};  // window is [begin, end) relative to base
+    size_t end{};
+
+    mmap_queue() {
+        remap(reservation);
+    }
+    mmap_queue(mmap_queue const&) = delete;
     mmap_queue(mmap_queue&& _other) noexcept
-        : filesize{_other.filesize}
-        , buffer  {_other.buffer}
-        , inPos   {_other.inPos}
+        : base  {_other.base}
+        , mapped{_other.mapped}
+        , begin {_other.begin}
+        , end   {_other.end}
     {
-        _other.buffer = nullptr;
+        _other.base = nullptr;
     }
+    auto operator=(mmap_queue const&) -> mmap_queue& = delete;
+    auto operator=(mmap_queue&&) -> mmap_queue& = delete;
 
     ~mmap_queue() {
-        if (buffer == nullptr) return;
-        munmap((void*)buffer, filesize);
+        if (base == nullptr) return;
+        munmap(base, mapped);
     }
 
+    auto data() const -> char const* { return base + begin; }
+    auto size() const -> size_t { return end - begin; }
 
-    void dropUntil(size_t i) {
-        i = i + inPos;
-        if (i < 1'024ul * 1'024ul) {
-            inPos = i;
-            return;
+    // returns writable memory behind the window, of at least n bytes
+    auto free(size_t n) -> std::span<char> {
+        if (end + n > mapped) {
+            auto p = pageSize();
+            remap(std::max(reservation, (size() + n + p - 1) / p * p + p));
         }
-        auto mask = std::numeric_limits<size_t>::max() - 4095;
-        auto diff = i & mask;
-        munmap((void*)buffer, diff);
-        buffer = buffer + diff;
-        filesize -= diff;
-        inPos = i - diff;
+        return {base + end, mapped - end};
     }
-};
 
+    // appends n bytes, which have been written into free()
+    void commit(size_t n) {
+        end += n;
+    }
 
-struct zlib_mmap2_reader : protected mmap_reader {
-    z_stream stream {};
+    void drop(size_t n) {
+        begin += n;
+        if (begin < (1<<20)) return;
+
+        // release consumed pages
+        auto p    = pageSize();
+        auto diff = begin - (begin % p);
+#ifdef __linux__
+        // recycles the pages by moving them behind the window, this avoids page faults when writing
+        auto tail = (end + p - 1) / p * p;
+        if (tail + diff > mapped
+            || mremap(base, diff, diff, MREMAP_MAYMOVE | MREMAP_FIXED, base + tail) == MAP_FAILED) {
+            munmap(base, diff);
+        }
+#else
+        munmap(base, diff);
+#endif
+        base   += diff;
+        mapped -= diff;
+        begin  -= diff;
+        end    -= diff;
+    }
 
-    mmap_queue queue;
+private:
+    // moves the window into a new mapping
+    void remap(size_t newSize) {
+        auto ptr = static_cast<char*>(mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0));
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error{"failed reserving memory for decompression"};
+        }
+        if (base) {
+            std::memcpy(ptr, data(), size());
+            munmap(base, mapped);
+        }
+        end    = size();
+        begin  = 0;
+        base   = ptr;
+        mapped = newSize;
+    }
+};
 
-    zlib_mmap2_reader(char const* name)
-        : mmap_reader(name)
+/* \brief decompresses gzip data into a mmap_queue
+ *
+ * Decompressed data is appended to a single contiguous range, records never
+ * straddle a buffer boundary and dropping data never moves memory.
+ * Concatenated gzip members are decompressed one after another.
+ */
+struct zlib_mmap2_reader {
+    static constexpr size_t stepSize = 1<<18; // bytes decompressed at once
+
+    VarBufferedReader reader;
+    zlib::stream      stream{};
+    mmap_queue        queue;
+    bool              finished{};
+
+    zlib_mmap2_reader(VarBufferedReader reader_)
+        : reader{std::move(reader_)}
     {
-        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
-            throw "error";
+        if (zlib::inflate_init2(stream, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error{"error initializing zlib/inflateInit2"};
         }
-        stream.avail_in = filesize_;
-        stream.next_in  = (unsigned char*)buffer;
-        stream.next_out = (unsigned char*)queue.buffer;
     }
     zlib_mmap2_reader(zlib_mmap2_reader&& _other)
-        : mmap_reader{std::move(_other)}
+        : reader{std::move(_other.reader)}
+        , queue{std::move(_other.queue)}
+        , finished{_other.finished}
     {
-        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
-            throw "error";
+        if (zlib::inflate_init2(stream, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error{"error initializing zlib/inflateInit2"};
         }
-        stream.avail_in = filesize_;
-        stream.next_in  = (unsigned char*)buffer;
-        stream.next_out = (unsigned char*)queue.buffer;
-
-
     }
     zlib_mmap2_reader(zlib_mmap2_reader const&) = delete;
     ~zlib_mmap2_reader() {
-        inflateEnd(&stream);
+        zlib::inflate_end(stream);
     }
 
     auto operator=(zlib_mmap2_reader const&) -> zlib_mmap2_reader& = delete;
     auto operator=(zlib_mmap2_reader&&) -> zlib_mmap2_reader& = delete;
 
-    size_t filesize{};
-    size_t largestSize{1'024ul*1'024ul*4};
-
+private:
+    // decompresses the next step, returns false if the end of the data is reached
     auto readMore() -> bool {
-        while(true) {
-            if (filesize < largestSize) {
-                stream.avail_out = largestSize-filesize;
-            } else {
-                stream.avail_out += largestSize*0.25;
+        while (!finished) {
+            auto [ptr, avail_in] = reader.read(stepSize);
+            if (avail_in == 0) {
+                throw std::runtime_error{"gzip stream is truncated"};
+            }
+            auto out = queue.free(stepSize);
+            avail_in = std::min<size_t>(std::numeric_limits<uint32_t>::max(), avail_in);
+
+            stream.next_in   = (unsigned char*)(ptr);
+            stream.avail_in  = static_cast<uint32_t>(avail_in);
+            stream.next_out  = (unsigned char*)out.data();
+            stream.avail_out = static_cast<uint32_t>(stepSize);
+            auto ret = zlib::inflate(stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                throw std::runtime_error{"error inflating gzip data"};
+            }
+            reader.dropUntil(avail_in - stream.avail_in);
+
+            auto producedBytes = stepSize - stream.avail_out;
+            queue.commit(producedBytes);
+
+            if (ret == Z_STREAM_END) { // continue if another gzip member follows
+                auto [next, len] = reader.read(2);
+                if (len >= 2 && std::string_view{next, 2} == "\x1f\x8b") {
+                    zlib::inflate_reset(stream);
+                } else {
+                    finished = true;
+                }
             }
-            auto available = stream.avail_out;
-            auto ret = inflate(&stream, Z_NO_FLUSH);
-            mmap_reader::dropUntil((char*)stream.next_in - buffer);
-
-            auto producedBytes = available - stream.avail_out;
-            filesize += producedBytes;
-            largestSize = std::max(largestSize, filesize);
             if (producedBytes > 0) {
                 return true;
             }
-            if (ret == Z_STREAM_END) {
-                return false;
-            }
         }
+        return false;
     }
 
+public:
     size_t readUntil(char c, size_t lastUsed) {
         while (true) {
-            auto pos = std::string_view{queue.buffer, filesize}.find(c, lastUsed);
+            auto pos = std::string_view{queue.data(), queue.size()}.find(c, lastUsed);
             if (pos != std::string_view::npos) {
                 return pos;
             }
+            lastUsed = std::max(lastUsed, queue.size());
             if (!readMore()) {
-                return filesize;
+                return queue.size();
             }
         }
     }
 
-    auto read(size_t /*ct*/) -> std::tuple<char const*, size_t> {
-        return {nullptr, 0}; //!TODO this is broken
+    auto read(size_t ct) -> std::tuple<char const*, size_t> {
+        while (queue.size() < ct) {
+            if (!readMore()) break;
+        }
+        return {queue.data(), queue.size()};
     }
 
-
     void dropUntil(size_t i) {
-        queue.dropUntil(i);
-        filesize = filesize - i;
+        queue.drop(i);
     }
 
-    bool eof(size_t i) const {
-        return filesize == i;
+    bool eof(size_t i) {
+        while (i >= queue.size()) {
+            if (!readMore()) return true;
+        }
+        return false;
     }
 
     auto string_view(size_t start, size_t end) -> std::string_view {
-        return std::string_view{queue.buffer+start, queue.buffer+end};
+        return std::string_view{queue.data() + start, queue.data() + end};
     }
 };
 
 static_assert(BufferedReadable<zlib_mmap2_reader>);
+
 }
+
 #endif
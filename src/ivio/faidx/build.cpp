@@ -0,0 +1,211 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include "../detail/file_writer.h"
+#include "../detail/mmap_reader.h"
+#include "../detail/structural_index.h"
+#include "../detail/zlib_file_reader.h"
+#include "build.h"
+
+#include <algorithm>
+#include <bit>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace ivio::faidx {
+
+namespace {
+
+// chunks smaller than this are not worth a thread
+constexpr size_t minChunkSize = 1<<20;
+
+// reports the line breaks of `data`, found via a bitmask of 64 bytes at a time
+struct newline_scanner {
+    std::string_view data;
+    size_t           block; // start of the current 64 byte block
+    uint64_t         bits;  // line breaks of the current block, which were not reported yet
+
+    newline_scanner(std::string_view data, size_t pos)
+        : data{data}
+        , block{pos - pos % 64}
+        , bits{mask() & (~uint64_t{0} << (pos - block))}
+    {}
+
+    auto mask() const -> uint64_t {
+        auto len = std::min<size_t>(64, data.size() - block);
+        return (len == 64) ? detail::charMask(data.data() + block, '\n')
+                           : detail::charMask(data.data() + block, len, '\n');
+    }
+
+    // position of the next line break, data.size() if there is none
+    auto next() -> size_t {
+        while (bits == 0) {
+            block += 64;
+            if (block >= data.size()) return data.size();
+            bits = mask();
+        }
+        auto p = block + static_cast<size_t>(std::countr_zero(bits));
+        bits &= bits - 1;
+        return p;
+    }
+};
+
+// summary of consecutive sequence lines, partial summaries of neighboring chunks can be appended
+struct line_summary {
+    size_t count{};       // number of non empty lines
+    size_t bases{};
+    size_t firstBases{};
+    size_t firstWidth{};  // including the line ending
+    size_t lastBases{};
+    size_t lastWidth{};
+    bool   uniform{true}; // all lines, except the last one, look like the first one
+    bool   blankTail{};   // ends with empty lines
+    bool   blankInside{}; // an empty line is followed by a non empty one
+
+    void add(size_t lineBases, size_t lineWidth) {
+        if (lineBases == 0) {
+            blankTail = true;
+            return;
+        }
+        blankInside = blankInside || blankTail;
+        blankTail   = false;
+        if (count == 0) {
+            firstBases = lineBases;
+            firstWidth = lineWidth;
+        } else if (lastBases != firstBases || lastWidth != firstWidth) {
+            uniform = false;
+        }
+        count    += 1;
+        bases    += lineBases;
+        lastBases = lineBases;
+        lastWidth = lineWidth;
+    }
+
+    void append(line_summary const& o) {
+        if (o.count == 0) {
+            blankTail   = blankTail || o.blankTail;
+            blankInside = blankInside || o.blankInside;
+            return;
+        }
+        auto inside = blankInside || blankTail || o.blankInside;
+        if (count == 0) {
+            *this = o;
+        } else {
+            uniform = uniform && o.uniform
+                      && lastBases == firstBases && lastWidth == firstWidth
+                      && (o.count == 1 || (o.firstBases == firstBases && o.firstWidth == firstWidth));
+            count    += o.count;
+            bases    += o.bases;
+            lastBases = o.lastBases;
+            lastWidth = o.lastWidth;
+            blankTail = o.blankTail;
+        }
+        blankInside = inside;
+    }
+};
+
+struct partial_record {
+    std::string_view id;
+    size_t           offset; // first byte behind the header line
+    line_summary     lines;
+};
+
+struct chunk {
+    line_summary                leading; // lines in front of the first header, they belong to the previous chunk
+    std::vector<partial_record> records;
+};
+
+// scans all lines starting inside [begin, end), the last line may reach beyond `end`
+auto scanChunk(std::string_view data, size_t begin, size_t end) -> chunk {
+    auto res     = chunk{};
+    auto scanner = newline_scanner{data, begin == 0 ? 0 : begin - 1};
+    auto start   = (begin == 0) ? size_t{0} : scanner.next() + 1;
+    while (start < end) {
+        auto lineEnd = scanner.next();
+        auto line    = data.substr(start, lineEnd - start);
+        if (line.starts_with('>')) {
+            auto id = line.substr(1);
+            id = id.substr(0, id.find_first_of(" \t\r"));
+            res.records.push_back({id, std::min(lineEnd + 1, data.size()), {}});
+        } else {
+            auto lineBases = line.size() - (line.ends_with('\r') ? 1 : 0);
+            auto& lines    = res.records.empty() ? res.leading : res.records.back().lines;
+            lines.add(lineBases, line.size() + 1); // a missing line break at the end of the file counts as '\n'
+        }
+        start = lineEnd + 1;
+    }
+    return res;
+}
+
+}
+
+auto build(std::filesystem::path const& input, size_t threadNbr, std::filesystem::path output) -> std::vector<record> {
+    auto reader = mmap_reader{input};
+    auto [ptr, size] = reader.read(std::numeric_limits<size_t>::max());
+    auto data = std::string_view{ptr, size};
+    if (zlib_reader::isGZipHeader(data)) {
+        throw std::runtime_error{"compressed fasta files can not be indexed: " + input.string()};
+    }
+
+    // scan chunks in parallel, the first one on this thread
+    auto chunkCount = std::clamp<size_t>(threadNbr, 1, size / minChunkSize + 1);
+    auto bound      = [&](size_t i) { return size / chunkCount * i + std::min(i, size % chunkCount); };
+    auto futures    = std::vector<std::future<chunk>>{};
+    for (size_t i{1}; i < chunkCount; ++i) {
+        futures.emplace_back(std::async(std::launch::async, scanChunk, data, bound(i), bound(i+1)));
+    }
+    auto chunks = std::vector<chunk>{};
+    chunks.emplace_back(scanChunk(data, 0, bound(1)));
+    for (auto& f : futures) {
+        chunks.emplace_back(f.get());
+    }
+
+    // lines in front of the first header of a chunk continue the last record of the previous chunks
+    auto partials = std::vector<partial_record>{};
+    for (auto& c : chunks) {
+        if (!partials.empty()) {
+            partials.back().lines.append(c.leading);
+        } else if (c.leading.count > 0) {
+            throw std::runtime_error{"sequence data in front of the first header in " + input.string()};
+        }
+        partials.insert(partials.end(), c.records.begin(), c.records.end());
+    }
+
+    auto records = std::vector<record>{};
+    auto ids     = std::unordered_set<std::string_view>{};
+    auto buffer  = std::string{};
+    records.reserve(partials.size());
+    for (auto const& p : partials) {
+        auto const& l = p.lines;
+        if (!ids.insert(p.id).second) {
+            throw std::runtime_error{"duplicate sequence id " + std::string{p.id} + " in " + input.string()};
+        }
+        if (l.blankInside) {
+            throw std::runtime_error{"empty line inside of sequence " + std::string{p.id}};
+        }
+        if (!l.uniform || l.lastBases > l.firstBases) {
+            throw std::runtime_error{"different line lengths in sequence " + std::string{p.id}};
+        }
+        records.push_back({
+            .id        = std::string{p.id},
+            .length    = l.bases,
+            .offset    = p.offset,
+            .linebases = l.firstBases,
+            .linewidth = l.firstWidth,
+        });
+        auto const& r = records.back();
+        buffer += r.id + '\t' + std::to_string(r.length) + '\t' + std::to_string(r.offset)
+                + '\t' + std::to_string(r.linebases) + '\t' + std::to_string(r.linewidth) + '\n';
+    }
+
+    auto writer = file_writer{output.empty() ? std::filesystem::path{input.string() + ".fai"} : output};
+    writer.write(buffer);
+    writer.close();
+    return records;
+}
+
+}
@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "record.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace ivio::faidx {
+
+/**
+ * Creates the faidx index of the uncompressed fasta file `input` and writes it to
+ * `output` (if empty "<input>.fai")
+ *
+ * The memory mapped file is split into `threadNbr` chunks, which are scanned in
+ * parallel for line breaks and headers; no sequence is copied. As with samtools
+ * faidx, the id of a record is its header up to the first whitespace and all lines
+ * of a record, except the last, must have the same length.
+ * Returns the records of the index, throws if the file can not be indexed.
+ */
+auto build(std::filesystem::path const& input, size_t threadNbr = 1, std::filesystem::path output = {}) -> std::vector<record>;
+
+}
@@ -5,6 +5,7 @@
 #include "../detail/file_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
+#include "../detail/structural_index.h"
 #include "../detail/utilities.h"
 #include "../detail/zlib_file_reader.h"
 #include "reader.h"
@@ -24,7 +25,7 @@ struct reader_base<faidx::reader>::pimpl {
             auto reader = mmap_reader{file}; // create a reader and peak into the file
             auto [buffer, len] = reader.read(2);
             if (zlib_reader::isGZipHeader({buffer, len})) {
-                return zlib_reader{std::move(reader)};
+                return makeGzipReader(std::move(reader));
             }
             return reader;
         }()}
@@ -36,7 +37,7 @@ struct reader_base<faidx::reader>::pimpl {
             auto len = reader.read(buffer);
             reader.seek(0);
             if (zlib_reader::isGZipHeader({buffer.data(), len})) {
-                return zlib_reader{std::move(reader)};
+                return makeGzipReader(std::move(reader));
             }
             return reader;
         }()}
@@ -46,21 +47,14 @@ struct reader_base<faidx::reader>::pimpl {
 
 
 //!WORKAROUND clang crashes if this is a member function of pimpl, see https://github.com/llvm/llvm-project/issues/61159
-template <size_t ct, char sep>
+template <size_t ct, char sep, size_t minCt = ct>
 static auto readLine(ivio::reader_base<ivio::faidx::reader>::pimpl& self) -> std::optional<std::array<std::string_view, ct>> {
-    auto res = std::array<std::string_view, ct>{};
-    size_t start{};
-    for (size_t i{}; i < ct-1; ++i) {
-        auto end = self.ureader.readUntil(sep, start);
-        if (self.ureader.eof(end)) return std::nullopt;
-        res[i] = self.ureader.string_view(start, end);
-        start = end+1;
-    }
-    auto end = self.ureader.readUntil('\n', start);
+    auto end = self.ureader.readUntil('\n', 0);
     if (self.ureader.eof(end)) return std::nullopt;
-    res.back() = self.ureader.string_view(start, end);
-    self.lastUsed = end;
-    if (!self.ureader.eof(self.lastUsed)) self.lastUsed += 1;
+    auto line = self.ureader.string_view(0, end);
+    auto res = ivio::detail::splitFields<ct>(line, sep, minCt);
+    if (!res) throw ivio::detail::missingFieldsError("faidx", minCt, line);
+    self.lastUsed = end+1;
     return res;
 }
 
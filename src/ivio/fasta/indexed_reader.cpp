@@ -0,0 +1,183 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include "../detail/bgzf_reader.h"
+#include "../detail/genomic_region.h"
+#include "../detail/gzi_index.h"
+#include "../detail/mmap_reader.h"
+#include "../detail/zlib_file_reader.h"
+#include "../faidx/reader.h"
+#include "indexed_reader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace ivio::fasta {
+
+struct indexed_reader::pimpl {
+    mmap_reader                                 ureader;
+    std::vector<faidx::record>                  records;
+    std::map<std::string, size_t, std::less<>>  ids;    // position of each id in records
+    std::string                                 buffer; // bases of the last multi line fetch
+
+    // only for bgzf compressed files
+    std::optional<gzi_index>                    gzi;
+    std::optional<BgzfContext>                  bgzfCtx;
+    std::string                                 blockData;        // decompressed consecutive blocks
+    uint64_t                                    blockDataBegin{}; // uncompressed offset of blockData[0]
+
+    pimpl(config const& config_)
+        : ureader{config_.input, config_.mmapPolicy}
+    {
+        auto [ptr, size] = ureader.read(18);
+        if (zlib_reader::isGZipHeader({ptr, size})) {
+            // gzip header with an extra field, holding the "BC" subfield of bgzf
+            auto header = std::string_view{ptr, size};
+            if (size < 18 || header.substr(0, 4) != magic_bgzf_header.substr(0, 4) || header.substr(12, 4) != magic_bgzf_header.substr(12, 4)) {
+                throw std::runtime_error{"indexed_reader supports only bgzf compressed fasta files: " + config_.input.string()};
+            }
+            auto gziPath = config_.gziIndex.empty() ? std::filesystem::path{config_.input.string() + ".gzi"} : config_.gziIndex;
+            gzi.emplace(gzi_index::load(gziPath));
+            if (gzi->blocks.back().coffset > std::filesystem::file_size(config_.input)) {
+                throw std::runtime_error{"gzi index " + gziPath.string() + " does not match " + config_.input.string()};
+            }
+            bgzfCtx.emplace();
+        }
+
+        auto indexPath = config_.index.empty() ? std::filesystem::path{config_.input.string() + ".fai"} : config_.index;
+        if (!std::filesystem::exists(indexPath)) {
+            throw std::runtime_error{"faidx index " + indexPath.string() + " does not exist"};
+        }
+        for (auto r : faidx::reader{{indexPath}}) {
+            if (r.length > 0 && (r.linebases == 0 || r.linewidth < r.linebases)) {
+                throw std::runtime_error{"invalid faidx entry for " + std::string{r.id}};
+            }
+            ids.emplace(r.id, records.size());
+            records.emplace_back(r);
+        }
+    }
+
+    // file offset of base `pos` of sequence `r`
+    static auto fileOffset(faidx::record const& r, size_t pos) -> size_t {
+        return r.offset + (pos / r.linebases) * r.linewidth + pos % r.linebases;
+    }
+
+    /* decompresses the bgzf block at compressed offset `coffset` and appends it to blockData
+     * Returns the offset of the next block, or `coffset` at the end of the file.
+     */
+    auto appendBlock(uint64_t coffset) -> uint64_t {
+        ureader.seek(coffset);
+        auto [ptr, size] = ureader.read(18);
+        if (size == 0) return coffset;
+        if (size < 18) throw std::runtime_error{"bgzf block header is truncated"};
+
+        size_t compressedLen = bgzfUnpack<uint16_t>(ptr + 16) + 1u;
+        std::tie(ptr, size) = ureader.read(compressedLen);
+        if (size < compressedLen) {
+            throw std::runtime_error{"bgzf block is truncated"};
+        }
+        auto in  = std::span{ptr + 18, compressedLen - 18};
+        auto len = bgzfCtx->decompressedSize(in);
+        auto old = blockData.size();
+        blockData.resize(old + len);
+        bgzfCtx->decompressBlock(in, {blockData.data() + old, len});
+        return coffset + compressedLen;
+    }
+
+    // the uncompressed bytes [first, last) of the file
+    auto fileRange(size_t first, size_t last) -> std::string_view {
+        if (!gzi) {
+            ureader.seek(first);
+            auto [ptr, size] = ureader.read(last - first);
+            return {ptr, std::min(size, last - first)};
+        }
+        // decompress only the blocks covering the range, unless they are still present from the last call
+        if (first < blockDataBegin || last > blockDataBegin + blockData.size()) {
+            auto b = gzi->find(first);
+            blockData.clear();
+            blockDataBegin = b.uoffset;
+            // following blocks are found via the block sizes in their headers
+            for (auto next = b.coffset; blockDataBegin + blockData.size() < last;) {
+                auto coffset = std::exchange(next, appendBlock(next));
+                if (next == coffset) break; // end of file
+            }
+        }
+        auto offset = std::min(first - blockDataBegin, blockData.size());
+        return std::string_view{blockData}.substr(offset, last - first);
+    }
+
+    auto fetch(faidx::record const& r, size_t begin, size_t end) -> std::string_view {
+        end = std::min(end, r.length);
+        if (begin >= end) return {};
+
+        auto first = fileOffset(r, begin);
+        auto last  = fileOffset(r, end-1) + 1;
+        auto data  = fileRange(first, last);
+        if (data.size() < last - first) {
+            throw std::runtime_error{"fasta file is shorter than described by its index (" + r.id + ")"};
+        }
+
+        // single line, no copy needed
+        if (last - first == end - begin) {
+            return data;
+        }
+
+        // copy line by line, skipping the line endings
+        buffer.resize(end - begin);
+        auto lineEnding = r.linewidth - r.linebases;
+        auto ptr        = data.data();
+        size_t filled{};
+        auto   len = r.linebases - begin % r.linebases; // bases left in the first line
+        while (filled < buffer.size()) {
+            len = std::min(len, buffer.size() - filled);
+            std::memcpy(buffer.data() + filled, ptr, len);
+            filled += len;
+            ptr    += len + lineEnding;
+            len     = r.linebases;
+        }
+        return buffer;
+    }
+};
+
+indexed_reader::indexed_reader(config const& config_)
+    : pimpl_{std::make_unique<pimpl>(config_)}
+{}
+
+indexed_reader::~indexed_reader() = default;
+
+auto indexed_reader::records() const -> std::vector<faidx::record> const& {
+    assert(pimpl_);
+    return pimpl_->records;
+}
+
+auto indexed_reader::fetch(std::string_view id, size_t begin, size_t end) -> std::string_view {
+    assert(pimpl_);
+    auto iter = pimpl_->ids.find(id);
+    if (iter == pimpl_->ids.end()) {
+        throw std::runtime_error{"unknown sequence " + std::string{id}};
+    }
+    return pimpl_->fetch(pimpl_->records[iter->second], begin, end);
+}
+
+auto indexed_reader::fetch(std::string_view region) -> std::string_view {
+    assert(pimpl_);
+    // a complete sequence, its name might contain ':'
+    if (pimpl_->ids.contains(region)) {
+        return fetch(region, 0, std::numeric_limits<size_t>::max());
+    }
+    auto r = detail::parseRegion(region);
+    return fetch(r.name, static_cast<size_t>(r.begin), static_cast<size_t>(r.end));
+}
+
+void indexed_reader::close() {
+    pimpl_.reset();
+}
+
+}
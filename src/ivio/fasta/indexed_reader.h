@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#pragma once
+
+#include "../detail/mmap_policy.h"
+#include "../faidx/record.h"
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace ivio::fasta {
+
+/* \brief random access to subsequences of a fasta file with a faidx index
+ *
+ * The position of each base is computed from the offset, linebases and
+ * linewidth columns of the .fai file, only the requested bytes are touched.
+ * Bgzf compressed files (bgzip) additionally require a .gzi index, only the
+ * blocks covering the requested bases are decompressed.
+ */
+struct indexed_reader {
+    struct config {
+        // Fasta file, must be a regular file, either uncompressed or bgzf compressed
+        std::filesystem::path input;
+
+        // FAIDX index, if empty "<input>.fai" is used
+        std::filesystem::path index{};
+
+        // GZI index of bgzf compressed files, if empty "<input>.gzi" is used
+        std::filesystem::path gziIndex{};
+
+        // Access hints for the memory mapped file
+        mmap_policy mmapPolicy{mmap_policy::random()};
+    };
+
+private:
+    struct pimpl;
+    std::unique_ptr<pimpl> pimpl_;
+
+public:
+    indexed_reader(config const& config_);
+    ~indexed_reader();
+
+    // entries of the index, in the order of the .fai file
+    auto records() const -> std::vector<faidx::record> const&;
+
+    /**
+     * Returns the bases [begin, end) (0-based) of sequence `id`
+     *
+     * `end` is clamped to the length of the sequence. If the range spans a single line the
+     * result points directly into the mapped file (or the decompressed blocks), otherwise
+     * the line breaks inside the range are removed into an internal buffer. The result is valid until the next call
+     * of fetch() or until the reader is destroyed. Throws if `id` is unknown.
+     */
+    auto fetch(std::string_view id, size_t begin, size_t end) -> std::string_view;
+
+    /**
+     * Returns the bases of a region string "name", "name:begin" or "name:begin-end"
+     * (1-based, inclusive, as used by samtools faidx)
+     */
+    auto fetch(std::string_view region) -> std::string_view;
+
+    void close();
+};
+
+}
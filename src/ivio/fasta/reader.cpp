@@ -3,6 +3,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 #include "../detail/buffered_reader.h"
 #include "../detail/file_reader.h"
+#include "../detail/gzip_mt_reader.h"
+#include "../detail/gzip_seekable_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
 #include "../detail/zlib_file_reader.h"
@@ -28,7 +30,10 @@ namespace ivio::fasta {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(makeZlibReader(p));
+        if (config_.checkpointSpacing > 0) {
+            return std::make_unique<pimpl>(makeSeekableZlibReader(p, config_.checkpointSpacing, config_.checkpointIndex, config_.mmapPolicy, config_.readAhead));
+        }
+        return std::make_unique<pimpl>(makeZlibReader(p, config_.threadNbr, config_.mmapPolicy, config_.readAhead));
     }, config_.input)}
 {}
 
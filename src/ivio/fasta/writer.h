@@ -4,6 +4,7 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/file_writer_config.h"
 #include "../detail/writer_base.h"
 #include "record.h"
 
@@ -25,6 +26,27 @@ struct writer : writer_base<writer> {
         bool compressed{};
 
         size_t length{80}; // Break after 80 characters
+
+        // Value of 0 will run with a sequential implementation, other values will spawn new threads
+        // compressing gzip output in parallel chunks (the result is still a single gzip member)
+        size_t threadNbr = 0;
+
+        // gzip compression level from 0 (none) to 9 (best), -1 uses zlib's default
+        int compressionLevel = -1;
+
+        // Write BGZF blocks instead of a single gzip stream, which can be decompressed in parallel
+        // and indexed. Always used for `.bgz` files
+        bool bgzf{};
+
+        // BGZF only: a record never spans two blocks, unless it is larger than a block
+        bool alignRecords{};
+
+        // Compression and disk I/O run on a background thread, while the calling thread formats records.
+        // close() waits until everything is written
+        bool async{};
+
+        // Buffer size, O_DIRECT and space reservation of output files (ignored for streams)
+        file_writer_config fileConfig{};
     };
 
     writer(config config);
@@ -3,8 +3,11 @@
 // SPDX-License-Identifier: BSD-3-Clause
 #include "../detail/buffered_reader.h"
 #include "../detail/file_reader.h"
+#include "../detail/gzip_mt_reader.h"
+#include "../detail/gzip_seekable_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
+#include "../detail/structural_index.h"
 #include "../detail/zlib_file_reader.h"
 #include "reader.h"
 
@@ -21,7 +24,10 @@ namespace ivio::fastq {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(makeZlibReader(p));
+        if (config_.checkpointSpacing > 0) {
+            return std::make_unique<pimpl>(makeSeekableZlibReader(p, config_.checkpointSpacing, config_.checkpointIndex, config_.mmapPolicy, config_.readAhead));
+        }
+        return std::make_unique<pimpl>(makeZlibReader(p, config_.threadNbr, config_.mmapPolicy, config_.readAhead));
     }, config_.input)}
 {}
 
@@ -37,31 +43,27 @@ auto reader::next() -> std::optional<record_view> {
     if (ureader.eof(startId)) return std::nullopt;
     ureader.dropUntil(startId+1);
 
-    auto endId = ureader.readUntil('\n', 0);
-    if (ureader.eof(endId)) return std::nullopt;
-
-    auto startSeq = endId+1;
-    if (ureader.eof(startSeq)) return std::nullopt;
-
-    auto endSeq = ureader.readUntil('\n', startSeq);
-    if (ureader.eof(endSeq)) return std::nullopt;
-    if (ureader.eof(endSeq+1)) return std::nullopt;
-
-    auto startId2 = endSeq+2;
-    auto endId2 = ureader.readUntil('\n', startId2);
-    if (ureader.eof(endId2)) return std::nullopt;
-
-    auto startQual = endId2+1;
-    auto endQual = ureader.readUntil('\n', startQual);
-    if (ureader.eof(endQual)) return std::nullopt;
-
-    lastUsed = endQual;
+    // the four lines of the record are split at once, the window grows until it contains all of them
+    auto lines = std::optional<std::array<std::string_view, 5>>{};
+    char const* front{};
+    for (size_t ct{1<<12}; !lines; ct *= 2) {
+        auto [ptr, size] = ureader.read(ct);
+        lines = detail::splitFields<5>({ptr, size}, '\n');
+        if (!lines && size < ct) return std::nullopt; // incomplete record at the end of the file
+        ct    = std::max(ct, size);
+        front = ptr;
+    }
+    auto [id, seq, id2, qual, rest] = *lines;
+    if (id2.empty() || id2[0] != '+') {
+        throw std::runtime_error{"invalid fastq record, expected '+' in front of " + std::string{id2.substr(0, 80)}};
+    }
+    lastUsed = static_cast<size_t>(qual.data() + qual.size() - front);
 
     return record_view {
-        .id   = ureader.string_view(0, endId),
-        .seq  = ureader.string_view(startSeq, endSeq),
-        .id2  = ureader.string_view(startId2, endId2),
-        .qual = ureader.string_view(startQual, endQual),
+        .id   = id,
+        .seq  = seq,
+        .id2  = id2.substr(1),
+        .qual = qual,
     };
 }
 
@@ -69,6 +71,23 @@ void reader::close() {
     pimpl_.reset();
 }
 
+auto reader::tell() const -> size_t {
+    assert(pimpl_);
+
+    auto& ureader  = pimpl_->ureader;
+    return ureader.tell() + pimpl_->lastUsed;
+}
+
+void reader::seek(size_t offset) {
+    assert(pimpl_);
+
+    auto& ureader  = pimpl_->ureader;
+
+    ureader.seek(offset);
+    ureader.dropUntil(0);
+    pimpl_->lastUsed = 0;
+}
+
 static_assert(record_reader_c<reader>);
 
 }
@@ -8,8 +8,10 @@
 #include "bcf/writer.h"
 #include "csv/reader.h"
 #include "csv/writer.h"
+#include "fasta/indexed_reader.h"
 #include "fasta/reader.h"
 #include "fasta/writer.h"
+#include "faidx/build.h"
 #include "faidx/reader.h"
 #include "fastq/reader.h"
 #include "sam/reader.h"
@@ -5,6 +5,7 @@
 #include "../detail/file_reader.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
+#include "../detail/structural_index.h"
 #include "../detail/utilities.h"
 #include "../detail/zlib_file_reader.h"
 #include "reader.h"
@@ -23,12 +24,12 @@ struct reader_base<sam::reader>::pimpl {
 
     std::vector<std::string> header;
 
-    pimpl(std::filesystem::path file)
+    pimpl(std::filesystem::path file, mmap_policy policy)
         : ureader {[&]() -> VarBufferedReader {
-            return mmap_reader{file};
+            return mmap_reader{file, policy};
         }()}
     {}
-    pimpl(std::istream& file)
+    pimpl(std::istream& file, mmap_policy)
         : ureader {[&]() -> VarBufferedReader {
             return stream_reader{file};
         }()}
@@ -53,21 +54,14 @@ struct reader_base<sam::reader>::pimpl {
 }
 
 //!WORKAROUND clang crashes if this is a member function of pimpl, see https://github.com/llvm/llvm-project/issues/61159
-template <size_t ct, char sep>
+template <size_t ct, char sep, size_t minCt = ct>
 static auto readLine(ivio::reader_base<ivio::sam::reader>::pimpl& self) -> std::optional<std::array<std::string_view, ct>> {
-    auto res = std::array<std::string_view, ct>{};
-    size_t start{};
-    for (size_t i{}; i < ct-1; ++i) {
-        auto end = self.ureader.readUntil(sep, start);
-        if (self.ureader.eof(end)) return std::nullopt;
-        res[i] = self.ureader.string_view(start, end);
-        start = end+1;
-    }
-    auto end = self.ureader.readUntil('\n', start);
+    auto end = self.ureader.readUntil('\n', 0);
     if (self.ureader.eof(end)) return std::nullopt;
-    res.back() = self.ureader.string_view(start, end);
-    self.lastUsed = end;
-    if (!self.ureader.eof(self.lastUsed)) self.lastUsed += 1;
+    auto line = self.ureader.string_view(0, end);
+    auto res = ivio::detail::splitFields<ct>(line, sep, minCt);
+    if (!res) throw ivio::detail::missingFieldsError("sam", minCt, line);
+    self.lastUsed = end+1;
     return res;
 }
 
@@ -76,7 +70,7 @@ namespace ivio::sam {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(p);
+        return std::make_unique<pimpl>(p, config_.mmapPolicy);
     }, config_.input)}
 {
     pimpl_->readHeader();
@@ -97,7 +91,7 @@ auto reader::next() -> std::optional<record_view> {
     if (ureader.eof(lastUsed)) return std::nullopt;
     ureader.dropUntil(lastUsed);
 
-    auto res = readLine<12, '\t'>(*pimpl_);
+    auto res = readLine<12, '\t', 11>(*pimpl_); // tags are optional
     if (!res) return std::nullopt;
 
     auto [qname, flag, rname, pos, mapq, cigar, rnext, pnext, tlen, seq, qual, tags] = *res;
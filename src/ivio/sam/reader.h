@@ -4,6 +4,7 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/mmap_policy.h"
 #include "../detail/reader_base.h"
 #include "record.h"
 
@@ -22,6 +23,9 @@ struct reader : public reader_base<reader> {
     struct config {
         // Source: file or stream
         std::variant<std::filesystem::path, std::reference_wrapper<std::istream>> input;
+
+        // Access hints for memory mapped files, e.g. mmap_policy::random() for random access (ignored for streams)
+        mmap_policy mmapPolicy{};
     };
 
 public:
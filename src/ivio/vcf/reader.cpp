@@ -1,15 +1,20 @@
 // SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
+#include "../detail/bgzf_seekable_reader.h"
+#include "../detail/bin_index.h"
 #include "../detail/buffered_reader.h"
 #include "../detail/file_reader.h"
+#include "../detail/genomic_region.h"
 #include "../detail/mmap_reader.h"
 #include "../detail/stream_reader.h"
+#include "../detail/structural_index.h"
 #include "../detail/utilities.h"
 #include "../detail/zlib_file_reader.h"
 #include "reader.h"
 
 #include <cassert>
+#include <charconv>
 #include <functional>
 #include <optional>
 #include <ranges>
@@ -18,12 +23,27 @@ namespace ivio {
 
 template <>
 struct reader_base<vcf::reader>::pimpl {
+    vcf::reader::config config;
+
     VarBufferedReader ureader;
     size_t lastUsed{};
 
     std::vector<std::tuple<std::string, std::string>> header;
     std::vector<std::string> genotypes;
 
+    // state of region queries
+    bool                                  seekable{}; // ureader is a bgzf_seekable_reader
+    std::optional<bin_index>              index;
+    std::optional<detail::genomic_region> region;
+    std::vector<bgzf_chunk>               chunks;
+    size_t                                chunkIdx{};
+    bool                                  needSeek{};
+
+    pimpl(vcf::reader::config const& config_, VarBufferedReader ureader_)
+        : config{config_}
+        , ureader{std::move(ureader_)}
+    {}
+
     bool readHeaderLine() {
         auto [buffer, size] = ureader.read(2);
         if (size >= 2 and buffer[0] == '#' and buffer[1] == '#') {
@@ -67,32 +87,125 @@ struct reader_base<vcf::reader>::pimpl {
     #endif
         }
 #endif
-            if (genotypes.size() < 9) {
+            if (genotypes.size() < 8) { // FORMAT and samples are optional
                 throw std::runtime_error("Header description line is invalid");
             }
-            genotypes.erase(begin(genotypes), begin(genotypes)+9);
+            genotypes.erase(begin(genotypes), begin(genotypes)+std::min<size_t>(9, genotypes.size()));
             ureader.dropUntil(end);
             if (!ureader.eof(end)) ureader.dropUntil(1);
         }
     }
+
+    static auto makeSeekableReader(std::filesystem::path const& file, mmap_policy policy) -> VarBufferedReader {
+        if (!is_regular_file(file)) {
+            throw std::runtime_error{"region queries require a regular vcf file, " + file.string() + " is not"};
+        }
+        return bgzf_seekable_reader{mmap_reader{file, policy}};
+    }
+    static auto makeSeekableReader(std::istream& file, mmap_policy) -> VarBufferedReader {
+        return bgzf_seekable_reader{stream_reader{file}};
+    }
+
+    auto findIndex() const -> std::filesystem::path {
+        if (!config.index.empty()) return config.index;
+        if (auto file = std::get_if<std::filesystem::path>(&config.input)) {
+            auto candidates = {std::filesystem::path{file->string() + ".tbi"},
+                               std::filesystem::path{file->string() + ".csi"}};
+            for (auto const& c : candidates) {
+                if (std::filesystem::exists(c)) return c;
+            }
+        }
+        throw std::runtime_error{"no tbi or csi index found, set vcf::reader::config::index"};
+    }
+
+    void setRegion(std::string_view str) {
+        if (!index) {
+            index = bin_index::load(findIndex());
+            if (!index->tabix) {
+                throw std::runtime_error{"index does not list the names of the references"};
+            }
+        }
+        if (!seekable) {
+            ureader  = std::visit([&](auto& p) { return makeSeekableReader(p, config.mmapPolicy); }, config.input);
+            seekable = true;
+        }
+        lastUsed = 0;
+        auto const& names = index->tabix->names;
+        if (std::ranges::find(names, str) != names.end()) { // complete reference, its name might contain ':'
+            region = detail::genomic_region{.name = std::string{str}};
+        } else {
+            region = detail::parseRegion(str);
+        }
+        chunks.clear();
+        if (auto iter = std::ranges::find(names, region->name); iter != names.end()) {
+            chunks = index->query(iter - names.begin(), region->begin, region->end);
+        }
+        chunkIdx = 0;
+        needSeek = true;
+    }
+
+    // end of a record (0-based, exclusive): INFO/END if present (as tabix bins it), otherwise the end of REF
+    static auto recordEnd(int64_t begin, std::string_view ref, std::string_view infos) -> int64_t {
+        for (auto p = infos.find("END="); p != std::string_view::npos; p = infos.find("END=", p+1)) {
+            if (p > 0 && infos[p-1] != ';') continue; // e.g. CIEND
+            auto value = infos.substr(p+4, infos.find(';', p) - (p+4));
+            auto end   = int64_t{};
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), end);
+            if (ec == std::errc{} && end > begin) { // "." and invalid values are ignored
+                return end;
+            }
+            break;
+        }
+        return begin + std::max<int64_t>(ref.size(), 1);
+    }
+
+    /* Next line overlapping the region, only the chunks listed by the index are visited
+     * A record covers its REF allele, or reaches up to INFO/END (e.g. structural variants).
+     */
+    auto nextInRegion() -> std::optional<std::array<std::string_view, 10>> {
+        while (chunkIdx < chunks.size()) {
+            if (needSeek) {
+                ureader.seek(chunks[chunkIdx].begin);
+                lastUsed = 0;
+                needSeek = false;
+            }
+            ureader.dropUntil(lastUsed);
+            lastUsed = 0;
+            auto offset = ureader.tell();
+            if (offset >= chunks[chunkIdx].end) { // continue with the next chunk
+                chunkIdx += 1;
+                needSeek = chunkIdx < chunks.size() && offset < chunks[chunkIdx].begin;
+                continue;
+            }
+            auto end = ureader.readUntil('\n', 0);
+            if (ureader.eof(end)) break;
+            auto line = ureader.string_view(0, end);
+            lastUsed = end+1;
+
+            auto fields = detail::splitFields<10>(line, '\t', 8); // FORMAT and samples are optional
+            if (!fields) throw detail::missingFieldsError("vcf", 8, line);
+            auto [chrom, pos, id, ref, alts, qual, filters, infos, formats, samples] = *fields;
+            auto begin = detail::convertTo<int64_t>(pos) - 1;
+            // the file is sorted, no further records can overlap the region
+            if (chrom != region->name || begin >= region->end) break;
+            if (recordEnd(begin, ref, infos) > region->begin) {
+                return fields;
+            }
+        }
+        chunkIdx = chunks.size();
+        return std::nullopt;
+    }
 };
 }
 //!WORKAROUND clang crashes if this is a member function of pimpl, see https://github.com/llvm/llvm-project/issues/61159
-template <size_t ct, char sep>
+template <size_t ct, char sep, size_t minCt = ct>
 static auto readLine(ivio::reader_base<ivio::vcf::reader>::pimpl& self) -> std::optional<std::array<std::string_view, ct>> {
-    auto res = std::array<std::string_view, ct>{};
-    size_t start{};
-    for (size_t i{}; i < ct-1; ++i) {
-        auto end = self.ureader.readUntil(sep, start);
-        if (self.ureader.eof(end)) return std::nullopt;
-        res[i] = self.ureader.string_view(start, end);
-        start = end+1;
-    }
-    auto end = self.ureader.readUntil('\n', start);
+    auto end = self.ureader.readUntil('\n', 0);
     if (self.ureader.eof(end)) return std::nullopt;
-    res.back() = self.ureader.string_view(start, end);
-    self.lastUsed = end;
-    if (!self.ureader.eof(self.lastUsed)) self.lastUsed += 1;
+    auto line = self.ureader.string_view(0, end);
+    auto res = ivio::detail::splitFields<ct>(line, sep, minCt);
+    if (!res) throw ivio::detail::missingFieldsError("vcf", minCt, line);
+    self.lastUsed = end+1;
     return res;
 }
 
@@ -100,12 +213,15 @@ namespace ivio::vcf {
 
 reader::reader(config const& config_)
     : reader_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(makeZlibReader(p));
+        return std::make_unique<pimpl>(config_, makeZlibReader(p, config_.mmapPolicy, config_.readAhead));
     }, config_.input)}
 {
     pimpl_->readHeader();
     header_.table     = std::move(pimpl_->header);
     header_.genotypes = std::move(pimpl_->genotypes);
+    if (!config_.region.empty()) {
+        pimpl_->setRegion(config_.region);
+    }
 }
 
 
@@ -119,10 +235,14 @@ auto reader::next() -> std::optional<record_view> {
     auto& ureader  = pimpl_->ureader;
     auto& lastUsed = pimpl_->lastUsed;
 
-    if (ureader.eof(lastUsed)) return std::nullopt;
-    ureader.dropUntil(lastUsed);
-
-    auto res = readLine<10, '\t'>(*pimpl_);
+    auto res = std::optional<std::array<std::string_view, 10>>{};
+    if (pimpl_->region) {
+        res = pimpl_->nextInRegion();
+    } else {
+        if (ureader.eof(lastUsed)) return std::nullopt;
+        ureader.dropUntil(lastUsed);
+        res = readLine<10, '\t', 8>(*pimpl_); // FORMAT and samples are optional
+    }
     if (!res) return std::nullopt;
 
     auto [chrom, pos, id, ref, alts, qual, filters, infos, formats, samples] = *res;
@@ -145,6 +265,11 @@ void reader::close() {
     pimpl_.reset();
 }
 
+void reader::region(std::string_view region_) {
+    assert(pimpl_);
+    pimpl_->setRegion(region_);
+}
+
 static_assert(record_reader_c<reader>);
 
 }
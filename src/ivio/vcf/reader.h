@@ -4,12 +4,16 @@
 #pragma once
 
 #include "../detail/concepts.h"
+#include "../detail/io_uring_reader_config.h"
+#include "../detail/mmap_policy.h"
 #include "../detail/reader_base.h"
 #include "header.h"
 #include "record.h"
 
 #include <filesystem>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <variant>
 #include <vector>
@@ -25,6 +29,19 @@ struct reader : public reader_base<reader> {
     struct config {
         // Source: file or stream
         std::variant<std::filesystem::path, std::reference_wrapper<std::istream>> input;
+
+        // Access hints for memory mapped files, e.g. mmap_policy::random() for random access (ignored for streams)
+        mmap_policy mmapPolicy{};
+
+        // Pipes and other files which can not be memory mapped are read ahead asynchronously (io_uring)
+        io_uring_reader_config readAhead{};
+
+        // Only read records overlapping this region, e.g. "chr7", "chr7:140e6" or "chr7:140,000,001-141,000,000"
+        // (1-based, inclusive). Requires a bgzf compressed file and its index, see region()
+        std::string region{};
+
+        // TBI or CSI index, only used for region queries. If empty, "<input>.tbi" and "<input>.csi" are tried
+        std::filesystem::path index{};
     };
 
 public:
@@ -38,6 +55,18 @@ public:
 
     //!doc: see record_reader_c<reader> concept
     void close();
+
+    /**
+     * Restricts reading to records overlapping `region_`, given as "name", "name:begin" or "name:begin-end"
+     *
+     * Positions are 1-based and inclusive, a record covers the positions of its reference allele.
+     * Requires a coordinate sorted, bgzf compressed and seekable vcf file and its TBI or CSI index
+     * (see config::index). Only the bgzf blocks listed by the index for this region are decompressed,
+     * records outside of the region are skipped after looking at their first four columns and reading
+     * stops at the first record behind the region. Afterwards next() returns the records of the region,
+     * followed by std::nullopt. region() can be called repeatedly.
+     */
+    void region(std::string_view region_);
 };
 
 static_assert(record_reader_c<reader>);
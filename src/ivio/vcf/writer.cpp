@@ -3,8 +3,11 @@
 // SPDX-License-Identifier: BSD-3-Clause
 #include "writer.h"
 
+#include "../detail/async_writer.h"
+#include "../detail/bgzf_mt_writer.h"
 #include "../detail/buffered_writer.h"
 #include "../detail/file_writer.h"
+#include "../detail/gzip_mt_writer.h"
 #include "../detail/stream_writer.h"
 #include "../detail/zlib_file_writer.h"
 
@@ -14,30 +17,42 @@
 
 template <>
 struct ivio::writer_base<ivio::vcf::writer>::pimpl {
-    using Writers = std::variant<ivio::file_writer,
-                                 ivio::buffered_writer<ivio::zlib_file_writer>,
-                                 ivio::stream_writer,
-                                 ivio::buffered_writer<ivio::zlib_stream_writer>
-                                 >;
+    using Writers = ivio::async_variant<ivio::file_writer,
+                                        ivio::buffered_writer<ivio::zlib_file_writer>,
+                                        ivio::gzip_mt_file_writer,
+                                        ivio::bgzf_file_writer,
+                                        ivio::bgzf_mt_file_writer,
+                                        ivio::stream_writer,
+                                        ivio::buffered_writer<ivio::zlib_stream_writer>,
+                                        ivio::gzip_mt_stream_writer,
+                                        ivio::bgzf_stream_writer,
+                                        ivio::bgzf_mt_stream_writer
+                                       >;
 
     ivio::vcf::writer::config config;
     Writers writer;
 
-    pimpl(std::filesystem::path output, bool)
+    pimpl(std::filesystem::path output, ivio::vcf::writer::config const& config_)
         : writer {[&]() -> Writers {
+            if (output.extension() == ".bgz" || config_.bgzf) {
+                return makeBgzfWriter<Writers>(file_writer{output, config_.fileConfig}, config_.threadNbr, config_.alignRecords, config_.async);
+            }
             if (output.extension() == ".gz") {
-                return buffered_writer{zlib_file_writer{file_writer{output}}};
+                return makeGzipWriter<Writers>(file_writer{output, config_.fileConfig}, config_.threadNbr, config_.compressionLevel, config_.async);
             }
-            return file_writer{output};
+            return makeAsyncOptional<Writers>(config_.async, file_writer{output, config_.fileConfig});
         }()}
     {}
 
-    pimpl(std::ostream& output, bool compressed)
+    pimpl(std::ostream& output, ivio::vcf::writer::config const& config_)
         : writer {[&]() -> Writers {
-            if (compressed) {
-                return buffered_writer{zlib_stream_writer{stream_writer{output}}};
+            if (config_.bgzf) {
+                return makeBgzfWriter<Writers>(stream_writer{output}, config_.threadNbr, config_.alignRecords, config_.async);
+            }
+            if (config_.compressed) {
+                return makeGzipWriter<Writers>(stream_writer{output}, config_.threadNbr, config_.compressionLevel, config_.async);
             }
-            return stream_writer{output};
+            return makeAsyncOptional<Writers>(config_.async, stream_writer{output});
         }()}
     {}
 };
@@ -46,7 +61,7 @@ namespace ivio::vcf {
 
 writer::writer(config config_)
     : writer_base{std::visit([&](auto& p) {
-        return std::make_unique<pimpl>(p, config_.compressed);
+        return std::make_unique<pimpl>(p, config_);
     }, config_.output)}
 {
     // write header
@@ -123,6 +138,11 @@ void writer::write(record_view record) {
 }
 
 void writer::close() {
+    if (!pimpl_) return;
+    // closing explicitly, errors of the background thread are thrown here and not in a destructor
+    std::visit([](auto& writer) {
+        writer.close();
+    }, pimpl_->writer);
     pimpl_.reset();
 }
 
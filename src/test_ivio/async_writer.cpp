@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/detail/async_writer.h>
+#include <ivio/detail/file_writer.h>
+#include <stdexcept>
+
+namespace {
+auto readFile(std::filesystem::path const& path) -> std::string {
+    auto ifs = std::ifstream{path, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{ifs}, {}};
+}
+
+// fails after `limit` bytes were written
+struct failing_writer {
+    size_t limit;
+    size_t written{};
+
+    auto write(std::span<char const> data) -> size_t {
+        written += data.size();
+        if (written > limit) {
+            throw std::runtime_error{"disk full"};
+        }
+        return data.size();
+    }
+    void close() {}
+};
+}
+
+TEST_CASE("writing files with async_writer", "[async][writer]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "async_writer.txt";
+
+    auto data = std::string{};
+    for (size_t i{0}; data.size() < 1'000'000; ++i) {
+        data += "line " + std::to_string(i) + "\n";
+    }
+
+    auto bufferSize = GENERATE(size_t{1}, size_t{10'000}, size_t{1<<20});
+    auto queueSize  = GENERATE(size_t{1}, size_t{4});
+    auto chunkSize  = GENERATE(size_t{1'000}, size_t{700'000});
+    INFO("buffer size " << bufferSize << ", queue size " << queueSize << ", chunk size " << chunkSize);
+
+    {
+        auto writer = ivio::async_writer{ivio::file_writer{path}, bufferSize, queueSize};
+        size_t written{};
+        for (size_t i{0}; i < data.size(); i += chunkSize) {
+            written += writer.write(std::string_view{data}.substr(i, chunkSize));
+        }
+        writer.close();
+        CHECK(written == data.size());
+    }
+    CHECK(readFile(path) == data);
+}
+
+TEST_CASE("async_writer closes on destruction", "[async][writer]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "async_writer_dtor.txt";
+    {
+        auto writer = ivio::async_writer{ivio::file_writer{path}, 100};
+        writer.write(std::string_view{"some"});
+        auto moved = std::move(writer);
+        moved.write(std::string_view{" data\n"});
+    }
+    CHECK(readFile(path) == "some data\n");
+}
+
+TEST_CASE("async_writer reports errors of the background thread", "[async][writer]") {
+    auto writer = ivio::async_writer{failing_writer{.limit = 1'000}, 100, 2};
+    auto line = std::string(10, 'x');
+    CHECK_THROWS_AS([&]() {
+        for (size_t i{0}; i < 1'000; ++i) {
+            writer.write(line);
+        }
+        writer.close();
+    }(), std::runtime_error);
+    CHECK_NOTHROW(writer.close());
+}
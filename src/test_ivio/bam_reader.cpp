@@ -1,10 +1,19 @@
 // SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
+#include "utilities.h"
+
 #include <catch2/catch_all.hpp>
 #include <filesystem>
 #include <fstream>
 #include <ivio/ivio.h>
+#include <thread>
+
+#if (defined(unix) || defined(__unix__) || defined(__unix)) && !defined(__EMSCRIPTEN__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
 
 TEST_CASE("reading bam files", "[bam][reader]") {
     auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
@@ -240,3 +249,280 @@ TEST_CASE("reading bam files", "[bam][reader]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+namespace {
+struct TestRecord {
+    int32_t     refID;
+    int32_t     pos;
+    int32_t     refLen; // covered bases on the reference
+    std::string name;
+    uint64_t    voffset{};
+    uint64_t    voffsetEnd{};
+};
+
+/* Creates a coordinate sorted bam file and its BAI and CSI index
+ * Records of two references with short and long alignments, followed by unmapped records.
+ */
+auto createIndexedBam(std::filesystem::path const& path) -> std::vector<TestRecord> {
+    auto records = std::vector<TestRecord>{};
+    for (int32_t ref{0}; ref < 2; ++ref) {
+        for (int32_t i{0}, pos{0}; i < 3'000; ++i) {
+            pos += (i * 7919) % 300;
+            auto refLen = (i % 97 == 0) ? 40'000 : 50 + (i * 31) % 100; // some span many bins
+            records.push_back({ref, pos, refLen, "r" + std::to_string(ref) + "_" + std::to_string(i)});
+        }
+    }
+    for (int32_t i{0}; i < 10; ++i) {
+        records.push_back({-1, -1, 0, "unmapped_" + std::to_string(i)});
+    }
+
+    // uncompressed bam data
+    auto data = std::string{"BAM\1"};
+    auto text = std::string{"@HD\tVN:1.6\tSO:coordinate\n@SQ\tSN:chr1\tLN:1000000\n@SQ\tSN:chr2\tLN:1000000\n"};
+    append<int32_t>(data, text.size());
+    data += text;
+    append<int32_t>(data, 2);
+    for (auto name : {"chr1", "chr2"}) {
+        append<int32_t>(data, 5);
+        data += name;
+        data += '\0';
+        append<int32_t>(data, 1'000'000);
+    }
+    auto recordStart = std::vector<size_t>{};
+    for (auto const& r : records) {
+        recordStart.push_back(data.size());
+        auto rec = std::string{};
+        auto nCigar = (r.refID >= 0) ? 1 : 0;
+        append<int32_t>(rec, r.refID);
+        append<int32_t>(rec, r.pos);
+        append<uint8_t>(rec, r.name.size() + 1);
+        append<uint8_t>(rec, 60);
+        append<uint16_t>(rec, (r.refID >= 0) ? reg2bin(r.pos, r.pos + r.refLen) : 4680);
+        append<uint16_t>(rec, nCigar);
+        append<uint16_t>(rec, (r.refID >= 0) ? 0 : 4);
+        append<uint32_t>(rec, 4);  // l_seq
+        append<int32_t>(rec, -1);  // next_refID
+        append<int32_t>(rec, -1);  // next_pos
+        append<int32_t>(rec, 0);   // tlen
+        rec += r.name;
+        rec += '\0';
+        if (nCigar) {
+            append<uint32_t>(rec, static_cast<uint32_t>(r.refLen) << 4); // <refLen>M
+        }
+        rec += std::string{"\x12\x48", 2};   // ACGT
+        rec += std::string(4, '\x1e');
+        append<int32_t>(data, rec.size());
+        data += rec;
+    }
+
+    // bgzf compress, small blocks so each query touches only few of them
+    auto constexpr blockSize = 5'000;
+    auto bam = std::string{};
+    auto blockOffsets = compressBgzf(data, blockSize, bam);
+    auto voffset = [&](size_t p) -> uint64_t {
+        if (p == data.size()) return uint64_t{bam.size() - ivio::bgzf_writer::detail::eof_marker.size()} << 16;
+        return (uint64_t{blockOffsets[p / blockSize]} << 16) | (p % blockSize);
+    };
+    for (size_t i{0}; i < records.size(); ++i) {
+        records[i].voffset    = voffset(recordStart[i]);
+        records[i].voffsetEnd = voffset(i+1 < records.size() ? recordStart[i+1] : data.size());
+    }
+    {
+        auto ofs = std::ofstream{path, std::ios::binary};
+        ofs << bam;
+    }
+
+    auto indexed = std::vector<IndexedRecord>{};
+    for (auto const& r : records) {
+        if (r.refID < 0) continue;
+        indexed.push_back({r.refID, r.pos, r.pos + r.refLen, r.voffset, r.voffsetEnd});
+    }
+    for (auto format : {"BAI", "CSI"}) {
+        auto idx = createBinIndex(indexed, format, {"chr1", "chr2"}, /*.unplacedCount=*/10);
+        auto ofs = std::ofstream{path.string() + (format == std::string_view{"CSI"} ? ".csi" : ".bai"), std::ios::binary};
+        ofs << idx;
+    }
+    return records;
+}
+
+auto expectedInRegion(std::vector<TestRecord> const& records, int32_t refID, int32_t begin, int32_t end) -> std::vector<std::string> {
+    auto res = std::vector<std::string>{};
+    for (auto const& r : records) {
+        if (begin < end && r.refID == refID && r.pos < end && r.pos + std::max(r.refLen, 1) > begin) {
+            res.push_back(r.name);
+        }
+    }
+    return res;
+}
+
+auto readRegion(ivio::bam::reader& reader, int32_t refID, int32_t begin, int32_t end) -> std::vector<std::string> {
+    reader.region(refID, begin, end);
+    auto res = std::vector<std::string>{};
+    for (auto r : reader) {
+        res.emplace_back(r.read_name);
+    }
+    return res;
+}
+}
+
+TEST_CASE("reading regions of indexed bam files", "[bam][reader][index]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path    = tmp / "indexed.bam";
+    auto records = createIndexedBam(path);
+
+    auto regions = std::vector<std::tuple<int32_t, int32_t, int32_t>>{
+        {0, 0, 1},              // first record
+        {0, 10'000, 10'500},
+        {0, 100'000, 100'001},  // single position
+        {0, 55'000, 200'000},   // many blocks
+        {1, 0, 1'000},          // second reference
+        {1, 400'000, 400'010},
+        {0, 300'000, 300'000},  // empty region
+        {0, 5'000'000, 6'000'000}, // behind all records
+        {2, 0, 1'000},          // unknown reference
+        {0, 0, 1'000'000},      // complete reference
+    };
+
+    auto indexFile = GENERATE(std::string{}, std::string{".csi"});
+    INFO("index " << indexFile);
+    auto config = ivio::bam::reader::config{.input = path};
+    if (!indexFile.empty()) {
+        config.index = path.string() + indexFile;
+    }
+
+    SECTION("regions match a full scan") {
+        auto reader = ivio::bam::reader{config};
+        for (auto [refID, begin, end] : regions) {
+            INFO("region " << refID << ":" << begin << "-" << end);
+            CHECK(readRegion(reader, refID, begin, end) == expectedInRegion(records, refID, begin, end));
+        }
+        // jumping backwards
+        CHECK(readRegion(reader, 0, 10'000, 10'500) == expectedInRegion(records, 0, 10'000, 10'500));
+    }
+
+    SECTION("region after reading some records with multiple threads") {
+        config.threadNbr = 2;
+        auto reader = ivio::bam::reader{config};
+        for (size_t i{0}; i < 100; ++i) {
+            REQUIRE(reader.next());
+        }
+        CHECK(readRegion(reader, 1, 100'000, 120'000) == expectedInRegion(records, 1, 100'000, 120'000));
+    }
+
+    SECTION("regions of a stream") {
+        config.index = path.string() + (indexFile.empty() ? ".bai" : indexFile);
+        auto ifs = std::ifstream{path, std::ios::binary};
+        config.input = ifs;
+        auto reader = ivio::bam::reader{config};
+        CHECK(readRegion(reader, 0, 55'000, 200'000) == expectedInRegion(records, 0, 55'000, 200'000));
+        CHECK(readRegion(reader, 0, 0, 1) == expectedInRegion(records, 0, 0, 1));
+    }
+}
+
+TEST_CASE("bam region without index", "[bam][reader][index]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "not_indexed.bam";
+    createIndexedBam(path);
+    std::filesystem::remove(path.string() + ".bai");
+    std::filesystem::remove(path.string() + ".csi");
+    auto reader = ivio::bam::reader{{.input = path}};
+    CHECK_THROWS(reader.region(0, 0, 100));
+}
+
+TEST_CASE("bam region of a pipe", "[bam][reader][index]") {
+#if (defined(unix) || defined(__unix__) || defined(__unix)) && !defined(__EMSCRIPTEN__)
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path    = tmp / "piped.bam";
+    auto records = createIndexedBam(path);
+    auto fifo    = tmp / "fifo_file.bam";
+    std::filesystem::remove(fifo);
+    mkfifo(fifo.c_str(), O_CREAT | O_RDWR | S_IRWXU);
+    auto t = std::thread{[&]() {
+        auto ifs = std::ifstream{path, std::ios::binary};
+        auto ofs = std::ofstream{fifo, std::ios::binary};
+        ofs << ifs.rdbuf();
+    }};
+    auto reader = ivio::bam::reader{{.input = fifo, .index = path.string() + ".bai"}};
+    CHECK_THROWS(reader.region(0, 0, 100)); // pipes can not seek
+    size_t ct{};
+    for ([[maybe_unused]] auto r : reader) {
+        ++ct;
+    }
+    t.join();
+    CHECK(ct == records.size());
+    CHECK_THROWS(reader.seek(0));
+#else
+    SKIP();
+#endif
+}
+
+TEST_CASE("tell and seek in bam files", "[bam][reader][seek]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path    = tmp / "seekable.bam";
+    auto records = createIndexedBam(path);
+
+    auto threadNbr = GENERATE(size_t{0}, size_t{2});
+    auto policy    = GENERATE(ivio::mmap_policy{}, ivio::mmap_policy{.readAhead = 1<<16, .dropBehind = true});
+    INFO("threadNbr " << threadNbr << ", dropBehind " << policy.dropBehind);
+    auto reader = ivio::bam::reader{{.input = path, .threadNbr = threadNbr, .mmapPolicy = policy}};
+
+    SECTION("virtual offsets of a full scan") {
+        for (auto const& r : records) {
+            CHECK(reader.tell() == r.voffset);
+            auto rec = reader.next();
+            REQUIRE(rec);
+            CHECK(rec->read_name == r.name);
+        }
+        CHECK(!reader.next());
+    }
+
+    SECTION("the last record stays valid after tell()") {
+        for (size_t i{0}; i < records.size(); ++i) {
+            auto rec = reader.next();
+            REQUIRE(rec);
+            reader.tell();
+            CHECK(rec->read_name == records[i].name);
+        }
+    }
+
+    SECTION("seeking to records") {
+        for (size_t i{0}; i < 300; ++i) {
+            auto idx = (i * 7'919) % records.size();
+            reader.seek(records[idx].voffset);
+            for (size_t j{idx}; j < std::min(idx + 3, records.size()); ++j) {
+                auto rec = reader.next();
+                REQUIRE(rec);
+                CHECK(rec->read_name == records[j].name);
+            }
+        }
+        // behind the last record and back to the first one
+        reader.seek(records.back().voffsetEnd);
+        CHECK(!reader.next());
+        reader.seek(records.front().voffset);
+        REQUIRE(reader.next());
+        CHECK(reader.tell() == records[1].voffset);
+    }
+
+    SECTION("seek ends a region") {
+        reader.region(0, 10'000, 10'500);
+        REQUIRE(reader.next());
+        reader.seek(records[5'000].voffset);
+        auto rec = reader.next();
+        REQUIRE(rec);
+        CHECK(rec->read_name == records[5'000].name);
+    }
+
+    SECTION("seeking in a stream") {
+        auto ifs    = std::ifstream{path, std::ios::binary};
+        auto reader = ivio::bam::reader{{.input = ifs, .threadNbr = threadNbr}};
+        reader.seek(records[4'321].voffset);
+        auto rec = reader.next();
+        REQUIRE(rec);
+        CHECK(rec->read_name == records[4'321].name);
+        CHECK(reader.tell() == records[4'322].voffset);
+    }
+}
@@ -4,6 +4,7 @@
 #include <catch2/catch_all.hpp>
 #include <filesystem>
 #include <fstream>
+#include <ivio/detail/bin_index.h>
 #include <ivio/ivio.h>
 
 TEST_CASE("reading bcf files", "[bcf][reader]") {
@@ -210,3 +211,72 @@ TEST_CASE("reading bcf files", "[bcf][reader]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("tell and seek in bcf files", "[bcf][reader][seek]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "seekable.bcf";
+
+    auto header = ivio::bcf::header {
+        .table = {
+            {R"(fileformat)", R"(VCFv4.3)"},
+            {R"(FILTER)", R"(<ID=PASS,Description="All filters passed",IDX=0>)"},
+            {R"(contig)", R"(<ID=chr1,length=10000000,IDX=0>)"},
+            {R"(contig)", R"(<ID=chr2,length=10000000,IDX=1>)"},
+        },
+        .genotypes = {"S1"},
+    };
+    auto expected = std::vector<ivio::bcf::record>{};
+    for (int32_t chromId : {0, 1}) {
+        for (int32_t i{0}; i < 10'000; ++i) {
+            expected.push_back(ivio::bcf::record{.chromId = chromId, .pos = i * 10, .rlen = 1, .qual = 50.f, .n_info = 0, .n_allele = 2, .n_sample = 0, .n_fmt = 0,
+                                                 .id = "v" + std::to_string(i), .ref = "A", .alt = {23, 67}, .filter = {17, 0}, .info = {}, .format = {}});
+        }
+    }
+    {
+        auto writer = ivio::bcf::writer{{.output = path, .header = header, .writeIndex = true}};
+        for (auto const& r : expected) {
+            writer.write(r);
+        }
+        writer.close();
+    }
+
+    // virtual offsets of all records, the same with and without threads
+    auto offsets = std::vector<size_t>{};
+    for (size_t threadNbr : {0, 2}) {
+        INFO("threadNbr " << threadNbr);
+        auto reader = ivio::bcf::reader{{.input = path, .threadNbr = threadNbr}};
+        auto tells  = std::vector<size_t>{};
+        for (auto const& e : expected) {
+            tells.push_back(reader.tell());
+            auto r = reader.next();
+            REQUIRE(r);
+            CHECK(ivio::bcf::record(*r) == e);
+        }
+        CHECK(!reader.next());
+        if (offsets.empty()) offsets = tells;
+        CHECK(tells == offsets);
+    }
+    REQUIRE(std::ranges::is_sorted(offsets));
+
+    // the index created by the writer agrees on the first record of chr2
+    auto index = ivio::bin_index::load(path.string() + ".csi");
+    REQUIRE(index.references.size() == 2);
+    REQUIRE(index.references[1].meta);
+    CHECK(index.references[1].meta->begin == offsets[10'000]);
+
+    for (size_t threadNbr : {0, 2}) {
+        INFO("threadNbr " << threadNbr);
+        auto reader = ivio::bcf::reader{{.input = path, .threadNbr = threadNbr}};
+        for (size_t i{0}; i < 200; ++i) {
+            auto idx = (i * 7'919) % expected.size();
+            reader.seek(offsets[idx]);
+            auto r = reader.next();
+            REQUIRE(r);
+            CHECK(ivio::bcf::record(*r) == expected[idx]);
+            if (idx + 1 < offsets.size()) {
+                CHECK(reader.tell() == offsets[idx+1]);
+            }
+        }
+    }
+}
@@ -0,0 +1,245 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include "utilities.h"
+
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/detail/bgzf_seekable_reader.h>
+#include <ivio/detail/bin_index.h>
+#include <ivio/detail/mmap_reader.h>
+#include <ivio/ivio.h>
+
+TEST_CASE("writing bcf files", "[bcf][writer]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    auto records = std::vector<ivio::bcf::record> {
+        ivio::bcf::record{.chromId = 0, .pos =   14369, .rlen = 1, .qual = 29.f, .n_info = 5, .n_allele = 2, .n_sample = 3, .n_fmt = 4, .id = "rs6054257", .ref = "G",   .alt = {23, 65},                     .filter = {17, 0}, .info = {17,  1, 17,  3, 17,  2, 17, 14, 17,  3, 21,  0, 0, 0, 63, 17,  5,  0, 17,  6,  0},                             .format = {17,  9, 33,  2,  3,  4,  3,  4,  4, 17, 10, 17, 48, 48, 43, 17,  2, 17,  1,  8,  5, 17, 11, 33, 51, 51, 51, 51, 128, 128}},
+        ivio::bcf::record{.chromId = 0, .pos =   17329, .rlen = 1, .qual =  3.f, .n_info = 3, .n_allele = 2, .n_sample = 3, .n_fmt = 4, .id = "",          .ref = "T",   .alt = {23, 65},                     .filter = {17, 7}, .info = {17,  1, 17,  3, 17,  2, 17, 11, 17,  3, 21, 150, 67, 139, 60},                                                 .format = {17,  9, 33,  2,  3,  2,  5,  2,  2, 17, 10, 17, 49,  3, 41, 17,  2, 17,  3,  5,  3, 17, 11, 33, 58, 50, 65,  3, 128, 129}},
+        ivio::bcf::record{.chromId = 0, .pos = 1110695, .rlen = 1, .qual = 67.f, .n_info = 5, .n_allele = 3, .n_sample = 3, .n_fmt = 4, .id = "rs6040355", .ref = "A",   .alt = {23, 71, 23, 84},             .filter = {17, 0}, .info = {17,  1, 17,  2, 17,  2, 17, 10, 17,  3, 37, 250, 126, 170, 62, 131, 192, 42, 63, 17,  4, 23,  84, 17,  5,  0}, .format = {17,  9, 33,  4,  7,  6,  5,  6,  6, 17, 10, 17, 21,  2, 35, 17,  2, 17,  6,  0,  4, 17, 11, 33, 23, 27, 18,  2, 128, 129}},
+        ivio::bcf::record{.chromId = 0, .pos = 1230236, .rlen = 1, .qual = 47.f, .n_info = 3, .n_allele = 1, .n_sample = 3, .n_fmt = 4, .id = "",          .ref = "T",   .alt = {},                           .filter = {17, 0}, .info = {17,  1, 17,  3, 17,  2, 17, 13, 17,  4, 23, 84},                                                               .format = {17,  9, 33,  2,  3,  2,  3,  2,  2, 17, 10, 17, 54, 48, 61, 17,  2, 17,  7,  4,  2, 17, 11, 33, 56, 60, 51, 51, 128, 129}},
+        ivio::bcf::record{.chromId = 0, .pos = 1234566, .rlen = 3, .qual = 50.f, .n_info = 3, .n_allele = 3, .n_sample = 3, .n_fmt = 3, .id = "microsat1", .ref = "GTC", .alt = {23, 71, 71, 71, 84, 67, 84}, .filter = {17, 0}, .info = {17,  1, 17,  3, 17,  2, 17,  9, 17,  4, 23, 71},                                                               .format = {17,  9, 33,  2,  4,  2,  6,  4,  4, 17, 10, 17, 35, 17, 40, 17,  2, 17,  4,  2,  3}},
+    };
+
+    auto header = ivio::bcf::header {
+        .table = {
+            {R"(fileformat)", R"(VCFv4.3)"},
+            {R"(FILTER)", R"(<ID=PASS,Description="All filters passed",IDX=0>)"},
+            {R"(contig)", R"(<ID=20,length=62435964,assembly=B36,md5=f126cdf8a6e0c7f379d618ff66beb2da,species="Homo sapiens",taxonomy=x,IDX=0>)"},
+        },
+        .genotypes = {"NA00001", "NA00002", "NA00003"},
+    };
+
+    // enough records to span multiple bgzf blocks
+    auto expected = std::vector<ivio::bcf::record>{};
+    for (size_t i{0}; i < 5'000; ++i) {
+        for (auto r : records) {
+            r.pos += static_cast<int32_t>(i);
+            expected.push_back(r);
+        }
+    }
+
+    SECTION("Write to std::filesystem::path") {
+        {
+            auto writer = ivio::bcf::writer{{.output = tmp / "file.bcf", .header = header}};
+            for (auto const& r : expected) {
+                writer.write(r);
+            }
+        }
+        auto reader = ivio::bcf::reader{{tmp / "file.bcf"}};
+        CHECK(reader.header().table == header.table);
+        CHECK(reader.header().genotypes == header.genotypes);
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(vec == expected);
+    }
+
+    SECTION("Write to std::filesystem::path with multiple threads") {
+        {
+            auto writer = ivio::bcf::writer{{.output = tmp / "file.bcf", .header = header}};
+            for (auto const& r : expected) {
+                writer.write(r);
+            }
+        }
+        {
+            auto writer = ivio::bcf::writer{{.output = tmp / "file_mt.bcf", .header = header, .threadNbr = 4}};
+            for (auto const& r : expected) {
+                writer.write(r);
+            }
+        }
+        // compression is deterministic, output must be identical
+        CHECK(read_file(tmp / "file.bcf") == read_file(tmp / "file_mt.bcf"));
+
+        // records cross many block boundaries
+        auto reader = ivio::bcf::reader{{.input = tmp / "file_mt.bcf", .threadNbr = 3}};
+        CHECK(reader.header().table == header.table);
+        CHECK(reader.header().genotypes == header.genotypes);
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(vec == expected);
+
+        auto ifs = std::ifstream{tmp / "file_mt.bcf", std::ios::binary};
+        auto stream_reader = ivio::bcf::reader{{.input = ifs, .threadNbr = 3}};
+        auto stream_vec = std::vector(begin(stream_reader), end(stream_reader));
+        CHECK(stream_vec == expected);
+    }
+
+    SECTION("Write to std::filesystem::path with a background writer") {
+        {
+            auto writer = ivio::bcf::writer{{.output = tmp / "file.bcf", .header = header}};
+            for (auto const& r : expected) {
+                writer.write(r);
+            }
+        }
+        for (auto threadNbr : {size_t{0}, size_t{2}}) {
+            auto writer = ivio::bcf::writer{{.output = tmp / "file_async.bcf", .header = header, .threadNbr = threadNbr, .async = true}};
+            for (auto const& r : expected) {
+                writer.write(r);
+            }
+            writer.close();
+            CHECK(read_file(tmp / "file.bcf") == read_file(tmp / "file_async.bcf"));
+        }
+    }
+
+    SECTION("cleanup - deleting temp folder") {
+        std::filesystem::remove_all(tmp);
+    }
+}
+
+namespace {
+struct WrittenRecord {
+    int32_t  chromId;
+    int32_t  pos;
+    int32_t  rlen;
+    uint64_t voffset;
+    uint64_t voffsetEnd;
+};
+
+// lists the records of a bcf file with their virtual offsets
+auto scanBcf(std::filesystem::path const& path) -> std::vector<WrittenRecord> {
+    auto reader = ivio::bgzf_seekable_reader{ivio::mmap_reader{path}};
+    auto [ptr, size] = reader.read(9);
+    REQUIRE(size >= 9);
+    reader.dropUntil(9 + ivio::bgzfUnpack<uint32_t>(ptr + 5));
+    auto res = std::vector<WrittenRecord>{};
+    while (true) {
+        auto voffset = reader.tell();
+        std::tie(ptr, size) = reader.read(20);
+        if (size == 0) break;
+        REQUIRE(size >= 20);
+        auto len = 8 + ivio::bgzfUnpack<uint32_t>(ptr) + ivio::bgzfUnpack<uint32_t>(ptr + 4);
+        auto r = WrittenRecord{ivio::bgzfUnpack<int32_t>(ptr + 8), ivio::bgzfUnpack<int32_t>(ptr + 12), ivio::bgzfUnpack<int32_t>(ptr + 16), voffset, 0};
+        std::tie(ptr, size) = reader.read(len);
+        REQUIRE(size >= len);
+        reader.dropUntil(len);
+        r.voffsetEnd = reader.tell();
+        res.push_back(r);
+    }
+    return res;
+}
+}
+
+TEST_CASE("writing indexed bcf files", "[bcf][writer][index]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    auto header = ivio::bcf::header {
+        .table = {
+            {R"(fileformat)", R"(VCFv4.3)"},
+            {R"(FILTER)", R"(<ID=PASS,Description="All filters passed",IDX=0>)"},
+            {R"(contig)", R"(<ID=chr1,length=10000000,IDX=0>)"},
+            {R"(contig)", R"(<ID=chr2,length=10000000,IDX=1>)"},
+            {R"(contig)", R"(<ID=chr3,length=10000000,IDX=2>)"},
+        },
+        .genotypes = {"S1"},
+    };
+
+    // sorted records of chr1 and chr3, some are long deletions spanning many bins
+    auto expected = std::vector<ivio::bcf::record>{};
+    for (int32_t chromId : {0, 2}) {
+        for (int32_t i{0}, pos{0}; i < 20'000; ++i) {
+            pos += (i * 7919) % 300;
+            auto rlen = (i % 997 == 0) ? 40'000 : 1 + (i % 3);
+            expected.push_back(ivio::bcf::record{.chromId = chromId, .pos = pos, .rlen = rlen, .qual = 50.f, .n_info = 0, .n_allele = 2, .n_sample = 0, .n_fmt = 0,
+                                                 .id = "v" + std::to_string(i), .ref = std::string(std::min(rlen, 10), 'A'), .alt = {23, 67}, .filter = {17, 0}, .info = {}, .format = {}});
+        }
+    }
+
+    auto threadNbr = GENERATE(size_t{0}, size_t{2});
+    auto async     = GENERATE(false, true);
+    INFO("threadNbr " << threadNbr << " async " << async);
+    auto path = tmp / "indexed.bcf";
+    {
+        auto writer = ivio::bcf::writer{{.output = path, .header = header, .threadNbr = threadNbr, .async = async, .writeIndex = true}};
+        for (auto const& r : expected) {
+            writer.write(r);
+        }
+        writer.close();
+    }
+
+    // the file itself is not affected by indexing
+    auto reader = ivio::bcf::reader{{path}};
+    CHECK(std::vector(begin(reader), end(reader)) == expected);
+
+    auto written = scanBcf(path);
+    REQUIRE(written.size() == expected.size());
+    auto index = ivio::bin_index::load(path.string() + ".csi");
+    CHECK(index.minShift == 14);
+    CHECK(index.depth == 5);
+    REQUIRE(index.references.size() == 3);
+    CHECK(index.unplacedCount == 0);
+    CHECK(!index.references[1].meta);
+    REQUIRE(index.references[2].meta);
+    CHECK(index.references[2].meta->mapped == 20'000);
+    CHECK(index.references[2].meta->begin == written[20'000].voffset);
+    CHECK(index.references[2].meta->end == written.back().voffsetEnd);
+
+    auto regions = std::vector<std::tuple<int32_t, int32_t, int32_t>>{
+        {0, 0, 1},
+        {0, 10'000, 10'500},
+        {0, 1'000'000, 1'000'001},
+        {0, 550'000, 2'000'000},
+        {1, 0, 1'000'000},       // no records
+        {2, 0, 1'000},
+        {2, 2'900'000, 3'100'000},
+        {2, 0, 10'000'000},
+    };
+    for (auto [chromId, begin, end] : regions) {
+        INFO("region " << chromId << ":" << begin << "-" << end);
+        auto chunks = index.query(chromId, begin, end);
+        // chunks start and end at record boundaries
+        for (auto const& c : chunks) {
+            CHECK(std::ranges::find(written, c.begin, &WrittenRecord::voffset) != written.end());
+            CHECK(std::ranges::find(written, c.end, &WrittenRecord::voffsetEnd) != written.end());
+        }
+        // each overlapping record is covered by a chunk, records far away are not
+        size_t covered{};
+        for (auto const& r : written) {
+            auto inChunk = std::ranges::any_of(chunks, [&](auto const& c) { return c.begin <= r.voffset && r.voffsetEnd <= c.end; });
+            covered += inChunk ? 1 : 0;
+            if (r.chromId == chromId && r.pos < end && r.pos + std::max(r.rlen, 1) > begin) {
+                CHECK(inChunk);
+            }
+        }
+        if (end - begin < 10'000) {
+            CHECK(covered < written.size() / 10);
+        }
+    }
+
+    SECTION("the index is only written by an explicit close()") {
+        std::filesystem::remove(tmp / "unclosed.bcf.csi");
+        {
+            auto writer = ivio::bcf::writer{{.output = tmp / "unclosed.bcf", .header = header, .writeIndex = true}};
+            writer.write(expected[0]);
+        }
+        CHECK(!std::filesystem::exists(tmp / "unclosed.bcf.csi"));
+        auto reader = ivio::bcf::reader{{tmp / "unclosed.bcf"}};
+        CHECK(std::vector(begin(reader), end(reader)) == std::vector{expected[0]});
+    }
+
+    SECTION("unsorted records can not be indexed") {
+        auto writer = ivio::bcf::writer{{.output = tmp / "unsorted.bcf", .header = header, .writeIndex = true}};
+        writer.write(expected[10]);
+        CHECK_THROWS(writer.write(expected[9]));
+    }
+}
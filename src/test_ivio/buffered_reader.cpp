@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <cstring>
+#include <ivio/detail/buffered_reader.h>
+#include <ivio/detail/zlib_mmap2_reader.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+namespace {
+// returns data in pieces of at most `step` bytes
+struct piecewise_reader {
+    std::string_view data;
+    size_t step;
+
+    size_t read(std::ranges::contiguous_range auto&& range) {
+        auto n = std::min({data.size(), step, range.size()});
+        std::memcpy(range.data(), data.data(), n);
+        data = data.substr(n);
+        return n;
+    }
+};
+
+auto generateLines(size_t count, size_t longLine) -> std::string {
+    auto s = std::string{};
+    for (size_t i{0}; i < count; ++i) {
+        auto len = (i == longLine) ? size_t{1'000'000} : (i * 7919) % 500;
+        s += std::string(len, static_cast<char>('a' + i % 26)) + "\n";
+    }
+    return s;
+}
+}
+
+TEST_CASE("buffered_reader keeps windows contiguous", "[buffered_reader]") {
+    auto longLine = GENERATE(size_t{5'000}, size_t{100'000}); // 100'000: no long line
+    auto step     = GENERATE(size_t{1}, size_t{1'000}, size_t{100'000});
+    auto data     = generateLines(20'000, longLine);
+
+    INFO("long line " << longLine << ", step " << step);
+    auto reader = ivio::buffered_reader<piecewise_reader>{piecewise_reader{data, step}};
+
+    auto result = std::string{};
+    while (true) {
+        auto pos = reader.readUntil('\n', 0);
+        if (reader.eof(pos)) {
+            break;
+        }
+        result += reader.string_view(0, pos + 1);
+        reader.dropUntil(pos + 1);
+    }
+    CHECK(result == data);
+}
+
+TEST_CASE("buffered_reader read with explicit sizes", "[buffered_reader]") {
+    auto data = generateLines(5'000, 0);
+    auto reader = ivio::buffered_reader<piecewise_reader>{piecewise_reader{data, 777}};
+
+    auto offset = size_t{0};
+    for (size_t i{0}; offset < data.size(); ++i) {
+        auto ct = (i * 104'729) % 200'000;
+        auto [ptr, size] = reader.read(ct);
+        REQUIRE(size >= std::min(ct, data.size() - offset));
+        REQUIRE(std::string_view{ptr, size} == std::string_view{data}.substr(offset, size));
+        auto drop = std::min(size, ct / 2 + 1);
+        reader.dropUntil(drop);
+        offset += drop;
+    }
+    CHECK(std::get<1>(reader.read(1)) == 0);
+}
+
+#ifdef __linux__
+TEST_CASE("buffered_reader without double mapped memory", "[buffered_reader]") {
+    // no file descriptors left, memfd_create fails
+    struct fd_limit {
+        rlimit old;
+        fd_limit() {
+            getrlimit(RLIMIT_NOFILE, &old);
+            auto l = old;
+            l.rlim_cur = 0;
+            setrlimit(RLIMIT_NOFILE, &l);
+        }
+        ~fd_limit() {
+            setrlimit(RLIMIT_NOFILE, &old);
+        }
+    };
+
+    auto data = generateLines(20'000, 5'000);
+    auto readAll = [&](auto& reader) {
+        auto result = std::string{};
+        while (true) {
+            auto pos = reader.readUntil('\n', 0);
+            if (reader.eof(pos)) {
+                break;
+            }
+            result += reader.string_view(0, pos + 1);
+            reader.dropUntil(pos + 1);
+        }
+        return result;
+    };
+
+    SECTION("from the start") {
+        auto result = std::string{};
+        {
+            auto limit  = fd_limit{};
+            auto reader = ivio::buffered_reader<piecewise_reader>{piecewise_reader{data, 1'000}};
+            result = readAll(reader);
+        }
+        CHECK(result == data);
+    }
+    SECTION("when the ring has to grow") {
+        auto reader = ivio::buffered_reader<piecewise_reader>{piecewise_reader{data, 1'000}};
+        auto result = std::string{};
+        {
+            auto limit = fd_limit{};
+            result = readAll(reader);
+        }
+        CHECK(result == data);
+    }
+}
+#endif
+
+#if (defined(unix) || defined(__unix__) || defined(__unix))
+TEST_CASE("mmap_queue releases only whole pages", "[buffered_reader]") {
+    auto queue = ivio::mmap_queue{};
+    auto p     = ivio::mmap_queue::pageSize();
+
+    // writes a running counter, drops uneven amounts, the window must stay intact
+    auto written = size_t{0};
+    auto dropped = size_t{0};
+    for (size_t i{0}; i < 200; ++i) {
+        auto out = queue.free(100'003);
+        for (size_t j{0}; j < 100'003; ++j) {
+            out[j] = static_cast<char>((written + j) % 251);
+        }
+        queue.commit(100'003);
+        written += 100'003;
+
+        auto n = std::min(queue.size(), size_t{99'991} + i * 13);
+        queue.drop(n);
+        dropped += n;
+
+        REQUIRE(reinterpret_cast<uintptr_t>(queue.base) % p == 0);
+        REQUIRE(queue.size() == written - dropped);
+        for (size_t j{0}; j < queue.size(); j += 4099) {
+            REQUIRE(queue.data()[j] == static_cast<char>((dropped + j) % 251));
+        }
+    }
+}
+#endif
@@ -70,3 +70,64 @@ TEST_CASE("reading csv files", "[csv][reader]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("reading csv files with empty entries", "[csv][reader]") {
+    auto ss = std::stringstream{"a,b,\n"
+                                "a,,\n"
+                                ",\n"
+                                "\n"
+                                " a , b\tc \r\n"};
+    auto reader = ivio::csv::reader{{.input = ss, .trim = true}};
+    auto vec = std::vector<ivio::csv::record>{};
+    for (auto r : reader) {
+        vec.push_back(r);
+    }
+    auto expected = std::vector<ivio::csv::record> {
+        {.entries = {"a", "b"}},
+        {.entries = {"a", ""}},
+        {.entries = {""}},
+        {.entries = {}},
+        {.entries = {"a", "b\tc"}},
+    };
+    CHECK(vec == expected);
+}
+
+TEST_CASE("tell and seek in compressed csv files", "[csv][reader][gz][checkpoints]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    auto expected  = std::vector<ivio::csv::record>{};
+    auto test_data = std::string{};
+    for (size_t i{0}; i < 50'000; ++i) {
+        expected.push_back({.entries = {std::to_string(i), generateSequence(i % 40), std::to_string(i * i)}});
+        test_data += expected.back().entries[0] + "," + expected.back().entries[1] + "," + expected.back().entries[2] + "\n";
+    }
+    std::filesystem::remove(tmp / "file.csv.gz");
+    std::filesystem::remove(tmp / "file.csv.gz.gzidx");
+    {
+        auto writer = ivio::csv::writer{{.output = tmp / "file.csv.gz"}};
+        for (auto const& r : expected) {
+            writer.write(r);
+        }
+    }
+
+    // offsets of the lines in the uncompressed data
+    auto positions = std::vector<size_t>{0};
+    for (size_t i{0}; i + 1 < test_data.size(); ++i) {
+        if (test_data[i] == '\n') positions.push_back(i + 1);
+    }
+    REQUIRE(positions.size() == expected.size());
+
+    auto reader = ivio::csv::reader{{.input = tmp / "file.csv.gz", .checkpointSpacing = 50'000}};
+    for (size_t i{0}; i < expected.size(); i += 997) {
+        auto p = (i * 7919) % expected.size();
+        INFO("record " << p);
+        reader.seek(positions[p]);
+        CHECK(reader.tell() == positions[p]);
+        auto v = reader.next();
+        REQUIRE(v);
+        CHECK(ivio::csv::record(*v) == expected[p]);
+    }
+
+    std::filesystem::remove_all(tmp);
+}
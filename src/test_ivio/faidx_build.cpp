@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/ivio.h>
+
+#include "generateSequence.h"
+
+namespace {
+void writeFile(std::filesystem::path const& path, std::string const& content) {
+    auto ofs = std::ofstream{path, std::ios::binary};
+    ofs << content;
+}
+}
+
+TEST_CASE("building faidx indices", "[faidx][build]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "build.fa";
+
+    SECTION("small file") {
+        auto content = std::string{
+            ">seq1 some description\n"
+            "ACGT\n"
+            "ACGT\n"
+            "AC\n"
+            ">seq2\tdescription\r\n"
+            "ACG\r\n"
+            "ACG\r\n"
+            ">empty\n"
+            ">seq3\n"
+            "ACGTACGT\n"
+            "\n"
+            ">seq4\n"
+            "AC\n"
+            "AC" // no line break at the end of the file
+        };
+        writeFile(path, content);
+        auto expected = std::vector<ivio::faidx::record>{
+            {.id = "seq1",  .length = 10, .offset = 23, .linebases = 4, .linewidth = 5},
+            {.id = "seq2",  .length = 6,  .offset = 55, .linebases = 3, .linewidth = 5},
+            {.id = "empty", .length = 0,  .offset = 72, .linebases = 0, .linewidth = 0},
+            {.id = "seq3",  .length = 8,  .offset = 78, .linebases = 8, .linewidth = 9},
+            {.id = "seq4",  .length = 4,  .offset = 94, .linebases = 2, .linewidth = 3},
+        };
+        CHECK(ivio::faidx::build(path) == expected);
+
+        // written index
+        auto reader = ivio::faidx::reader{{path.string() + ".fai"}};
+        CHECK(std::vector(begin(reader), end(reader)) == expected);
+
+        // custom output path
+        CHECK(ivio::faidx::build(path, 2, tmp / "build.other.fai") == expected);
+        CHECK(std::filesystem::exists(tmp / "build.other.fai"));
+    }
+
+    SECTION("large file, split into chunks") {
+        // many records with different line lengths, large enough to be scanned by several threads
+        auto block     = generateSequence(10'000);
+        auto content   = std::string{};
+        auto expected  = std::vector<ivio::faidx::record>{};
+        auto sequences = std::vector<std::string>{};
+        for (size_t i{0}; content.size() < (6<<20); ++i) {
+            auto seq        = std::string{};
+            auto len        = (i % 7 == 0) ? 200'000 + i : i * 37 % 3'000;
+            while (seq.size() < len) seq += block;
+            seq.resize(len);
+            auto linebases  = 50 + i % 31;
+            auto lineEnding = std::string{(i % 5 == 0) ? "\r\n" : "\n"};
+            auto firstLine  = std::min(len, linebases); // a single line may be shorter
+            content += ">seq" + std::to_string(i) + " description\n";
+            expected.push_back({.id = "seq" + std::to_string(i), .length = len, .offset = content.size(),
+                                .linebases = firstLine, .linewidth = (len > 0) ? firstLine + lineEnding.size() : 0});
+            for (size_t j{0}; j < len; j += linebases) {
+                content += seq.substr(j, linebases) + lineEnding;
+            }
+            sequences.push_back(seq);
+        }
+        writeFile(path, content);
+
+        for (size_t threadNbr : {1, 2, 3, 8}) {
+            INFO("threads: " << threadNbr);
+            CHECK(ivio::faidx::build(path, threadNbr) == expected);
+        }
+
+        // the index is usable by indexed_reader
+        auto reader = ivio::fasta::indexed_reader{{.input = path}};
+        for (size_t i{0}; i < sequences.size(); i += 7) {
+            CHECK(reader.fetch(expected[i].id, 1'000, 1'100) == sequences[i].substr(1'000, 100));
+        }
+    }
+
+    SECTION("invalid files") {
+        writeFile(path, ">seq1\nACGT\nAC\nACGT\n");
+        CHECK_THROWS(ivio::faidx::build(path));  // different line lengths
+
+        writeFile(path, ">seq1\nACGT\nACGTA\n");
+        CHECK_THROWS(ivio::faidx::build(path));  // last line too long
+
+        writeFile(path, ">seq1\nACGT\n\nACGT\n");
+        CHECK_THROWS(ivio::faidx::build(path));  // empty line inside of a sequence
+
+        writeFile(path, "ACGT\n>seq1\nACGT\n");
+        CHECK_THROWS(ivio::faidx::build(path));  // sequence in front of the first header
+
+        writeFile(path, ">seq1\nACGT\n>seq1\nACGT\n");
+        CHECK_THROWS(ivio::faidx::build(path));  // duplicate ids
+    }
+}
@@ -59,3 +59,18 @@ TEST_CASE("reading faidx files", "[faidx][reader]") {
         reader.close();
     }
 }
+
+TEST_CASE("reading invalid faidx files", "[faidx][reader][invalid]") {
+    auto ss = std::stringstream{"I-am-genomic-data\t16\t19\t3\t4\n"
+                                "Some-other-data\t9\t58\n"
+                                "Weird-multiline-data\t22\t92\t3\t4\n"};
+    auto reader = ivio::faidx::reader{{ss}};
+    REQUIRE(reader.next());
+    auto error = std::string{};
+    try {
+        reader.next();
+    } catch (std::runtime_error const& e) {
+        error = e.what();
+    }
+    CHECK(error.find("Some-other-data") != std::string::npos); // the error quotes the invalid line
+}
@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/ivio.h>
+
+#include "generateSequence.h"
+#include "utilities.h"
+
+namespace {
+struct TestSequence {
+    std::string id;
+    std::string seq;
+    size_t      linebases;
+    std::string lineEnding;
+};
+
+// writes a fasta file and its .fai index
+void createIndexedFasta(std::filesystem::path const& path, std::vector<TestSequence> const& sequences) {
+    auto fasta = std::string{};
+    auto fai   = std::string{};
+    for (auto const& s : sequences) {
+        fasta += ">" + s.id + " some description" + s.lineEnding;
+        fai += s.id + "\t" + std::to_string(s.seq.size()) + "\t" + std::to_string(fasta.size()) + "\t"
+             + std::to_string(s.linebases) + "\t" + std::to_string(s.linebases + s.lineEnding.size()) + "\n";
+        for (size_t i{0}; i < s.seq.size(); i += s.linebases) {
+            fasta += s.seq.substr(i, s.linebases) + s.lineEnding;
+        }
+    }
+    auto ofs = std::ofstream{path, std::ios::binary};
+    ofs << fasta;
+    auto ofs2 = std::ofstream{path.string() + ".fai", std::ios::binary};
+    ofs2 << fai;
+}
+
+// compresses a fasta file into bgzf blocks of `blockSize` bytes, with .fai and .gzi index
+auto compressIndexedFasta(std::filesystem::path const& path, size_t blockSize) -> std::filesystem::path {
+    auto output     = std::filesystem::path{path.string() + ".gz"};
+    auto compressed = std::string{};
+    auto offsets    = compressBgzf(read_file(path), blockSize, compressed);
+    auto gzi        = std::string{};
+    append<uint64_t>(gzi, offsets.size() - 1);
+    for (size_t i{1}; i < offsets.size(); ++i) {
+        append<uint64_t>(gzi, offsets[i]);
+        append<uint64_t>(gzi, i * blockSize);
+    }
+    std::ofstream{output, std::ios::binary} << compressed;
+    std::ofstream{output.string() + ".gzi", std::ios::binary} << gzi;
+    std::filesystem::copy_file(path.string() + ".fai", output.string() + ".fai", std::filesystem::copy_options::overwrite_existing);
+    return output;
+}
+}
+
+TEST_CASE("fetching subsequences of indexed fasta files", "[fasta][indexed_reader]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "indexed.fa";
+
+    auto sequences = std::vector<TestSequence>{
+        {"seq1",   generateSequence(10'000), 60, "\n"},
+        {"seq2",   generateSequence(7),      60, "\n"},   // single line
+        {"seq3",   generateSequence(5'000),  80, "\r\n"}, // windows line endings
+        {"HLA:01", generateSequence(300),    70, "\n"},   // ':' in the name
+        {"seq4",   generateSequence(120),    60, "\n"},   // last line is full
+    };
+    createIndexedFasta(path, sequences);
+
+    auto compressed = GENERATE(false, true);
+    if (compressed) {
+        path = compressIndexedFasta(path, 1'000); // small blocks, most fetches span several of them
+    }
+    INFO("compressed: " << compressed);
+
+    auto reader = ivio::fasta::indexed_reader{{.input = path}};
+    REQUIRE(reader.records().size() == sequences.size());
+    CHECK(reader.records()[2].id == "seq3");
+    CHECK(reader.records()[2].length == 5'000);
+
+    SECTION("complete sequences") {
+        for (auto const& s : sequences) {
+            CHECK(reader.fetch(s.id, 0, s.seq.size()) == s.seq);
+            CHECK(reader.fetch(s.id) == s.seq);
+        }
+    }
+
+    SECTION("ranges within and across lines") {
+        for (auto const& s : sequences) {
+            INFO(s.id);
+            for (size_t i{0}; i < 500; ++i) {
+                auto begin = static_cast<size_t>(rand()) % (s.seq.size() + 1);
+                auto end   = begin + static_cast<size_t>(rand()) % 200;
+                CHECK(reader.fetch(s.id, begin, end) == s.seq.substr(begin, end - begin));
+            }
+            // line boundaries
+            for (auto begin : {s.linebases - 1, s.linebases, s.linebases + 1}) {
+                CHECK(reader.fetch(s.id, begin, begin + s.linebases) == s.seq.substr(std::min(begin, s.seq.size()), s.linebases));
+            }
+        }
+    }
+
+    SECTION("region strings") {
+        CHECK(reader.fetch("seq1:1-10") == sequences[0].seq.substr(0, 10));
+        CHECK(reader.fetch("seq1:1,001-2,000") == sequences[0].seq.substr(1000, 1000));
+        CHECK(reader.fetch("seq3:4990") == sequences[2].seq.substr(4989));
+        CHECK(reader.fetch("HLA:01") == sequences[3].seq);
+        CHECK(reader.fetch("HLA:01:5-9") == sequences[3].seq.substr(4, 5));
+    }
+
+    SECTION("out of range and unknown sequences") {
+        CHECK(reader.fetch("seq2", 5, 100) == sequences[1].seq.substr(5));
+        CHECK(reader.fetch("seq2", 100, 200).empty());
+        CHECK(reader.fetch("seq2", 4, 2).empty());
+        CHECK_THROWS(reader.fetch("unknown", 0, 10));
+        CHECK_THROWS(reader.fetch("unknown:1-10"));
+    }
+
+    SECTION("missing index") {
+        CHECK_THROWS(ivio::fasta::indexed_reader{{.input = path, .index = tmp / "missing.fai"}});
+        if (compressed) {
+            CHECK_THROWS(ivio::fasta::indexed_reader{{.input = path, .gziIndex = tmp / "missing.gzi"}});
+        }
+    }
+
+    SECTION("gzip compressed files without bgzf blocks") {
+        auto gzPath = tmp / "indexed_plain.fa.gz";
+        {
+            auto writer = ivio::fasta::writer{{.output = gzPath}};
+            writer.write({.id = "seq1", .seq = sequences[0].seq});
+        }
+        std::filesystem::copy_file(path.string() + ".fai", gzPath.string() + ".fai", std::filesystem::copy_options::overwrite_existing);
+        CHECK_THROWS(ivio::fasta::indexed_reader{{.input = gzPath}});
+    }
+}
@@ -2,6 +2,7 @@
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
 #include "generateSequence.h"
+#include "utilities.h"
 
 #include <catch2/catch_all.hpp>
 #include <filesystem>
@@ -148,6 +149,24 @@ TEST_CASE("reading fasta files", "[fasta][reader]") {
     }
 
 
+    SECTION("Create a pipe and read from file with small read ahead blocks") {
+#if (defined(unix) || defined(__unix__) || defined(__unix)) && !defined(__EMSCRIPTEN__)
+        auto filename = std::filesystem::path{tmp / "fifo_file.fa"};
+        mkfifo(filename.c_str(), O_CREAT | O_RDWR | S_IRWXU);
+        auto t = std::thread{[&](){
+            auto ofs = std::ofstream{filename, std::ios::binary};
+            ofs << test_data;
+        }};
+        auto reader = ivio::fasta::reader{{.input = filename, .readAhead = {.depth = 2, .blockSize = 7}}};
+
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(expected == vec);
+        t.join();
+#else
+        SKIP();
+#endif
+    }
+
     SECTION("Create a pipe and read istream") {
 #if (defined(unix) || defined(__unix__) || defined(__unix)) && !defined(__EMSCRIPTEN__)
         auto filename = std::filesystem::path{tmp / "fifo_file.fa"};
@@ -493,8 +512,199 @@ TEST_CASE("reading compressed fasta files", "[fasta][reader][gz][short]") {
         CHECK(expected == vec);
     }
 
+    SECTION("Read concatenated gzip members") {
+        auto ofs = std::ofstream{tmp / "file2.fa.gz", std::ios::binary};
+        ofs.write(test_data.data(), test_data.size());
+        ofs.write(test_data.data(), test_data.size());
+        ofs.close();
+
+        auto reader = ivio::fasta::reader{{tmp / "file2.fa.gz"}};
+        auto vec = std::vector(begin(reader), end(reader));
+        auto expected2 = expected;
+        expected2.insert(expected2.end(), expected.begin(), expected.end());
+        CHECK(expected2 == vec);
+    }
+
 
     SECTION("cleanup - deleting temp folder") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("seeking in compressed fasta files with checkpoints", "[fasta][reader][gz][checkpoints]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    // many records, large enough for several checkpoints
+    srand(0);
+    auto expected  = std::vector<ivio::fasta::record>{};
+    auto test_data = std::string{};
+    for (size_t i{0}; test_data.size() < (1<<20); ++i) {
+        expected.push_back({.id = "seq" + std::to_string(i), .seq = generateSequence(i % 13 * 1'000 + 10)});
+        test_data += ">" + expected.back().id + "\n";
+        for (size_t j{0}; j < expected.back().seq.size(); j += 80) {
+            test_data += expected.back().seq.substr(j, 80) + "\n";
+        }
+    }
+    auto concatenated = GENERATE(false, true);
+    INFO("concatenated gzip members: " << concatenated);
+    auto members = concatenated ? std::vector<size_t>{300'000, 300'001, 800'000} : std::vector<size_t>{};
+    auto path    = tmp / "checkpoints.fa.gz";
+    auto index   = tmp / "checkpoints.fa.gz.gzidx";
+    write_gzip_file(path, test_data, members);
+    std::filesystem::remove(index);
+
+    // positions as reported for the uncompressed file
+    auto uncompressedPositions = std::vector<size_t>{};
+    {
+        auto ofs = std::ofstream{tmp / "checkpoints.fa", std::ios::binary};
+        ofs << test_data;
+        ofs.close();
+        auto reader = ivio::fasta::reader{{tmp / "checkpoints.fa"}};
+        uncompressedPositions.push_back(reader.tell());
+        for ([[maybe_unused]] auto r : reader) {
+            uncompressedPositions.push_back(reader.tell());
+        }
+    }
+
+    auto order = std::vector<size_t>{};
+    for (size_t i{0}; i < expected.size(); ++i) {
+        order.push_back(i * 7919 % expected.size());
+    }
+    auto checkSeeks = [&](ivio::fasta::reader& reader, std::vector<size_t> const& positions) {
+        for (auto p : order) {
+            INFO("record " << p);
+            reader.seek(positions[p]);
+            auto v = reader.next();
+            REQUIRE(v);
+            CHECK(*v == static_cast<ivio::fasta::record_view>(expected[p]));
+        }
+    };
+
+    SECTION("first pass records checkpoints and writes the index") {
+        auto reader    = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+        auto positions = std::vector<size_t>{reader.tell()};
+        auto vec       = std::vector<ivio::fasta::record>{};
+        for (auto r : reader) {
+            vec.emplace_back(r);
+            positions.push_back(reader.tell());
+        }
+        CHECK(vec == expected);
+        CHECK(positions == uncompressedPositions);
+        CHECK(std::filesystem::exists(index));
+        checkSeeks(reader, positions);
+
+        // a second reader loads the index
+        auto reader2 = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+        checkSeeks(reader2, positions);
+        CHECK_THROWS(reader2.seek(test_data.size() + 1));
+    }
+
+    SECTION("seeking ahead of the recorded checkpoints") {
+        auto reader = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10, .checkpointIndex = tmp / "other.gzidx"}};
+        checkSeeks(reader, uncompressedPositions);
+        CHECK(!std::filesystem::exists(index));
+        std::filesystem::remove(tmp / "other.gzidx");
+    }
+
+    SECTION("a stale index is replaced") {
+        {
+            auto reader = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+            for ([[maybe_unused]] auto r : reader) {}
+        }
+        auto shifted = ">first\nACGT\n" + test_data;
+        write_gzip_file(path, shifted, members);
+        auto reader    = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+        auto positions = std::vector<size_t>{};
+        for (auto p : uncompressedPositions) {
+            positions.push_back(p + 12);
+        }
+        checkSeeks(reader, positions);
+    }
+
+    SECTION("a stale index of a file with the same size is replaced") {
+        auto readIndex = [&]() {
+            auto ifs = std::ifstream{index, std::ios::binary};
+            return std::string{std::istreambuf_iterator<char>{ifs}, {}};
+        };
+        // stored deflate blocks, the size only depends on the length of the data
+        write_gzip_file(path, test_data, members, 0);
+        auto size = std::filesystem::file_size(path);
+        {
+            auto reader = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+            for ([[maybe_unused]] auto r : reader) {}
+        }
+        auto oldIndex = readIndex();
+
+        auto shifted = test_data; // same length, different letters
+        for (auto& c : shifted) {
+            if (c >= 'a' && c <= 'z') c = static_cast<char>('a' + (c - 'a' + 1) % 26);
+        }
+        write_gzip_file(path, shifted, members, 0);
+        REQUIRE(std::filesystem::file_size(path) == size);
+        {
+            auto reader = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+            for ([[maybe_unused]] auto r : reader) {}
+        }
+        CHECK(readIndex() != oldIndex);
+    }
+
+    SECTION("an index of an older format is replaced") {
+        {
+            auto ofs = std::ofstream{index, std::ios::binary};
+            ofs << std::string_view{"IVGZIDX\1", 8} << std::string(64, '\0');
+        }
+        auto reader = ivio::fasta::reader{{.input = path, .checkpointSpacing = 32<<10}};
+        checkSeeks(reader, uncompressedPositions);
+    }
+
+    SECTION("cleanup - deleting temp folder") {
+        std::filesystem::remove_all(tmp);
+    }
+}
+
+TEST_CASE("reading fasta files with mmap policies", "[fasta][reader][mmap]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    // larger than 1MiB, so consumed parts of the mapping are released
+    auto expected = std::vector<ivio::fasta::record>{};
+    auto test_data = std::string{};
+    for (size_t i{0}; i < 16'384; ++i) {
+        expected.push_back({
+            .id  = "sequence id " + std::to_string(i),
+            .seq = std::string(100 + i % 200, "ACGT"[i % 4])
+        });
+        test_data += ">" + expected.back().id + "\n";
+        test_data += expected.back().seq + "\n";
+    }
+    {
+        auto ofs = std::ofstream{tmp / "file_mmap.fa", std::ios::binary};
+        ofs << test_data;
+    }
+
+    SECTION("sequential access with all hints") {
+        auto reader = ivio::fasta::reader{{.input = tmp / "file_mmap.fa",
+                                           .mmapPolicy = {.readAhead = 4096, .populate = true, .hugePages = true, .dropBehind = true}}};
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(expected == vec);
+    }
+
+    auto policy = GENERATE(ivio::mmap_policy{}, ivio::mmap_policy::random());
+    SECTION("Tell and Seek, forwards and backwards") {
+        auto recordPositions = std::vector<size_t>{};
+        auto reader = ivio::fasta::reader{{.input = tmp / "file_mmap.fa", .mmapPolicy = policy}};
+        recordPositions.push_back(reader.tell());
+        for ([[maybe_unused]] auto r : reader) {
+            recordPositions.push_back(reader.tell());
+        }
+        REQUIRE(recordPositions.size() == expected.size() + 1);
+
+        for (auto p : {16'000, 10, 8'000, 8'001, 0, 16'383, 5}) {
+            reader.seek(recordPositions[p]);
+            auto v = reader.next();
+            REQUIRE(v);
+            CHECK(*v == static_cast<ivio::fasta::record_view>(expected[p]));
+        }
+    }
+}
@@ -37,6 +37,15 @@ TEST_CASE("writing fasta files", "[fasta][writer]") {
         CHECK(read_file(tmp / "file.fa") == expected);
     }
 
+    SECTION("Write to std::filesystem::path with file_writer_config") {
+        auto writer = ivio::fasta::writer{{.output = tmp / "file.fa", .fileConfig = {.bufferSize = 1, .directIO = true, .expectedSize = 1'000}}};
+        for (auto r : test_data) {
+            writer.write(r);
+        }
+        writer.close();
+        CHECK(read_file(tmp / "file.fa") == expected);
+    }
+
     SECTION("Write to std::ofstream") {
         auto fs = std::ofstream{tmp / "file.fa", std::ios::binary};
         auto writer = ivio::fasta::writer{{fs}};
@@ -114,6 +123,37 @@ TEST_CASE("writing fasta files (compressed)", "[fasta][writer][gz]") {
         CHECK(read_compressed_string(ss.str(), tmp / "tmp.fasta.gz" ) == expected);
     }
 
+    SECTION("Write to std::filesystem::path with a background writer") {
+        auto writer = ivio::fasta::writer{{.output = tmp / "file.fa.gz", .async = true}};
+        for (auto r : test_data) {
+            writer.write(r);
+        }
+        writer.close();
+
+        CHECK(read_file(tmp / "file.fa.gz") == expected);
+    }
+
+    SECTION("Write to std::filesystem::path with multiple threads") {
+        auto writer = ivio::fasta::writer{{.output = tmp / "file.fa.gz", .threadNbr = 2, .compressionLevel = 9}};
+        for (auto r : test_data) {
+            writer.write(r);
+        }
+        writer.close();
+
+        CHECK(read_file(tmp / "file.fa.gz") == expected);
+    }
+
+    SECTION("Write to std::stringstream with a background writer") {
+        auto ss = std::stringstream{};
+        auto writer = ivio::fasta::writer{{.output = ss, .compressed = true, .async = true}};
+        for (auto r : test_data) {
+            writer.write(r);
+        }
+        writer.close();
+
+        CHECK(read_compressed_string(ss.str(), tmp / "tmp.fasta.gz" ) == expected);
+    }
+
 
     SECTION("cleanup - deleting temp folder") {
         std::filesystem::remove_all(tmp);
@@ -194,3 +234,31 @@ TEST_CASE("writing fasta files, short lines (compressed)", "[fasta][writer][gz][
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("writing bgzf compressed fasta files", "[fasta][writer][bgzf]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    auto records = std::vector<ivio::fasta::record>{};
+    for (size_t i{0}; i < 10'000; ++i) {
+        records.push_back({.id = "read " + std::to_string(i), .seq = std::string(50 + i % 100, "ACGT"[i % 4])});
+    }
+
+    auto threadNbr    = GENERATE(size_t{0}, size_t{2});
+    auto alignRecords = GENERATE(false, true);
+    INFO("threads " << threadNbr << ", align records " << alignRecords);
+    {
+        auto writer = ivio::fasta::writer{{.output = tmp / "file.fa.gz", .threadNbr = threadNbr, .bgzf = true, .alignRecords = alignRecords}};
+        for (auto const& r : records) {
+            writer.write(r);
+        }
+    }
+
+    // read back sequentially and in parallel
+    for (size_t readerThreads : {0, 2}) {
+        auto reader = ivio::fasta::reader{{.input = tmp / "file.fa.gz", .threadNbr = readerThreads}};
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(vec == records);
+    }
+    std::filesystem::remove_all(tmp);
+}
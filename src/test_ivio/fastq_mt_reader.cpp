@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/detail/gzip_mt_reader.h>
+#include <ivio/ivio.h>
+#include <zlib.h>
+
+#include "generateSequence.h"
+
+namespace {
+auto generateFastq(size_t count) -> std::string {
+    auto s = std::string{};
+    for (size_t i{0}; i < count; ++i) {
+        auto seq = generateSequence(50 + i % 100);
+        for (auto& c : seq) {
+            c = "ACGT"[c % 4];
+        }
+        s += "@read " + std::to_string(i) + "\n" + seq + "\n+\n" + std::string(seq.size(), "!#ABI"[i % 5]) + "\n";
+    }
+    return s;
+}
+
+// writes data as gzip file, `members` gzip members are concatenated
+void writeGzip(std::filesystem::path const& path, std::string_view data, std::string const& level, size_t members = 1, bool flush = false) {
+    for (size_t m{0}; m < members; ++m) {
+        auto part = data.substr(data.size() * m / members, data.size() * (m+1) / members - data.size() * m / members);
+        auto mode = (m == 0 ? "wb" : "ab") + level;
+        auto f = gzopen(path.string().c_str(), mode.c_str());
+        REQUIRE(f != Z_NULL);
+        while (!part.empty()) {
+            auto n = std::min<size_t>(part.size(), 10'000);
+            REQUIRE(gzwrite(f, part.data(), static_cast<unsigned>(n)) == static_cast<int>(n));
+            if (flush) {
+                gzflush(f, Z_SYNC_FLUSH);
+            }
+            part = part.substr(n);
+        }
+        gzclose(f);
+    }
+}
+
+auto readAll(ivio::gzip_mt_reader& reader) -> std::string {
+    auto s = std::string{};
+    auto buffer = std::vector<char>(1<<16);
+    while (auto n = reader.read(buffer)) {
+        s.append(buffer.data(), n);
+    }
+    return s;
+}
+}
+
+TEST_CASE("decompressing gzip files with multiple threads", "[gzip][reader][mt]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    srand(0);
+    auto data = generateFastq(5'000);
+    auto path = tmp / "file_mt.fq.gz";
+
+    auto [level, members, flush] = GENERATE(std::tuple{std::string{"1"}, 1, false},
+                                            std::tuple{std::string{"6"}, 1, false},
+                                            std::tuple{std::string{"9"}, 3, false},
+                                            std::tuple{std::string{"0"}, 1, false},
+                                            std::tuple{std::string{"6"}, 1, true},
+                                            std::tuple{std::string{"6"}, 7, false});
+    writeGzip(path, data, level, members, flush);
+
+    auto chunkSize = GENERATE(size_t{1'000}, size_t{10'000}, size_t{4<<20});
+    auto threadNbr = GENERATE(size_t{1}, size_t{3});
+
+    INFO("level " << level << ", members " << members << ", chunk size " << chunkSize << ", threads " << threadNbr);
+    auto reader = ivio::gzip_mt_reader{ivio::mmap_reader{path}, threadNbr, chunkSize};
+    CHECK(readAll(reader) == data);
+}
+
+TEST_CASE("decompressing gzip files with multiple threads and mmap policies", "[gzip][reader][mt][mmap]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    // larger than 1MiB, so consumed parts of the mapping are released
+    srand(0);
+    auto data = generateFastq(40'000);
+    auto path = tmp / "file_mt_mmap.fq.gz";
+    auto level = GENERATE(std::string{"0"}, std::string{"6"});
+    writeGzip(path, data, level);
+
+    auto policy = GENERATE(ivio::mmap_policy{.readAhead = 1<<16, .dropBehind = true}, ivio::mmap_policy::random());
+    INFO("level " << level);
+    auto reader = ivio::gzip_mt_reader{ivio::mmap_reader{path, policy}, 3, 100'000};
+    CHECK(readAll(reader) == data);
+}
+
+TEST_CASE("decompressing corrupted gzip files with multiple threads", "[gzip][reader][mt]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    srand(0);
+    auto data = generateFastq(2'000);
+    auto path = tmp / "file_mt_corrupt.fq.gz";
+    writeGzip(path, data, "6");
+
+    auto compressed = std::string{};
+    {
+        auto ifs = std::ifstream{path, std::ios::binary};
+        compressed = std::string{std::istreambuf_iterator<char>{ifs}, {}};
+    }
+
+    SECTION("wrong checksum") {
+        compressed[compressed.size() - 8] ^= 1;
+    }
+    SECTION("truncated") {
+        compressed.resize(compressed.size() / 2);
+    }
+    {
+        auto ofs = std::ofstream{path, std::ios::binary};
+        ofs << compressed;
+    }
+    auto reader = ivio::gzip_mt_reader{ivio::mmap_reader{path}, 2, 4'096};
+    CHECK_THROWS(readAll(reader));
+}
+
+TEST_CASE("reading gzip compressed fastq files with multiple threads", "[fastq][reader][mt]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    srand(0);
+    auto data = generateFastq(5'000);
+    auto path = tmp / "file_mt.fq.gz";
+    writeGzip(path, data, "6");
+
+    auto expected = [&]() {
+        auto reader = ivio::fastq::reader{{.input = path}};
+        return std::vector(begin(reader), end(reader));
+    }();
+    CHECK(expected.size() == 5'000);
+
+    SECTION("Read from std::filesystem::path") {
+        auto reader = ivio::fastq::reader{{.input = path, .threadNbr = 4}};
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(expected == vec);
+    }
+
+    SECTION("Read from std::ifstream, threadNbr is ignored") {
+        auto ifs = std::ifstream{path, std::ios::binary};
+        auto reader = ivio::fastq::reader{{.input = ifs, .threadNbr = 4}};
+        auto vec = std::vector(begin(reader), end(reader));
+        CHECK(expected == vec);
+    }
+}
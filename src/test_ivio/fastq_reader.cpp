@@ -7,6 +7,7 @@
 #include <ivio/ivio.h>
 
 #include "generateSequence.h"
+#include "utilities.h"
 
 TEST_CASE("reading fastq files", "[fastq][reader]") {
     auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
@@ -80,6 +81,21 @@ TEST_CASE("reading fastq files", "[fastq][reader]") {
     }
 }
 
+TEST_CASE("reading invalid fastq files", "[fastq][reader][invalid]") {
+    SECTION("missing '+' line") {
+        auto ss = std::stringstream{"@read1\nACGT\n+\nIIII\n@read2\nACGT\nIIII\n@read3\nACGT\n+\nIIII\n"};
+        auto reader = ivio::fastq::reader{{ss}};
+        REQUIRE(reader.next());
+        CHECK_THROWS(reader.next());
+    }
+    SECTION("truncated last record") {
+        auto ss = std::stringstream{"@read1\nACGT\n+\nIIII\n@read2\nACGT\n"};
+        auto reader = ivio::fastq::reader{{ss}};
+        REQUIRE(reader.next());
+        CHECK(!reader.next());
+    }
+}
+
 TEST_CASE("reading fastq files over large files", "[fastq][reader][large]") {
     auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
     std::filesystem::create_directory(tmp);
@@ -147,3 +163,63 @@ TEST_CASE("reading fastq files over large files", "[fastq][reader][large]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("tell and seek in compressed fastq files", "[fastq][reader][gz][checkpoints]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    auto expected  = std::vector<ivio::fastq::record>{};
+    auto test_data = std::string{};
+    srand(0);
+    for (size_t i{0}; i < 4096; ++i) {
+        expected.push_back({
+            .id   = "sequence id " + std::to_string(i),
+            .seq  = generateSequence(250),
+            .id2  = "",
+            .qual = std::string(250, '!'),
+        });
+        test_data += "@" + expected.back().id + "\n";
+        test_data += expected.back().seq + "\n";
+        test_data += "+" + expected.back().id2 + "\n";
+        test_data += expected.back().qual + "\n";
+    }
+    write_gzip_file(tmp / "file.fq.gz", test_data);
+    std::filesystem::remove(tmp / "file.fq.gz.gzidx");
+
+    auto positions = std::vector<size_t>{};
+    {
+        auto reader = ivio::fastq::reader{{.input = tmp / "file.fq.gz", .checkpointSpacing = 100'000}};
+        positions.push_back(reader.tell());
+        for ([[maybe_unused]] auto r : reader) {
+            positions.push_back(reader.tell());
+        }
+        REQUIRE(positions.size() == expected.size() + 1);
+    }
+
+    // an index which can not be written does not fail reading
+    {
+        auto reader = ivio::fastq::reader{{.input = tmp / "file.fq.gz", .checkpointSpacing = 100'000,
+                                           .checkpointIndex = tmp / "does_not_exist" / "file.fq.gz.gzidx"}};
+        auto vec = std::vector<ivio::fastq::record>{};
+        CHECK_NOTHROW(vec = std::vector<ivio::fastq::record>(begin(reader), end(reader)));
+        CHECK(vec == expected);
+        reader.seek(positions[100]);
+        auto v = reader.next();
+        REQUIRE(v);
+        CHECK(*v == static_cast<ivio::fastq::record_view>(expected[100]));
+    }
+
+    // seeks with the stored checkpoints
+    auto reader = ivio::fastq::reader{{.input = tmp / "file.fq.gz", .checkpointSpacing = 100'000}};
+    for (size_t i{0}; i < expected.size(); ++i) {
+        auto p = i * 541 % expected.size();
+        INFO("record " << p);
+        reader.seek(positions[p]);
+        auto v = reader.next();
+        REQUIRE(v);
+        CHECK(*v == static_cast<ivio::fastq::record_view>(expected[p]));
+        CHECK(reader.tell() == positions[p+1]);
+    }
+
+    std::filesystem::remove_all(tmp);
+}
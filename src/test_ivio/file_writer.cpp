@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/detail/file_writer.h>
+
+namespace {
+auto readFile(std::filesystem::path const& path) -> std::string {
+    auto ifs = std::ifstream{path, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{ifs}, {}};
+}
+}
+
+TEST_CASE("writing files with file_writer", "[file][writer]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "file_writer.txt";
+
+    auto data = std::string{};
+    for (size_t i{0}; data.size() < 1'000'000; ++i) {
+        data += "line " + std::to_string(i) + "\n";
+    }
+
+    auto config = GENERATE(ivio::file_writer_config{},
+                           ivio::file_writer_config{.bufferSize = 1},
+                           ivio::file_writer_config{.bufferSize = 100'000, .directIO = true},
+                           ivio::file_writer_config{.directIO = true, .expectedSize = 1'000'000},
+                           ivio::file_writer_config{.expectedSize = 10'000'000});
+    auto chunkSize = GENERATE(size_t{1}, size_t{1'000}, size_t{700'000});
+    INFO("buffer size " << config.bufferSize << ", direct " << config.directIO << ", expected size " << config.expectedSize << ", chunk size " << chunkSize);
+
+    {
+        auto writer = ivio::file_writer{path, config};
+        size_t written{};
+        for (size_t i{0}; i < data.size(); i += chunkSize) {
+            written += writer.write(std::string_view{data}.substr(i, chunkSize));
+        }
+        writer.close();
+        CHECK(written == data.size());
+    }
+    CHECK(std::filesystem::file_size(path) == data.size());
+    CHECK(readFile(path) == data);
+}
+
+TEST_CASE("file_writer closes on destruction", "[file][writer]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "file_writer_dtor.txt";
+    {
+        auto writer = ivio::file_writer{path};
+        writer.write(std::string_view{"some data\n"});
+        auto moved = std::move(writer);
+    }
+    CHECK(readFile(path) == "some data\n");
+}
+
+TEST_CASE("file_writer fails on unwritable paths", "[file][writer]") {
+#if (defined(unix) || defined(__unix__) || defined(__unix))
+    CHECK_THROWS(ivio::file_writer{"/this/path/does/not/exist/file.txt"});
+#else
+    SKIP();
+#endif
+}
+
+TEST_CASE("file_writer reports write errors from close() only", "[file][writer]") {
+#if defined(__linux__)
+    // writes to /dev/full fail with ENOSPC
+    SECTION("explicit close") {
+        auto writer = ivio::file_writer{"/dev/full"};
+        writer.write(std::string_view{"some data\n"});
+        CHECK_THROWS_AS(writer.close(), std::runtime_error);
+        CHECK_NOTHROW(writer.close());
+    }
+    SECTION("destructor") {
+        CHECK_NOTHROW([]() {
+            auto writer = ivio::file_writer{"/dev/full"};
+            writer.write(std::string_view{"some data\n"});
+        }());
+    }
+#else
+    SKIP();
+#endif
+}
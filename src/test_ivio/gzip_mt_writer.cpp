@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include "utilities.h"
+
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/detail/gzip_mt_writer.h>
+#include <sstream>
+
+namespace {
+auto generateData(size_t size) -> std::string {
+    auto s = std::string{};
+    for (size_t i{0}; s.size() < size; ++i) {
+        s += ">read " + std::to_string(i) + "\n";
+        for (size_t j{0}; j < 60; ++j) {
+            s += "ACGT"[(rand() % 8 == 0) ? rand() % 4 : (i + j) % 4];
+        }
+        s += '\n';
+    }
+    s.resize(size);
+    return s;
+}
+
+// decompresses a single gzip member, fails if there is trailing data
+auto inflateMember(std::string const& compressed) -> std::string {
+    auto stream = z_stream{};
+    REQUIRE(inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK);
+    auto result = std::string{};
+    auto out = std::array<char, 1<<16>{};
+    stream.next_in  = (Bytef*)compressed.data();
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    auto ret = Z_OK;
+    while (ret == Z_OK) {
+        stream.next_out  = (Bytef*)out.data();
+        stream.avail_out = static_cast<uInt>(out.size());
+        ret = inflate(&stream, Z_NO_FLUSH);
+        result.append(out.data(), out.size() - stream.avail_out);
+    }
+    CHECK(ret == Z_STREAM_END);
+    CHECK(stream.avail_in == 0);
+    inflateEnd(&stream);
+    return result;
+}
+}
+
+TEST_CASE("writing gzip files with multiple threads", "[gzip][writer][mt]") {
+    srand(0);
+    auto size      = GENERATE(size_t{0}, size_t{10}, size_t{1<<17}, size_t{300'007});
+    auto threadNbr = GENERATE(size_t{1}, size_t{3});
+    auto level     = GENERATE(0, 1, -1);
+    auto chunkSize = GENERATE(size_t{1<<15}, size_t{1<<17});
+    INFO("size " << size << ", threads " << threadNbr << ", level " << level << ", chunk size " << chunkSize);
+
+    auto data = generateData(size);
+    auto ss = std::stringstream{};
+    {
+        auto writer = ivio::gzip_mt_stream_writer{ivio::stream_writer{ss}, threadNbr, level, chunkSize};
+        for (size_t i{0}; i < data.size(); i += 5'000) {
+            writer.write(std::string_view{data}.substr(i, 5'000));
+        }
+        writer.close();
+    }
+    CHECK(inflateMember(ss.str()) == data);
+}
+
+TEST_CASE("gzip_mt_writer compresses like zlib", "[gzip][writer][mt]") {
+    srand(0);
+    auto data = generateData(1'000'000);
+
+    auto compress = [&](auto writer) {
+        writer.write(data);
+        writer.close();
+    };
+    auto ss_zlib = std::stringstream{};
+    compress(ivio::buffered_writer{ivio::zlib_stream_writer{ivio::stream_writer{ss_zlib}}});
+    auto ss_mt = std::stringstream{};
+    compress(ivio::gzip_mt_stream_writer{ivio::stream_writer{ss_mt}, 2});
+
+    // chunking costs a little bit of compression ratio
+    CHECK(ss_mt.str().size() < ss_zlib.str().size() * 102 / 100);
+    CHECK(inflateMember(ss_mt.str()) == data);
+}
+
+TEST_CASE("writing gzip files with multiple threads into a file", "[gzip][writer][mt]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "gzip_mt_writer.txt.gz";
+
+    srand(0);
+    auto data = generateData(500'000);
+    {
+        auto writer = ivio::gzip_mt_file_writer{ivio::file_writer{path}, 2};
+        auto moved = std::move(writer);
+        moved.write(data);
+    }
+    auto ifs = std::ifstream{path, std::ios::binary};
+    CHECK(inflateMember(std::string{std::istreambuf_iterator<char>{ifs}, {}}) == data);
+}
@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <ivio/detail/io_uring_reader.h>
+#include <thread>
+
+#if (defined(unix) || defined(__unix__) || defined(__unix)) && !defined(__EMSCRIPTEN__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+namespace {
+auto generateData(size_t size) -> std::string {
+    auto s = std::string(size, '\0');
+    for (auto& c : s) {
+        c = static_cast<char>(rand() % 26 + 'a');
+    }
+    return s;
+}
+
+auto readAll(ivio::io_uring_reader& reader, size_t step) -> std::string {
+    auto s = std::string{};
+    auto buffer = std::vector<char>(step);
+    while (auto n = reader.read(buffer)) {
+        s.append(buffer.data(), n);
+    }
+    return s;
+}
+}
+
+TEST_CASE("reading files with io_uring_reader", "[io_uring][reader]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    srand(0);
+    auto data = generateData(1'000'003);
+    auto path = tmp / "file_io_uring.txt";
+    {
+        auto ofs = std::ofstream{path, std::ios::binary};
+        ofs << data;
+    }
+
+    auto depth     = GENERATE(size_t{1}, size_t{4});
+    auto blockSize = GENERATE(size_t{1'000}, size_t{1<<17}, size_t{1<<21});
+    auto step      = GENERATE(size_t{777}, size_t{1<<16});
+    INFO("depth " << depth << ", block size " << blockSize << ", step " << step);
+
+    SECTION("read complete file") {
+        auto reader = ivio::io_uring_reader{path, depth, blockSize};
+        CHECK(readAll(reader, step) == data);
+        CHECK(reader.tell() == data.size());
+    }
+
+    SECTION("seek and tell") {
+        auto reader = ivio::io_uring_reader{path, depth, blockSize};
+        auto buffer = std::vector<char>(step);
+        for (auto offset : {size_t{500'000}, size_t{0}, size_t{999'999}, size_t{123'456}}) {
+            reader.seek(offset);
+            CHECK(reader.tell() == offset);
+            auto n = reader.read(buffer);
+            REQUIRE(n > 0);
+            CHECK(std::string_view{buffer.data(), n} == std::string_view{data}.substr(offset, n));
+            CHECK(reader.tell() == offset + n);
+        }
+        reader.seek(data.size());
+        CHECK(reader.read(buffer) == 0);
+    }
+}
+
+TEST_CASE("reading pipes with io_uring_reader", "[io_uring][reader]") {
+#if (defined(unix) || defined(__unix__) || defined(__unix)) && !defined(__EMSCRIPTEN__)
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    srand(0);
+    auto data = generateData(1'000'003);
+    auto filename = std::filesystem::path{tmp / "fifo_io_uring.txt"};
+    std::filesystem::remove(filename);
+    mkfifo(filename.c_str(), O_CREAT | O_RDWR | S_IRWXU);
+    auto t = std::thread{[&](){
+        auto ofs = std::ofstream{filename, std::ios::binary};
+        // write in small pieces, so reads return partial blocks
+        for (size_t i{0}; i < data.size(); i += 10'000) {
+            ofs << std::string_view{data}.substr(i, 10'000) << std::flush;
+        }
+    }};
+    auto reader = ivio::io_uring_reader{filename, {.depth = 4, .blockSize = 1<<16}};
+    CHECK(readAll(reader, 1<<16) == data);
+    t.join();
+    CHECK_THROWS(reader.seek(0)); // pipes can not seek
+#else
+    SKIP();
+#endif
+}
@@ -185,3 +185,33 @@ TEST_CASE("reading invalid sam files", "[sam][reader][invalid]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("reading sam records with missing fields", "[sam][reader][invalid]") {
+    auto header = std::string{"@HD\tVN:1.6\n"};
+
+    SECTION("tags are optional") {
+        auto ss = std::stringstream{header + "r1\t0\tchr1\t100\t60\t4M\t*\t0\t0\tACGT\tIIII\n"};
+        auto reader = ivio::sam::reader{{ss}};
+        auto rec = reader.next();
+        REQUIRE(rec);
+        CHECK(rec->qname == "r1");
+        CHECK(rec->qual == "IIII");
+        CHECK(rec->tags == "");
+        CHECK(!reader.next());
+    }
+
+    SECTION("truncated records are a parse error, not the end of the file") {
+        auto ss = std::stringstream{header + "r1\t0\tchr1\t100\t60\t4M\t*\t0\t0\tACGT\tIIII\n"
+                                             "r2\t0\tchr1\t200\t60\n"
+                                             "r3\t0\tchr1\t300\t60\t4M\t*\t0\t0\tACGT\tIIII\n"};
+        auto reader = ivio::sam::reader{{ss}};
+        REQUIRE(reader.next());
+        auto error = std::string{};
+        try {
+            reader.next();
+        } catch (std::runtime_error const& e) {
+            error = e.what();
+        }
+        CHECK(error.find("r2\t0\tchr1\t200\t60") != std::string::npos); // the error quotes the invalid line
+    }
+}
@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
+// SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
+// SPDX-License-Identifier: BSD-3-Clause
+#include <catch2/catch_all.hpp>
+#include <ivio/detail/structural_index.h>
+#include <string>
+
+TEST_CASE("charMask marks all positions of a character", "[structural_index]") {
+    auto data = std::string(64, 'a');
+    data[0] = data[17] = data[63] = '\t';
+    CHECK(ivio::detail::charMask(data.data(), '\t') == ((uint64_t{1} << 0) | (uint64_t{1} << 17) | (uint64_t{1} << 63)));
+    CHECK(ivio::detail::charMask(data.data(), 'b') == 0);
+    CHECK(ivio::detail::charMask(data.data(), 17, '\t') == 1);
+    CHECK(ivio::detail::charMask(data.data(), 18, '\t') == ((uint64_t{1} << 0) | (uint64_t{1} << 17)));
+    CHECK(ivio::detail::charMask(data.data(), 0, '\t') == 0);
+}
+
+TEST_CASE("splitFields splits lines into fields", "[structural_index]") {
+    // fields of various length, some crossing 64 byte blocks, some empty
+    auto fieldLength = GENERATE(size_t{0}, size_t{1}, size_t{30}, size_t{63}, size_t{64}, size_t{65}, size_t{200});
+    INFO("field length " << fieldLength);
+
+    auto fields = std::array<std::string, 4>{};
+    auto line   = std::string{};
+    for (size_t i{0}; i < fields.size(); ++i) {
+        fields[i] = std::string(fieldLength + i, static_cast<char>('a' + i));
+        if (i > 0) line += '\t';
+        line += fields[i];
+    }
+
+    auto res = ivio::detail::splitFields<4>(line, '\t');
+    REQUIRE(res);
+    for (size_t i{0}; i < fields.size(); ++i) {
+        CHECK((*res)[i] == fields[i]);
+    }
+
+    // the last field keeps further separators
+    auto res2 = ivio::detail::splitFields<3>(line, '\t');
+    REQUIRE(res2);
+    CHECK((*res2)[0] == fields[0]);
+    CHECK((*res2)[1] == fields[1]);
+    CHECK((*res2)[2] == fields[2] + '\t' + fields[3]);
+
+    // too few separators
+    CHECK(!ivio::detail::splitFields<5>(line, '\t'));
+}
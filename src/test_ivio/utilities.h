@@ -4,10 +4,17 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <ivio/detail/bgzf_writer.h>
+#include <limits>
+#include <map>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 #include <zlib.h>
 
 /**
@@ -24,7 +31,7 @@ inline auto read_file(std::filesystem::path p) -> std::string {
         auto oldSize = buffer.size();
         buffer.resize(oldSize + 65535);
         assert(buffer.size() <= std::numeric_limits<uint32_t>::max());
-        bytes_read = gzread(f, buffer.data(), static_cast<uint32_t>(buffer.size()));
+        bytes_read = gzread(f, buffer.data() + oldSize, 65535);
         if (bytes_read < 0) {
             throw std::runtime_error{"reading file failed"};
         }
@@ -44,3 +51,177 @@ inline auto read_compressed_string(std::string buffer, std::filesystem::path tmp
     ofs.close();
     return read_file(tmpFile);
 }
+
+/**
+ * Writes `data` as a regular gzip file, each entry of `members` starts a new gzip member
+ */
+inline void write_gzip_file(std::filesystem::path p, std::string_view data, std::vector<size_t> members = {}, int level = 6) {
+    auto ofs = std::ofstream{p, std::ios::binary};
+    members.push_back(data.size());
+    size_t begin{};
+    for (auto end : members) {
+        auto member = data.substr(begin, end - begin);
+        auto out    = std::string(compressBound(static_cast<uLong>(member.size())) + 32, '\0');
+        auto stream = z_stream{};
+        deflateInit2(&stream, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        stream.next_in   = (Bytef*)member.data();
+        stream.avail_in  = static_cast<uInt>(member.size());
+        stream.next_out  = (Bytef*)out.data();
+        stream.avail_out = static_cast<uInt>(out.size());
+        if (deflate(&stream, Z_FINISH) != Z_STREAM_END) throw std::runtime_error{"compressing failed"};
+        ofs.write(out.data(), static_cast<std::streamsize>(stream.total_out));
+        deflateEnd(&stream);
+        begin = end;
+    }
+}
+
+/**
+ * Appends the little endian representation of `v` to `buffer`
+ */
+template <typename T>
+void append(std::string& buffer, T v) {
+    auto s = buffer.size();
+    buffer.resize(s + sizeof(T));
+    std::memcpy(buffer.data() + s, &v, sizeof(T)); // tests assume a little endian host
+}
+
+/**
+ * Compresses `data` into bgzf blocks of `blockSize` bytes (followed by an eof marker).
+ * Returns the compressed offset of each block.
+ */
+inline auto compressBgzf(std::string_view data, size_t blockSize, std::string& out) -> std::vector<size_t> {
+    auto ctx     = ivio::bgzf_writer::detail::BgzfContext{};
+    auto offsets = std::vector<size_t>{};
+    auto buffer  = std::vector<char>(1<<16);
+    for (size_t i{0}; i < data.size(); i += blockSize) {
+        offsets.push_back(out.size());
+        auto len = ctx.compressBlock(data.substr(i, blockSize), buffer);
+        out.append(buffer.data(), len);
+    }
+    out += ivio::bgzf_writer::detail::eof_marker;
+    return offsets;
+}
+
+/**
+ * reg2bin as given in the SAM specification
+ */
+inline auto reg2bin(int64_t beg, int64_t end) -> uint16_t {
+    --end;
+    if (beg>>14 == end>>14) return ((1<<15)-1)/7 + (beg>>14);
+    if (beg>>17 == end>>17) return ((1<<12)-1)/7 + (beg>>17);
+    if (beg>>20 == end>>20) return ((1<<9)-1)/7  + (beg>>20);
+    if (beg>>23 == end>>23) return ((1<<6)-1)/7  + (beg>>23);
+    if (beg>>26 == end>>26) return ((1<<3)-1)/7  + (beg>>26);
+    return 0;
+}
+
+struct IndexedRecord {
+    int32_t  refID;
+    int64_t  begin;      // covered positions [begin, end), 0-based
+    int64_t  end;
+    uint64_t voffset;    // virtual offset of the record
+    uint64_t voffsetEnd; // virtual offset behind the record
+};
+
+/**
+ * Creates a BAI, CSI or TBI index (`format`) of coordinate sorted records, using min_shift 14 and depth 5
+ * CSI and TBI indices are bgzf compressed. `tabixAux` stores the tabix header as aux data of a CSI index.
+ */
+inline auto createBinIndex(std::vector<IndexedRecord> const& records, std::string_view format, std::vector<std::string> const& names, uint64_t unplacedCount, bool tabixAux = false) -> std::string {
+    bool csi = format == "CSI";
+    bool tbi = format == "TBI";
+
+    // bins, linear index and lowest offset per bin
+    struct Bin {
+        std::vector<std::tuple<uint64_t, uint64_t>> chunks;
+        uint64_t loffset{std::numeric_limits<uint64_t>::max()};
+    };
+    auto bins      = std::vector<std::map<uint32_t, Bin>>(names.size());
+    auto intervals = std::vector<std::vector<uint64_t>>(names.size());
+    for (auto const& r : records) {
+        auto& chunks = bins[r.refID][reg2bin(r.begin, r.end)].chunks;
+        if (!chunks.empty() && std::get<1>(chunks.back()) == r.voffset) {
+            std::get<1>(chunks.back()) = r.voffsetEnd;
+        } else {
+            chunks.emplace_back(r.voffset, r.voffsetEnd);
+        }
+        auto& intv = intervals[r.refID];
+        for (auto w = r.begin >> 14; w <= (r.end - 1) >> 14; ++w) {
+            if (intv.size() <= static_cast<size_t>(w)) intv.resize(w+1);
+            if (intv[w] == 0) intv[w] = r.voffset;
+        }
+    }
+    for (size_t ref{0}; ref < names.size(); ++ref) {
+        for (auto& [binNbr, bin] : bins[ref]) {
+            // region covered by the bin
+            auto level = 0, first = 0;
+            while (binNbr >= static_cast<uint32_t>(first + (1 << (level * 3)))) {
+                first += 1 << (level * 3);
+                ++level;
+            }
+            auto shift = 14 + (5 - level) * 3;
+            auto begin = static_cast<int64_t>(binNbr - first) << shift;
+            auto end   = begin + (int64_t{1} << shift);
+            for (auto const& r : records) {
+                if (r.refID == static_cast<int32_t>(ref) && r.begin < end && r.end > begin) {
+                    bin.loffset = std::min(bin.loffset, r.voffset);
+                }
+            }
+        }
+    }
+
+    // tabix header for vcf files
+    auto tabixHeader = std::string{};
+    append<int32_t>(tabixHeader, 2); // format
+    append<int32_t>(tabixHeader, 1); // col_seq
+    append<int32_t>(tabixHeader, 2); // col_beg
+    append<int32_t>(tabixHeader, 0); // col_end
+    append<int32_t>(tabixHeader, '#');
+    append<int32_t>(tabixHeader, 0); // skip
+    auto concatenatedNames = std::string{};
+    for (auto const& n : names) {
+        concatenatedNames += n;
+        concatenatedNames += '\0';
+    }
+    append<int32_t>(tabixHeader, concatenatedNames.size());
+    tabixHeader += concatenatedNames;
+
+    auto idx = std::string{format};
+    idx += '\1';
+    if (csi) {
+        append<int32_t>(idx, 14); // min_shift
+        append<int32_t>(idx, 5);  // depth
+        append<int32_t>(idx, tabixAux ? tabixHeader.size() : 0); // l_aux
+        if (tabixAux) idx += tabixHeader;
+    }
+    append<int32_t>(idx, names.size());
+    if (tbi) idx += tabixHeader;
+    for (size_t ref{0}; ref < names.size(); ++ref) {
+        append<int32_t>(idx, bins[ref].size() + 1);
+        for (auto const& [binNbr, bin] : bins[ref]) {
+            append<uint32_t>(idx, binNbr);
+            if (csi) append<uint64_t>(idx, bin.loffset);
+            append<int32_t>(idx, bin.chunks.size());
+            for (auto [b, e] : bin.chunks) {
+                append<uint64_t>(idx, b);
+                append<uint64_t>(idx, e);
+            }
+        }
+        // pseudo bin with meta data, must be ignored
+        append<uint32_t>(idx, 37450);
+        if (csi) append<uint64_t>(idx, 0);
+        append<int32_t>(idx, 2);
+        for (size_t i{0}; i < 4; ++i) append<uint64_t>(idx, 0);
+        if (!csi) {
+            append<int32_t>(idx, intervals[ref].size());
+            for (auto v : intervals[ref]) append<uint64_t>(idx, v);
+        }
+    }
+    append<uint64_t>(idx, unplacedCount); // n_no_coor
+    if (csi || tbi) {
+        auto compressed = std::string{};
+        compressBgzf(idx, 1<<15, compressed);
+        idx = compressed;
+    }
+    return idx;
+}
@@ -1,9 +1,12 @@
 // SPDX-FileCopyrightText: 2006-2023, Knut Reinert & Freie Universität Berlin
 // SPDX-FileCopyrightText: 2016-2023, Knut Reinert & MPI für molekulare Genetik
 // SPDX-License-Identifier: BSD-3-Clause
+#include "utilities.h"
+
 #include <catch2/catch_all.hpp>
 #include <filesystem>
 #include <fstream>
+#include <ivio/detail/genomic_region.h>
 #include <ivio/ivio.h>
 
 TEST_CASE("reading vcf files", "[vcf][reader]") {
@@ -107,3 +110,248 @@ TEST_CASE("reading vcf files", "[vcf][reader]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+TEST_CASE("reading vcf records with missing fields", "[vcf][reader][invalid]") {
+    auto header = std::string{"##fileformat=VCFv4.3\n"
+                              "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n"};
+
+    SECTION("sites only files, without FORMAT and samples") {
+        auto ss = std::stringstream{header + "20\t14370\trs6054257\tG\tA\t29\tPASS\tNS=3;DP=14\n"};
+        auto reader = ivio::vcf::reader{{ss}};
+        CHECK(reader.header().genotypes.empty());
+        auto rec = reader.next();
+        REQUIRE(rec);
+        CHECK(rec->pos == 14370);
+        CHECK(rec->infos == "NS=3;DP=14");
+        CHECK(rec->formats == "");
+        CHECK(rec->samples == "");
+        CHECK(!reader.next());
+    }
+
+    SECTION("truncated records are a parse error, not the end of the file") {
+        auto ss = std::stringstream{header + "20\t14370\trs6054257\tG\tA\t29\tPASS\tNS=3;DP=14\n"
+                                             "20\t17330\t.\tT\n"
+                                             "20\t1110696\trs6040355\tA\tG,T\t67\tPASS\tNS=2;DP=10\n"};
+        auto reader = ivio::vcf::reader{{ss}};
+        REQUIRE(reader.next());
+        auto error = std::string{};
+        try {
+            reader.next();
+        } catch (std::runtime_error const& e) {
+            error = e.what();
+        }
+        CHECK(error.find("20\t17330\t.\tT") != std::string::npos); // the error quotes the invalid line
+    }
+}
+
+TEST_CASE("parsing region strings", "[vcf][reader][index]") {
+    using ivio::detail::parseRegion;
+    constexpr auto max = std::numeric_limits<int64_t>::max();
+
+    auto check = [](ivio::detail::genomic_region const& r, std::string name, int64_t begin, int64_t end) {
+        CHECK(r.name  == name);
+        CHECK(r.begin == begin);
+        CHECK(r.end   == end);
+    };
+    check(parseRegion("chr7"),                         "chr7", 0, max);
+    check(parseRegion("chr7:100"),                     "chr7", 99, max);
+    check(parseRegion("chr7:100-"),                    "chr7", 99, max);
+    check(parseRegion("chr7:100-200"),                 "chr7", 99, 200);
+    check(parseRegion("chr7:1,000-2,000"),             "chr7", 999, 2000);
+    check(parseRegion("chr7:140e6-141e6"),             "chr7", 139'999'999, 141'000'000);
+    check(parseRegion("chr7:1.5e3-2E3"),               "chr7", 1499, 2000);
+    check(parseRegion("HLA-A*01:01:01:01N"),           "HLA-A*01:01:01:01N", 0, max); // ':' in the name
+    check(parseRegion("HLA-A*01:01:01:01N:5-10"),      "HLA-A*01:01:01:01N", 4, 10);
+    check(parseRegion("chr7:0-10"),                    "chr7:0-10", 0, max);         // positions are 1-based
+    check(parseRegion("chr7:1.25e1"),                  "chr7:1.25e1", 0, max);       // not an integer
+
+    CHECK_THROWS(parseRegion(""));
+    CHECK_THROWS(parseRegion("chr7:200-100"));
+}
+
+namespace {
+struct TestVariant {
+    std::string chrom;
+    int32_t     pos; // 1-based
+    std::string ref;
+    std::string id;
+    int32_t     infoEnd{}; // INFO/END (1-based, inclusive), 0 if not present
+
+    auto end() const -> int64_t { // 0-based, exclusive
+        return infoEnd > 0 ? infoEnd : int64_t{pos} - 1 + static_cast<int64_t>(ref.size());
+    }
+};
+
+/* Creates a coordinate sorted, bgzf compressed vcf file and its TBI and CSI index
+ * Variants of two references, some are long deletions spanning many bins. Others
+ * are structural variants, whose extent is only given by INFO/END.
+ */
+auto createIndexedVcf(std::filesystem::path const& path) -> std::vector<TestVariant> {
+    auto names    = std::vector<std::string>{"chr1", "chr2"};
+    auto variants = std::vector<TestVariant>{};
+    for (size_t ref{0}; ref < names.size(); ++ref) {
+        for (int32_t i{0}, pos{1}; i < 3'000; ++i) {
+            pos += (i * 7919) % 300;
+            auto refLen = (i % 97 == 0) ? 40'000 : 1 + (i % 3);
+            variants.push_back({names[ref], pos, std::string(refLen, 'A'), names[ref] + "_" + std::to_string(i)});
+            if (i % 89 == 5) {
+                variants.back().ref     = "A";
+                variants.back().infoEnd = pos + 30'000;
+            }
+        }
+    }
+
+    auto data = std::string{"##fileformat=VCFv4.3\n##contig=<ID=chr1,length=1000000>\n##contig=<ID=chr2,length=1000000>\n"
+                            "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tS1\n"};
+    auto lineStart = std::vector<size_t>{};
+    for (auto const& v : variants) {
+        lineStart.push_back(data.size());
+        auto info = std::string{"DP=3;CIEND=-5,5"}; // CIEND is not END
+        if (v.infoEnd > 0) {
+            info = "SVTYPE=DEL;END=" + std::to_string(v.infoEnd) + ";" + info;
+        }
+        data += v.chrom + "\t" + std::to_string(v.pos) + "\t" + v.id + "\t" + v.ref + "\t<DEL>\t50\tPASS\t" + info + "\tGT\t0/1\n";
+    }
+
+    // bgzf compress, small blocks so each query touches only few of them
+    auto constexpr blockSize = 5'000;
+    auto vcf = std::string{};
+    auto blockOffsets = compressBgzf(data, blockSize, vcf);
+    auto voffset = [&](size_t p) -> uint64_t {
+        if (p == data.size()) return uint64_t{vcf.size() - ivio::bgzf_writer::detail::eof_marker.size()} << 16;
+        return (uint64_t{blockOffsets[p / blockSize]} << 16) | (p % blockSize);
+    };
+    {
+        auto ofs = std::ofstream{path, std::ios::binary};
+        ofs << vcf;
+    }
+
+    auto indexed = std::vector<IndexedRecord>{};
+    for (size_t i{0}; i < variants.size(); ++i) {
+        auto const& v = variants[i];
+        auto refID = static_cast<int32_t>(std::ranges::find(names, v.chrom) - names.begin());
+        auto end   = (i+1 < variants.size()) ? lineStart[i+1] : data.size();
+        indexed.push_back({refID, v.pos - 1, v.end(), voffset(lineStart[i]), voffset(end)});
+    }
+    {
+        auto ofs = std::ofstream{path.string() + ".tbi", std::ios::binary};
+        ofs << createBinIndex(indexed, "TBI", names, /*.unplacedCount=*/0);
+    }
+    {
+        auto ofs = std::ofstream{path.string() + ".csi", std::ios::binary};
+        ofs << createBinIndex(indexed, "CSI", names, /*.unplacedCount=*/0, /*.tabixAux=*/true);
+    }
+    return variants;
+}
+
+auto expectedInRegion(std::vector<TestVariant> const& variants, std::string_view region) -> std::vector<std::string> {
+    auto r   = ivio::detail::parseRegion(region);
+    auto res = std::vector<std::string>{};
+    for (auto const& v : variants) {
+        auto begin = int64_t{v.pos} - 1;
+        if (v.chrom == r.name && begin < r.end && v.end() > r.begin) {
+            res.push_back(v.id);
+        }
+    }
+    return res;
+}
+
+auto readAll(ivio::vcf::reader& reader) -> std::vector<std::string> {
+    auto res = std::vector<std::string>{};
+    for (auto r : reader) {
+        res.emplace_back(r.id);
+    }
+    return res;
+}
+}
+
+TEST_CASE("reading regions of indexed vcf files", "[vcf][reader][index]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path     = tmp / "indexed.vcf.gz";
+    auto variants = createIndexedVcf(path);
+
+    auto regions = std::vector<std::string>{
+        "chr1:1-1",               // first record
+        "chr1:10,001-10,500",
+        "chr1:100001-100001",     // single position
+        "chr1:55e3-2e5",          // many blocks
+        "chr2:1-1000",            // second reference
+        "chr2:400001-400010",
+        "chr1:5000000-6000000",   // behind all records
+        "chr3:1-1000",            // unknown reference
+        "chr1",                   // complete reference
+        "chr2:300000",            // till the end of the reference
+    };
+
+    auto indexFile = GENERATE(std::string{}, std::string{".csi"});
+    INFO("index " << indexFile);
+    auto config = ivio::vcf::reader::config{.input = path};
+    if (!indexFile.empty()) {
+        config.index = path.string() + indexFile;
+    }
+
+    SECTION("region given by the config") {
+        config.region = "chr1:10001-20000";
+        auto reader = ivio::vcf::reader{config};
+        CHECK(reader.header().genotypes == std::vector<std::string>{"S1"});
+        CHECK(readAll(reader) == expectedInRegion(variants, config.region));
+    }
+
+    SECTION("regions match a full scan") {
+        auto reader = ivio::vcf::reader{config};
+        for (auto const& region : regions) {
+            INFO("region " << region);
+            reader.region(region);
+            CHECK(readAll(reader) == expectedInRegion(variants, region));
+        }
+        // jumping backwards
+        reader.region("chr1:10001-10500");
+        CHECK(readAll(reader) == expectedInRegion(variants, "chr1:10001-10500"));
+    }
+
+    SECTION("structural variants reach up to INFO/END") {
+        auto reader = ivio::vcf::reader{config};
+        auto sv = std::ranges::find_if(variants, [](auto const& v) { return v.infoEnd > 0 && v.pos > 1'000; });
+        REQUIRE(sv != variants.end());
+        // behind REF, but in front of END
+        auto region = sv->chrom + ":" + std::to_string(sv->infoEnd - 100) + "-" + std::to_string(sv->infoEnd - 50);
+        INFO("region " << region);
+        reader.region(region);
+        auto ids = readAll(reader);
+        CHECK(std::ranges::find(ids, sv->id) != ids.end());
+        CHECK(ids == expectedInRegion(variants, region));
+    }
+
+    SECTION("region after reading some records") {
+        auto reader = ivio::vcf::reader{config};
+        for (size_t i{0}; i < 100; ++i) {
+            REQUIRE(reader.next());
+        }
+        reader.region("chr2:100001-120000");
+        CHECK(readAll(reader) == expectedInRegion(variants, "chr2:100001-120000"));
+    }
+
+    SECTION("regions of a stream") {
+        config.index = path.string() + (indexFile.empty() ? ".tbi" : indexFile);
+        auto ifs = std::ifstream{path, std::ios::binary};
+        config.input = ifs;
+        auto reader = ivio::vcf::reader{config};
+        reader.region("chr1:55001-200000");
+        CHECK(readAll(reader) == expectedInRegion(variants, "chr1:55001-200000"));
+        reader.region("chr1:1-1");
+        CHECK(readAll(reader) == expectedInRegion(variants, "chr1:1-1"));
+    }
+}
+
+TEST_CASE("vcf region without index", "[vcf][reader][index]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+    auto path = tmp / "not_indexed.vcf.gz";
+    createIndexedVcf(path);
+    std::filesystem::remove(path.string() + ".tbi");
+    std::filesystem::remove(path.string() + ".csi");
+    auto reader = ivio::vcf::reader{{.input = path}};
+    CHECK_THROWS(reader.region("chr1:1-100"));
+    CHECK_THROWS(ivio::vcf::reader{{.input = path, .region = "chr1"}});
+}
@@ -7,6 +7,7 @@
 #include <filesystem>
 #include <fstream>
 #include <ivio/ivio.h>
+#include <sstream>
 
 TEST_CASE("writing vcf files", "[vcf][writer]") {
     auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
@@ -105,3 +106,95 @@ TEST_CASE("writing vcf files", "[vcf][writer]") {
         std::filesystem::remove_all(tmp);
     }
 }
+
+namespace {
+// splits a BGZF file into its blocks and decompresses each of them
+auto bgzfBlocks(std::string const& file) -> std::vector<std::string> {
+    auto blocks = std::vector<std::string>{};
+    size_t pos{0};
+    while (pos + 18 <= file.size()) {
+        auto bsize = static_cast<uint8_t>(file[pos+16]) + static_cast<uint8_t>(file[pos+17]) * 256 + 1;
+        auto isize = static_cast<uint8_t>(file[pos+bsize-4])
+                   + (static_cast<uint8_t>(file[pos+bsize-3]) << 8)
+                   + (static_cast<uint8_t>(file[pos+bsize-2]) << 16);
+        auto block = std::string(isize, '\0');
+        auto stream = z_stream{};
+        REQUIRE(inflateInit2(&stream, -15) == Z_OK);
+        stream.next_in   = (Bytef*)file.data() + pos + 18;
+        stream.avail_in  = static_cast<uInt>(bsize - 18 - 8);
+        stream.next_out  = (Bytef*)block.data();
+        stream.avail_out = static_cast<uInt>(block.size());
+        CHECK(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+        inflateEnd(&stream);
+        blocks.push_back(block);
+        pos += bsize;
+    }
+    CHECK(pos == file.size());
+    return blocks;
+}
+}
+
+TEST_CASE("writing bgzf compressed vcf files", "[vcf][writer][bgzf]") {
+    auto tmp = std::filesystem::temp_directory_path() / "ivio_test";
+    std::filesystem::create_directory(tmp);
+
+    auto header = ivio::vcf::header {
+        .table = {{"fileformat", "VCFv4.3"}},
+        .genotypes = {"NA00001", "NA00002", "NA00003"},
+    };
+    auto records = std::vector<ivio::vcf::record>{};
+    auto expected = std::string{"##fileformat=VCFv4.3\n#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tNA00001\tNA00002\tNA00003\n"};
+    for (int32_t i{0}; i < 20'000; ++i) {
+        auto r = ivio::vcf::record{.chrom = "20", .pos = 1000 + i, .id = ".", .ref = "T", .alts = "A", .qual = 3.f, .filters = "q10", .infos = "NS=3;DP=11;AF=0.017", .formats = "GT:GQ:DP:HQ", .samples = "0|0:49:3:58,50\t0|1:3:5:65,3\t0/0:41:3"};
+        expected += "20\t" + std::to_string(r.pos) + "\t.\tT\tA\t3\tq10\tNS=3;DP=11;AF=0.017\tGT:GQ:DP:HQ\t0|0:49:3:58,50\t0|1:3:5:65,3\t0/0:41:3\n";
+        records.push_back(r);
+    }
+
+    auto threadNbr    = GENERATE(size_t{0}, size_t{2});
+    auto alignRecords = GENERATE(false, true);
+    INFO("threads " << threadNbr << ", align records " << alignRecords);
+
+    SECTION("Write to std::filesystem::path") {
+        {
+            auto writer = ivio::vcf::writer{{.output = tmp / "file.vcf.bgz", .header = header, .threadNbr = threadNbr, .alignRecords = alignRecords}};
+            for (auto const& r : records) {
+                writer.write(r);
+            }
+        }
+        CHECK(read_file(tmp / "file.vcf.bgz") == expected);
+
+        auto ifs = std::ifstream{tmp / "file.vcf.bgz", std::ios::binary};
+        auto blocks = bgzfBlocks(std::string{std::istreambuf_iterator<char>{ifs}, {}});
+        REQUIRE(blocks.size() > 2);
+        CHECK(blocks.back().empty()); // eof marker
+        if (alignRecords) {
+            for (size_t i{0}; i+1 < blocks.size(); ++i) {
+                CHECK(blocks[i].back() == '\n');
+            }
+        }
+
+        auto reader = ivio::vcf::reader{{.input = tmp / "file.vcf.bgz"}};
+        size_t count{};
+        for (auto r : reader) {
+            CHECK(r.pos == records[count].pos);
+            count += 1;
+        }
+        CHECK(count == records.size());
+    }
+
+    SECTION("Write to std::stringstream") {
+        auto ss = std::stringstream{};
+        {
+            auto writer = ivio::vcf::writer{{.output = ss, .header = header, .threadNbr = threadNbr, .bgzf = true, .alignRecords = alignRecords}};
+            for (auto const& r : records) {
+                writer.write(r);
+            }
+        }
+        CHECK(read_compressed_string(ss.str(), tmp / "tmp.vcf.gz") == expected);
+        CHECK(bgzfBlocks(ss.str()).size() > 2);
+    }
+
+    SECTION("cleanup - deleting temp folder") {
+        std::filesystem::remove_all(tmp);
+    }
+}